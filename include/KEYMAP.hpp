@@ -1,14 +1,31 @@
 #pragma once
 
+#include <array>
 #include <cstdint>
 #include <SDL_keycode.h>
-#include <unordered_map>
+#include <utility>
 
 using Byte = uint8_t;
 
-const std::unordered_map<SDL_KeyCode, Byte> KEYMAP {
+constexpr std::array<std::pair<SDL_KeyCode, Byte>, 16> KEYMAP {{
     {SDLK_1, 0x1}, {SDLK_2, 0x2}, {SDLK_3, 0x3}, {SDLK_4, 0xC},
     {SDLK_q, 0x4}, {SDLK_w, 0x5}, {SDLK_e, 0x6}, {SDLK_r, 0xD},
     {SDLK_a, 0x7}, {SDLK_s, 0x8}, {SDLK_d, 0x9}, {SDLK_f, 0xE},
     {SDLK_z, 0xA}, {SDLK_x, 0x0}, {SDLK_c, 0xB}, {SDLK_v, 0xF},
-};
+}};
+
+// Keycodes of printable keys are their ASCII characters, every keycode at or above this maps to no button
+constexpr int KEY_LOOKUP_SIZE = 128;
+
+// Button per keycode below KEY_LOOKUP_SIZE, -1 for keys not in KEYMAP
+constexpr std::array<int8_t, KEY_LOOKUP_SIZE> KEY_LOOKUP = [] {
+    std::array<int8_t, KEY_LOOKUP_SIZE> lookup{};
+    lookup.fill(-1);
+    for (const auto & [keyCode, button] : KEYMAP) {
+        lookup[keyCode] = int8_t(button);
+    }
+    return lookup;
+}();
+
+// Held down to step the game backward
+const SDL_KeyCode REWIND_KEY = SDLK_BACKSPACE;
@@ -0,0 +1,34 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include "jit.hpp"
+#include "quirks.hpp"
+
+// Longest block chip8-recompile writes, bounds the bytes a write to memory has to look back for blocks
+constexpr int AOT_MAX_BLOCK_INSTRUCTIONS = 128;
+
+// Basic block of a game compiled ahead of time by chip8-recompile, called like a Jit block
+struct AotBlock {
+    Word address;                       // First instruction
+    Word last;                          // Last memory address the block was compiled from
+    Word instructions;                  // Instructions executed by one run of the block
+    Jit::Code code;
+};
+
+// Blocks of one game for one quirk profile, defined by a translation unit chip8-recompile wrote
+struct AotProgram {
+    const char* name;
+    uint64_t hash;                      // Rom::hash of the game
+    size_t size;                        // Bytes of the game
+    QuirkProfile profile;               // Profile the blocks were compiled for
+    const Byte* game;                   // The game as compiled, a block only runs while memory still holds its bytes
+    const AotBlock* blocks;             // Sorted by address
+    size_t blockCount;
+};
+
+// Called by the static initializer of every generated translation unit, program has static storage
+bool registerAotProgram(const AotProgram* program);
+// The program compiled from the game with hash and size for profile, nullptr if none was linked in
+const AotProgram* findAotProgram(const uint64_t hash, const size_t size, const QuirkProfile profile);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include "ringbuffer.hpp"
+
+#include <cstddef>
+#include <cstdint>
+
+// Receives the sound timer at every 60 Hz timer tick of a Chip8
+class AudioSink {
+public:
+    virtual ~AudioSink() = default;
+
+    // active is true when the sound timer was running during the tick that just ended
+    virtual void tick(const bool active) = 0;
+};
+
+// Drops the sound, for headless runs
+class NullAudioSink : public AudioSink {
+public:
+    void tick(const bool) override {}
+};
+
+// Sink of every Chip8 until another one is set
+inline NullAudioSink NULL_AUDIO_SINK;
+
+// Turns the ticks into a square wave. The emulation thread calls tick, the audio thread render,
+// they only share a lock-free ring so render neither locks nor allocates.
+class Beeper : public AudioSink {
+public:
+    Beeper(const int sampleRate, const double frequency = 440.0, const int16_t amplitude = 3000);
+
+    void tick(const bool active) override;
+
+    // Writes count mono samples, silence while no ticks are queued
+    void render(int16_t* samples, const size_t count);
+
+private:
+    // Ticks queued beyond this many are dropped, which bounds the latency to about 4 / 60 seconds
+    static constexpr size_t MAX_QUEUED_TICKS = 4;
+
+    RingBuffer<uint8_t, 64> mTicks;
+
+    const uint32_t mSamplesPerTick;
+    const uint32_t mPhaseStep;          // Phase added per sample, a full period is 2^32
+    const int16_t mAmplitude;
+
+    // Only touched by the audio thread
+    uint32_t mPhase;
+    uint32_t mTickSamples;              // Samples left of the current tick
+    bool mActive;                       // Sound timer running in the current tick
+};
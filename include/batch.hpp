@@ -0,0 +1,79 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "romcache.hpp"
+
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+// Runs many independent Chip8 instances on a pool of worker threads.
+// Instances are stepped in chunks of neighbouring instances, every worker owns a queue of chunks
+// and steals from the back of the other queues once its own is empty.
+class Batch {
+public:
+    // threads == 0 uses one worker per hardware thread
+    Batch(const size_t instances, const size_t threads = 0);
+    ~Batch();
+
+    Batch(const Batch&) = delete;
+    Batch& operator=(const Batch&) = delete;
+
+    // Initializes every instance with seed + index and loads the game into it.
+    // The game is read once, the other instances are forked from the first.
+    bool loadGame(const std::string& gameFilepath, const uint64_t ticksPerSecond, const uint64_t seed);
+    // Loads from a shared image without any file access
+    bool loadGame(const Rom& rom, const uint64_t ticksPerSecond, const uint64_t seed);
+
+    // Returns every instance to its state right after loadGame without reading the game again
+    void reset();
+    void setBackend(const Backend backend);
+    // Set after loadGame and setQuirkProfile, see Chip8::setAotProgram
+    void setAotProgram(const AotProgram* program);
+    // Set before loadGame, the profile decides the memory size of the instances
+    void setQuirkProfile(const QuirkProfile profile);
+
+    // Runs frames on every instance and returns once all are done
+    void runFrames(const uint64_t frames);
+
+    void setKeys(const size_t instance, const std::array<bool, 16>& keyState);
+    const Chip8::Graphix& getGraphix(const size_t instance) const;
+
+    Chip8& getInstance(const size_t instance);
+    const Chip8& getInstance(const size_t instance) const;
+    size_t getSize() const;
+    size_t getThreads() const;
+
+private:
+    struct Chunk {
+        size_t first;
+        size_t last;                    // One past the last instance
+    };
+
+    struct Queue {
+        std::mutex mutex;
+        std::deque<Chunk> chunks;
+    };
+
+    void work(const size_t worker);
+    bool takeChunk(const size_t worker, Chunk& chunk);
+
+    std::vector<Chip8> mInstances;
+    std::vector<Chip8::State> mGolden;  // State of every instance after loadGame
+    std::vector<Queue> mQueues;         // Queue per worker
+    std::vector<std::thread> mWorkers;
+
+    std::mutex mMutex;
+    std::condition_variable mStart;
+    std::condition_variable mDone;
+    uint64_t mGeneration;               // Incremented for every runFrames, wakes the workers
+    uint64_t mFrames;                   // Frames of the current runFrames, set before its chunks are queued
+    std::atomic<size_t> mRemaining;     // Chunks not yet finished
+    bool mStopping;
+};
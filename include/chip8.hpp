@@ -2,21 +2,117 @@
 
 #include <cstdint>
 #include <array>
+#include <initializer_list>
+#include <memory>
 #include <string>
+#include <vector>
+
+#include "aot.hpp"
+#include "audio.hpp"
+#include "counters.hpp"
+#include "framesink.hpp"
+#include "jit.hpp"
+#include "quirks.hpp"
+#include "random.hpp"
 
 using Byte = uint8_t;
 using Word = uint16_t;
 
+class Debugger;
+
+// Engine behind CXNN, any UniformRandomBitGenerator producing at least 8 bits fits
+using RandomEngine = Pcg32;
+
+enum class Backend {
+    Interpreter,
+    Jit,                                // x86-64 basic blocks, falls back to the interpreter per instruction
+    Aot,                                // Blocks compiled ahead of time by chip8-recompile, see setAotProgram, falls back like Jit
+};
+
 class Chip8 {
 public:
+    // Two bitplanes of 128 words. A plane holds 32 rows of one word at low resolution and 64 rows of two words
+    // at high resolution, column 0 in the MSB. The 64x32 CHIP-8 screen only uses the first 32 words.
+    using Graphix = std::array<uint64_t, 256>;
+    static constexpr int PLANE_WORDS = 128;
+
+    // Everything needed to continue a machine, saved and loaded with plain copies.
+    // The backend and compiled blocks are not part of it.
+    struct State {
+        std::vector<Byte> memory;       // 4 KB, or 64 KB with the XO-CHIP instruction set
+        Graphix graphix;
+        std::array<Byte, 16> V;
+        std::array<Word, 16> stack;
+        std::array<bool, 16> keys;
+        RandomEngine random;
+        uint64_t ticksPerSecond;
+        uint64_t cycleCount;
+        uint64_t timerAccumulator;
+        uint64_t frameAccumulator;
+        Word programCounter;
+        Word indexRegistry;
+        Word stackP;
+        Byte delayTimer;
+        Byte soundTimer;
+        bool drawFlag;
+        bool highResolution;
+        Byte planes;
+        std::array<Byte, 16> flags;
+        std::array<Byte, 16> audioPattern;
+        Byte pitch;
+    };
+
+    // Version of the serialized State, bumped whenever its layout changes
+    static constexpr uint32_t STATE_VERSION = 2;
+
+    // ticksPerSecond is at least 1, 0 would never let the timers and frames advance
     void initialize(const uint64_t ticksPerSecond);   
+    void initialize(const uint64_t ticksPerSecond, const uint64_t seed);
+    // Copies the game to 0x200, false if it does not fit into the memory of the quirk profile
     bool loadGame(const std::string& gameFilepath);
+    bool loadGame(const Byte* data, const size_t size);
+
+    // Copies of a Chip8 share the predecoded memory until one of them writes to it,
+    // so forking a machine or loading a state of the same game costs little more than the memory copy
+    State saveState() const;
+    void loadState(const State& state);
+
+    static std::vector<Byte> serializeState(const State& state);
+    static bool deserializeState(const std::vector<Byte>& data, State& state);
     
     void emulateCycle();
+    // Idle loops are fast-forwarded to the end of the run or the next timer tick, ending in the same state as
+    // running them: FX0A without a key pressed, a jump to itself and a delay timer wait of FX07, 3XNN or 4XNN
+    // on VX and a jump back to the FX07. emulateCycle runs single instructions and never fast-forwards.
+    bool runCycles(const uint64_t cycles);
+    bool runFrame();
+    bool setBackend(const Backend backend);
+    // Blocks run by Backend::Aot, nullptr removes them. False if program was compiled for another quirk profile,
+    // changing the profile removes them. A block is compared with memory before its first run and after
+    // every write to its bytes, and left to the interpreter while they differ.
+    bool setAotProgram(const AotProgram* program);
+    // Decodes the memory again with the handlers of profile, LEGACY_QUIRKS until set. The memory is resized
+    // to the instruction set of the profile, set it before loadGame for games larger than 4 KB.
+    void setQuirkProfile(const QuirkProfile profile);
+    // The sink gets the sound timer at every timer tick, nullptr restores NULL_AUDIO_SINK
+    void setAudioSink(AudioSink* sink);
+    // The sink gets the machine at the end of every runFrame, nullptr restores NULL_FRAME_SINK
+    void setFrameSink(FrameSink* sink);
+    // Set by the Debugger while it is stopped or has breakpoints, runCycles then executes single instructions
+    // checked by it instead of the backend. Not owned, copies of the machine keep it like the sinks.
+    void setDebugger(Debugger* debugger);
     void setKeys(const std::array<bool, 16>& keyState);
     
-    const std::array<Byte, 4096>& getMemory() const;
-    const std::array<Byte, 64 * 32>& getGraphix() const;
+    const std::vector<Byte>& getMemory() const;
+    const Graphix& getGraphix() const;
+    // Color of every pixel row by row, bit 0 from the first plane and bit 1 from the second
+    std::vector<Byte> getUnpackedGraphix() const;
+    bool isHighResolution() const;
+    int getWidth() const;
+    int getHeight() const;
+    // Bit per row of the current resolution
+    uint64_t getDirtyRows() const;
+    void clearDirtyRows();
 
     Word getProgramCounter() const;
     Word getIndexRegistry() const;
@@ -24,6 +120,7 @@ public:
     const std::array<Byte, 16>& getVReg() const;
     Byte getDelayTimer() const;
     Byte getSoundTimer() const;
+    bool isSoundActive() const;
 
     const std::array<Word, 16>& getStack() const;
     Word getStackP() const;
@@ -31,11 +128,135 @@ public:
     const std::array<bool, 16>& getKeys() const;         
 
     bool getDrawFlag() const;
+    uint64_t getCycleCount() const;
+    // Cycles fast-forwarded in idle loops since initialize, included in getCycleCount
+    uint64_t getElidedCycles() const;
+    // The instruction at the program counter is FX0A and no key is pressed, only the timers change until setKeys presses one
+    bool isWaitingForKey() const;
+    const RandomEngine& getRandomEngine() const;
+    Backend getBackend() const;
+    QuirkProfile getQuirkProfile() const;
+
+    // Counted since initialize, always zero unless built with CHIP8_INSTRUMENTATION, except unknownOpcodes
+    const Counters& getCounters() const;
 
 private:
-    std::array<Byte, 4096> mMemory;     // Memory 
-    std::array<Byte, 64 * 32> mGraphix; // Pixels on the screen 
-    uint64_t mTicksPerSecond;
+    // Predecoded instruction, the operands are extracted once when the instruction is decoded
+    struct Instruction;
+    using Handler = void (*)(Chip8& chip8, const Instruction& instruction);
+    struct Instruction {
+        Handler handler;
+        Word operationCode;
+        Word NNN;
+        Byte NN;
+        Byte N;
+        Byte X;
+        Byte Y;
+    };
+
+    static constexpr int PAGE_SIZE = 256;
+    static constexpr int MAX_MEMORY_SIZE = 0x10000;
+    using DecodedPage = std::array<Instruction, PAGE_SIZE>;
+
+    // Handlers that depend on quirks are instantiated for every profile, decode picks those of mQuirkProfile
+    template <Quirks QUIRKS>
+    static Instruction decodeWith(const Word operationCode);
+    Instruction decode(const Word operationCode) const;
+    DecodedPage& writableDecodedPage(const int page);
+    void invalidateMemory(const int first, const int last);
+    // Invalidates count bytes written from address on, wrapping around the end of memory
+    void invalidateWrapped(const Word address, const int count);
+    void step();
+    void tickCycles(const uint64_t cycles);
+    // Runs rounds of an idle loop in one step, families holds the opcode family of every instruction of a round
+    void elide(const uint64_t rounds, const std::initializer_list<int> families);
+    void skipDelayWait(const Byte X);
+    // Runs the blocks lookup returns for the program counter and interprets where it returns nullptr
+    template <typename Lookup>
+    bool runBlocks(const uint64_t cycles, Lookup lookup);
+    bool runCyclesDebug(const uint64_t cycles);
+    const AotBlock* lookupAot(const Word address);
+    void invalidateAot(const int first, const int last);
+    void resizeMemory(const size_t size);
+    void loadFonts();
+    uint64_t getAllRows() const;
+
+    template <Quirks QUIRKS> static void skip(Chip8& chip8);
+    template <Quirks QUIRKS> static void drawExtended(Chip8& chip8, const Instruction& instruction);
+
+    template <Quirks QUIRKS> static void op00E0(Chip8& chip8, const Instruction& instruction);
+    static void op00EE(Chip8& chip8, const Instruction& instruction);
+    static void op1NNN(Chip8& chip8, const Instruction& instruction);
+    static void op2NNN(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op3XNN(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op4XNN(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op5XY0(Chip8& chip8, const Instruction& instruction);
+    static void op6XNN(Chip8& chip8, const Instruction& instruction);
+    static void op7XNN(Chip8& chip8, const Instruction& instruction);
+    static void op8XY0(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op8XY1(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op8XY2(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op8XY3(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op8XY4(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op8XY5(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op8XY6(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op8XY7(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op8XYE(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void op9XY0(Chip8& chip8, const Instruction& instruction);
+    static void opANNN(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void opBNNN(Chip8& chip8, const Instruction& instruction);
+    static void opCXNN(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void opDXYN(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void opEX9E(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void opEXA1(Chip8& chip8, const Instruction& instruction);
+    static void opFX07(Chip8& chip8, const Instruction& instruction);
+    static void opFX0A(Chip8& chip8, const Instruction& instruction);
+    static void opFX15(Chip8& chip8, const Instruction& instruction);
+    static void opFX18(Chip8& chip8, const Instruction& instruction);
+    static void opFX1E(Chip8& chip8, const Instruction& instruction);
+    static void opFX29(Chip8& chip8, const Instruction& instruction);
+    static void opFX33(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void opFX55(Chip8& chip8, const Instruction& instruction);
+    template <Quirks QUIRKS> static void opFX65(Chip8& chip8, const Instruction& instruction);
+
+    // SUPER-CHIP
+    static void op00CN(Chip8& chip8, const Instruction& instruction);
+    static void op00FB(Chip8& chip8, const Instruction& instruction);
+    static void op00FC(Chip8& chip8, const Instruction& instruction);
+    static void op00FD(Chip8& chip8, const Instruction& instruction);
+    static void op00FE(Chip8& chip8, const Instruction& instruction);
+    static void op00FF(Chip8& chip8, const Instruction& instruction);
+    static void opFX30(Chip8& chip8, const Instruction& instruction);
+    static void opFX75(Chip8& chip8, const Instruction& instruction);
+    static void opFX85(Chip8& chip8, const Instruction& instruction);
+
+    // XO-CHIP
+    static void op00DN(Chip8& chip8, const Instruction& instruction);
+    static void op5XY2(Chip8& chip8, const Instruction& instruction);
+    static void op5XY3(Chip8& chip8, const Instruction& instruction);
+    static void opF000(Chip8& chip8, const Instruction& instruction);
+    static void opFN01(Chip8& chip8, const Instruction& instruction);
+    static void opF002(Chip8& chip8, const Instruction& instruction);
+    static void opFX3A(Chip8& chip8, const Instruction& instruction);
+
+    static void opUnknown(Chip8& chip8, const Instruction& instruction);
+
+    std::vector<Byte> mMemory;          // Memory, sized by the instruction set of mQuirkProfile
+    Word mAddressMask = 0x0FFF;         // mMemory.size() - 1
+    std::array<std::shared_ptr<DecodedPage>, MAX_MEMORY_SIZE / PAGE_SIZE> mDecoded; // Predecoded instruction at every address of mMemory, pages shared between copies until written
+    Graphix mGraphix;                   // Pixels on the screen, see Graphix
+    uint64_t mDirtyRows;                // Bit per row of mGraphix changed since clearDirtyRows
+    bool mHighResolution = false;       // 128x64 instead of 64x32, only set by SUPER-CHIP and XO-CHIP
+    Byte mPlanes = 1;                   // Bit per plane drawn, scrolled and cleared, selected by XO-CHIP FN01
+    std::array<Byte, 16> mFlags;        // RPL user flags of FX75/FX85
+    std::array<Byte, 16> mAudioPattern; // XO-CHIP F002, stored for states but not played
+    Byte mPitch;                        // XO-CHIP FX3A, stored for states but not played
+    uint64_t mTicksPerSecond;           // Instructions per second
+    uint64_t mCycleCount;               // Instructions executed since initialize
+    uint64_t mTimerAccumulator;         // Fraction of a 60 Hz timer tick, in 1/mTicksPerSecond
+    uint64_t mFrameAccumulator;         // Fraction of an instruction carried between frames
+    uint64_t mRunEnd = 0;               // mCycleCount at which the current run ends, idle loops are not fast-forwarded past it
+    uint64_t mElidedCycles;             // Cycles fast-forwarded in idle loops
 
     Word mProgramCounter;               // Program counter 
     Word mIndexRegistry;                // Index registry
@@ -49,5 +270,25 @@ private:
 
     std::array<bool, 16> mKeys;         // Keypad representation
 
+    RandomEngine mRandom;               // Generator for CXNN, seeded by initialize
+
     bool mDrawFlag;                     // Flag for refreshing screen
+
+    Counters mCounters;                 // Only updated when INSTRUMENTATION is true, except unknownOpcodes
+    AudioSink* mAudioSink = &NULL_AUDIO_SINK; // Not owned
+    FrameSink* mFrameSink = &NULL_FRAME_SINK; // Not owned
+    Debugger* mDebugger = nullptr;      // Not owned, nullptr unless a debugger is armed
+    Backend mBackend = Backend::Interpreter;
+    QuirkProfile mQuirkProfile = QuirkProfile::Legacy;
+    Jit mJit;                           // Compiled blocks, only used with Backend::Jit
+
+    enum class AotCheck : Byte {
+        Unchecked,
+        Same,                           // Memory holds the bytes the block was compiled from
+        Changed,
+    };
+
+    const AotProgram* mAotProgram = nullptr; // Static storage, only used with Backend::Aot
+    std::vector<uint16_t> mAotEntries;  // Index + 1 of the block of mAotProgram starting at every address, 0 for none
+    std::vector<AotCheck> mAotChecks;   // Per block of mAotProgram
 };
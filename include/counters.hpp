@@ -0,0 +1,27 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <ostream>
+
+// Instruction counters are only updated when the library is built with CHIP8_INSTRUMENTATION
+// (the CMake option of the same name), otherwise every update compiles away. Unknown opcodes are
+// counted in every build, Chip8 reports only the first one.
+#ifdef CHIP8_INSTRUMENTATION
+constexpr bool INSTRUMENTATION = true;
+#else
+constexpr bool INSTRUMENTATION = false;
+#endif
+
+// Counters of one Chip8 instance, never shared between instances so updating them needs no synchronization
+struct Counters {
+    std::array<uint64_t, 16> families{}; // Executed instructions by their most significant nibble
+    uint64_t draws = 0;                 // DXYN executed
+    uint64_t spriteRows = 0;            // Rows drawn by DXYN
+    uint64_t collisions = 0;            // DXYN that set VF
+    uint64_t timerWrites = 0;           // FX15 and FX18 executed
+    uint64_t unknownOpcodes = 0;
+
+    // Writes the counters as a JSON object, indented by indent spaces after the first line
+    void writeJson(std::ostream& os, const int indent = 0) const;
+};
@@ -0,0 +1,93 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#include <bitset>
+#include <cstdint>
+#include <vector>
+
+// Breakpoints, memory watchpoints and register conditions for one Chip8.
+// The debugger attaches itself to the machine with Chip8::setDebugger only while it is stopped or has
+// anything set. Attached, runCycles executes single instructions checked by it, detached the machine runs
+// its backend, fast-forwarding included, without any check.
+class Debugger {
+public:
+    enum class Stop {
+        None,                           // Running
+        Interrupt,
+        Step,
+        Breakpoint,                     // Before the instruction at the program counter
+        Watchpoint,                     // After an instruction changed a watched byte, see getStopAddress
+        Condition,                      // After an instruction made a condition true
+    };
+
+    // Registers of conditions after V0 to VF
+    static constexpr int REGISTER_I = 16;
+    static constexpr int REGISTER_DELAY = 17;
+    static constexpr int REGISTER_SOUND = 18;
+    static constexpr int REGISTERS = 19;
+
+    explicit Debugger(Chip8& chip8);
+    ~Debugger();
+
+    Debugger(const Debugger&) = delete;
+    Debugger& operator=(const Debugger&) = delete;
+
+    void addBreakpoint(const Word address);
+    bool removeBreakpoint(const Word address);
+    // Stops after an instruction changed a byte in [first, last], like a software watchpoint writing
+    // the same value goes unnoticed
+    void addWatchpoint(const Word first, const Word last);
+    bool removeWatchpoint(const Word first, const Word last);
+    // Stops after an instruction made the register, a V register or one of REGISTER_I to REGISTER_SOUND, equal value
+    bool addCondition(const int reg, const Word value);
+    bool removeCondition(const int reg, const Word value);
+    // Removes every breakpoint, watchpoint and condition
+    void clear();
+
+    // Stops before the next instruction
+    void interrupt();
+    // Continues, the instruction at the program counter runs even if it has a breakpoint
+    void resume();
+    // Runs one instruction, stopped or not, and stops after it
+    void step();
+    // Takes the watched bytes and registers from the machine again after it was changed from outside
+    void sync();
+
+    bool isStopped() const;
+    Stop getStop() const;
+    // Lowest changed byte for Stop::Watchpoint
+    Word getStopAddress() const;
+    Chip8& getMachine();
+
+    // Called by Chip8::runCycles around every instruction while attached, false ends the run before the instruction
+    bool beforeInstruction(const Chip8& chip8);
+    void afterInstruction(const Chip8& chip8);
+
+private:
+    struct Watchpoint {
+        Word first;
+        Word last;
+        std::vector<Byte> bytes;        // Last seen contents of [first, last]
+    };
+
+    struct Condition {
+        int reg;
+        Word value;
+        bool held;                      // Held after the last instruction, only a change to true stops
+    };
+
+    static Word readRegister(const Chip8& chip8, const int reg);
+    void stop(const Stop reason);
+    void attach();
+
+    Chip8& mChip8;
+    std::bitset<0x10000> mBreakpoints;  // Bit per address
+    size_t mBreakpointCount = 0;
+    std::vector<Watchpoint> mWatchpoints;
+    std::vector<Condition> mConditions;
+
+    Stop mStop = Stop::None;
+    Word mStopAddress = 0;
+    bool mResuming = false;             // The next instruction passes its breakpoint
+};
@@ -0,0 +1,57 @@
+#pragma once
+
+#include "debugger.hpp"
+
+#include <string>
+
+// Serves a Debugger to one client at a time over a local Unix socket, with the packets of the GDB remote
+// protocol: "$packet#checksum", acknowledged with "+" and answered with "$reply#checksum".
+// Registers are V0 to VF as bytes, I, PC and SP as little endian words, then DT and ST as bytes.
+//   ?                          stop reason: S02 after an interrupt, T05watch:address; after a watchpoint, else S05
+//   g, G registers             read or write the registers
+//   m address,length           read memory
+//   M address,length:bytes     write memory
+//   c, s                       continue or single step, answered with the stop reason once stopped
+//   Z0,address,kind, z0,...    set or remove a breakpoint
+//   Z2,address,length, z2,...  set or remove a write watchpoint
+//   Zr,register,value, zr,...  set or remove a condition, registers numbered as in Debugger
+//   D, k                       detach or kill, both remove everything and let the machine run
+//   0x03                       interrupt
+// Numbers are hex. A client connecting stops the machine, unsupported packets get an empty reply.
+class DebugServer {
+public:
+    explicit DebugServer(Debugger& debugger);
+    ~DebugServer();
+
+    DebugServer(const DebugServer&) = delete;
+    DebugServer& operator=(const DebugServer&) = delete;
+
+    // Creates a socket only the owner can connect to at path, replacing an existing socket. False if
+    // anything else is at path, the socket can not be created or the platform has no Unix sockets.
+    bool listen(const std::string& path);
+    // Serves an already connected socket, like one end of a socketpair, instead of accepting one. Takes ownership.
+    void attach(const int socket);
+
+    // Accepts a waiting client, handles every complete packet received and sends the stop reason of a run
+    // that stopped since. Waits up to timeoutMs for input. Call it on the thread running the machine, between runs.
+    void poll(const int timeoutMs);
+    bool isAttached() const;
+
+private:
+    void handle(const std::string& packet);
+    std::string readRegisters() const;
+    bool writeRegisters(const std::string& hex);
+    std::string readMemory(const std::string& arguments) const;
+    bool writeMemory(const std::string& arguments);
+    bool setPoint(const std::string& arguments, const bool set);
+    std::string getStopReply() const;
+    void send(const std::string& reply);
+    void disconnect();
+
+    Debugger& mDebugger;
+    std::string mPath;                  // Unlinked on destruction, empty without a listening socket
+    int mListener = -1;
+    int mClient = -1;
+    std::string mInput;                 // Received bytes not yet forming a packet
+    bool mRunning = false;              // A c packet awaits its stop reply
+};
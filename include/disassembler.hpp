@@ -0,0 +1,10 @@
+#pragma once
+
+#include <cstdint>
+#include <string>
+
+using Word = uint16_t;
+
+// Returns the assembly of an instruction in the common CHIP-8, SUPER-CHIP and XO-CHIP mnemonics, e.g. "LD V1, 0x2A" for 612A.
+// Words that are no instruction come back as "DW 0x...".
+std::string disassemble(const Word operationCode);
@@ -0,0 +1,21 @@
+#pragma once
+
+class Chip8;
+
+// Receives a Chip8 at the end of every runFrame
+class FrameSink {
+public:
+    virtual ~FrameSink() = default;
+
+    // chip8 is only borrowed for the call, sinks read its framebuffer in place
+    virtual void frame(const Chip8& chip8) = 0;
+};
+
+// Drops the frames, for runs without export
+class NullFrameSink : public FrameSink {
+public:
+    void frame(const Chip8&) override {}
+};
+
+// Sink of every Chip8 until another one is set
+inline NullFrameSink NULL_FRAME_SINK;
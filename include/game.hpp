@@ -1,26 +1,55 @@
 #pragma once
 
 #include <SDL.h>
+#include <audio.hpp>
+#include <chip8.hpp>
 #include <cstdint>
 #include <string>
 #include <array>
 
+// Sample rate the Beeper passed to Game::startAudio has to be made for
+constexpr int AUDIO_SAMPLE_RATE = 48000;
+
 class Game {
 public:
-    Game(const std::string& title);
+    // With vsync the renderer presents in step with the display if the platform allows it, see hasVsync
+    Game(const std::string& title, const int scale = 10, const bool vsync = false);
     ~Game();
     
+    // Handles every pending event
     void handleEvents(std::array<bool, 16>& keyState); 
+    // Blocks until an event arrives or timeoutMs passed, then handles every pending event
+    void waitEvents(std::array<bool, 16>& keyState, const int timeoutMs);
 
-    void drawScreen(const std::array<uint8_t, 64 * 32>& screenState);
+    // Redraws the rows with a bit set in dirtyRows into the texture, the rest is kept from earlier frames.
+    // Rows are those of the resolution, 64 at high resolution and 32 otherwise.
+    void drawScreen(const Chip8::Graphix& screenState, const bool highResolution, const uint64_t dirtyRows);
+    // Shows the texture, blocks until the next display refresh with vsync
+    void present();
     
+    // Plays the beeper through an SDL audio device until the game is destroyed, false without audio
+    bool startAudio(Beeper& beeper);
+
     bool isRunning();
+    bool isRewinding() const;           // Rewind key held down
+    bool hasVsync() const;              // The renderer presents with vsync
 private: 
+    void handleEvent(const SDL_Event& event, std::array<bool, 16>& keyState);
+    void drawRows(const Chip8::Graphix& screenState, const bool highResolution, const int first, const int last);
+    static void renderAudio(void* beeper, Uint8* stream, int length);
+
     bool mIsRunning;
+    bool mIsRewinding;
+    bool mHasVsync;
+    const int mScale;
     const int mWidth;
     const int mHeight;
 
+    std::array<uint32_t, 4> mPalette;   // ARGB color per plane combination, bit 0 the first plane
+    std::array<std::array<uint32_t, 8>, 256> mExpansion; // ARGB pixels for the 8 screen pixels of a byte of the first plane alone
+
     SDL_Window* mWindowP;
     SDL_Renderer* mRendererP;
     SDL_Texture* mTextureP;
+    SDL_AudioDeviceID mAudioDevice;     // 0 while no audio is playing
 };
@@ -0,0 +1,72 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+#include <memory>
+
+#include "quirks.hpp"
+
+using Byte = uint8_t;
+using Word = uint16_t;
+
+// Translates straight-line CHIP-8 code into x86-64 basic blocks.
+// A block runs the ALU and index instructions natively and ends at a jump or skip
+// (1NNN, 3XNN, 4XNN, 5XY0, 9XY0) or before any instruction it can not translate,
+// which the interpreter then executes. Only the first 4 KB of memory is translated, and skips are left
+// to the interpreter with the XO-CHIP instruction set, where they step over four byte instructions.
+// The code buffer is never writable and executable at once: blocks are emitted into pages made writable
+// and executable again afterwards, and invalidation only drops entries without touching code.
+class Jit {
+public:
+    static constexpr int MEMORY_SIZE = 4096;
+
+    // Compiled block, takes the V registry and the index registry and returns the next program counter
+    using Code = Word (*)(Byte* V, Word* indexRegistry);
+
+    struct Block {
+        Code code;
+        Word instructions;              // Instructions executed by one run of the block
+        Word last;                      // Last memory address the block was translated from
+    };
+
+    Jit();
+    ~Jit();
+
+    // Compiled code is never shared, a copy starts with an empty cache
+    Jit(const Jit& other);
+    Jit& operator=(const Jit& other);
+
+    bool isAvailable() const;
+    // Blocks are translated for one set of quirks, changing them drops every block
+    void setQuirks(const Quirks& quirks);
+
+    // Returns the block starting at address, compiling it on first use, or nullptr if there is none.
+    // memory holds at least MEMORY_SIZE bytes and address is below MEMORY_SIZE.
+    const Block* lookup(const Byte* memory, const Word address);
+
+    // Drops every block translated from a byte in [first, last]
+    void invalidate(const int first, const int last);
+    void flush();
+
+private:
+    struct Entry {
+        Block block;
+        bool translated;                // Translation was attempted, block.code is nullptr if it failed
+    };
+
+    bool compile(const Byte* memory, const Word address, Block& block);
+    // Makes the code pages a block compiled at offset first can use writable, or executable again
+    bool protect(const size_t first, const bool writable);
+    void emit(std::initializer_list<Byte> bytes);
+    void emit16(const Word value);
+    void emit32(const uint32_t value);
+
+    Quirks mQuirks;                     // Quirks the blocks are translated for
+    std::unique_ptr<Entry[]> mEntries;  // Block per start address, allocated on first lookup
+    uint16_t mCodePages;                // Bit per 256 byte page of memory that blocks were translated from
+
+    Byte* mCode;                        // Executable buffer, only writable while a block is compiled
+    size_t mCodeSize;
+    size_t mCodeUsed;
+};
@@ -0,0 +1,80 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "romcache.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+
+// Runs LANES machines on the same game with the registers of all machines stored by lane
+// (structure of arrays), so an ALU instruction executes for every lane with one SIMD operation.
+// The lane that is furthest behind leads a group of every lane at the same address with the same
+// instruction, and the group runs on together until a branch or the end of the run splits it.
+// The other lanes are masked out and catch up in later groups, so every lane ends in the same state
+// as a Chip8 with the same seed and keys run for the same number of cycles.
+//
+// Only the legacy quirk profile with the CHIP-8 instruction set, 4 KB and 64x32, is implemented, and
+// the engine has its own interpreter instead of a backend. Lanes that branch apart often, like games
+// depending on random numbers, run slower than the same machines run one after another by Chip8.
+class Lockstep {
+public:
+    static constexpr int LANES = 16;
+
+    // Lane i is initialized with seeds[i], ticksPerSecond is at least 1 as in Chip8::initialize
+    bool loadGame(const std::string& gameFilepath, const uint64_t ticksPerSecond, const std::array<uint64_t, LANES>& seeds);
+    // Loads from a shared image without any file access
+    bool loadGame(const Rom& rom, const uint64_t ticksPerSecond, const std::array<uint64_t, LANES>& seeds);
+
+    // Every lane executes cycles instructions
+    void runCycles(const uint64_t cycles);
+    void runFrame();
+
+    void setKeys(const int lane, const std::array<bool, 16>& keyState);
+
+    const std::array<Byte, 4096>& getMemory(const int lane) const;
+    const std::array<uint64_t, 32>& getGraphix(const int lane) const;
+    Word getProgramCounter(const int lane) const;
+    Word getIndexRegistry(const int lane) const;
+    std::array<Byte, 16> getVReg(const int lane) const;
+    Byte getDelayTimer(const int lane) const;
+    Byte getSoundTimer(const int lane) const;
+    const std::array<Word, 16>& getStack(const int lane) const;
+    Word getStackP(const int lane) const;
+    uint64_t getCycleCount(const int lane) const;
+
+private:
+    using Mask = uint32_t;              // Bit per lane
+
+    static constexpr Mask ALL_LANES = (1u << LANES) - 1;
+
+    // Lanes of lanes at the program counter of leader with the same instruction
+    Mask matchingLanes(const int leader, const Mask lanes) const;
+    static bool mayBranch(const Word operationCode);
+    void written(const Word address, const int count);
+    void execute(const Word operationCode, const Mask mask);
+    bool executeVector(const Word operationCode, const Mask mask);
+    void executeLane(const Word operationCode, const int lane);
+    void drawLane(const Byte X, const Byte Y, const Byte N, const int lane);
+
+    alignas(16) std::array<std::array<Byte, LANES>, 16> mV; // mV[register][lane]
+    std::array<Word, LANES> mProgramCounter;
+    std::array<Word, LANES> mIndexRegistry;
+    std::array<Byte, LANES> mDelayTimer;
+    std::array<Byte, LANES> mSoundTimer;
+    std::array<Word, LANES> mStackP;
+    std::array<uint64_t, LANES> mCycleCount;
+    std::array<uint64_t, LANES> mTimerAccumulator;
+    std::array<uint64_t, LANES> mRemaining; // Cycles left of the current runCycles
+
+    std::array<std::array<Word, 16>, LANES> mStack;
+    std::array<std::array<bool, 16>, LANES> mKeys;
+    std::array<RandomEngine, LANES> mRandom;
+    std::array<std::array<uint64_t, 32>, LANES> mGraphix;
+    std::array<std::array<Byte, 4096>, LANES> mMemory;
+
+    Word mWrittenFirst;                 // Memory of the lanes only differs in [mWrittenFirst, mWrittenLast]
+    Word mWrittenLast;
+    uint64_t mTicksPerSecond;
+    uint64_t mFrameAccumulator;
+};
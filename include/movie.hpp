@@ -0,0 +1,65 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "romcache.hpp"
+
+#include <array>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// Recorded input of a session, replayed by setting the same keys before the same frames.
+// Together with the seed, the instructions per second and the quirk profile this reproduces the session exactly.
+//
+// The file is little endian: the magic "C8MV", the version, the FNV-1a hash of the game, the seed,
+// the instructions per second, the length in frames and the quirk profile as a byte, followed by one event
+// per change of the keys, the frames since the previous event written 7 bits at a time and the 16 keys as a bit mask.
+// Version 1 files have no quirk profile and play with QuirkProfile::Legacy.
+class Movie {
+public:
+    static constexpr uint32_t VERSION = 2;
+
+    struct Event {
+        uint64_t frame;                 // Keys are set before this frame runs
+        uint16_t keys;                  // Bit per key
+    };
+
+    Movie();
+    Movie(const uint64_t gameHash, const uint64_t seed, const uint64_t ticksPerSecond,
+          const QuirkProfile quirkProfile = QuirkProfile::Legacy);
+
+    // Records the keys set before frame, only changes are stored
+    void record(const uint64_t frame, const std::array<bool, 16>& keyState);
+    // Drops every event from frame on, for continuing the recording after rewinding
+    void truncate(const uint64_t frame);
+    void setLength(const uint64_t frames);
+
+    bool save(const std::string& filepath) const;
+    bool load(const std::string& filepath);
+
+    // Initializes chip8 with the recorded seed, instructions per second and quirk profile and loads the game,
+    // false if the game is not the recorded one
+    bool start(Chip8& chip8, const std::string& gameFilepath) const;
+    bool start(Chip8& chip8, const Rom& game) const;
+    // Sets the keys recorded for frame on chip8, call with increasing frames before every runFrame
+    void apply(Chip8& chip8, const uint64_t frame, size_t& nextEvent) const;
+
+    uint64_t getGameHash() const;
+    uint64_t getSeed() const;
+    uint64_t getTicksPerSecond() const;
+    QuirkProfile getQuirkProfile() const;
+    uint64_t getLength() const;
+    const std::vector<Event>& getEvents() const;
+
+    static bool hashGame(const std::string& gameFilepath, uint64_t& hash);
+    static uint16_t packKeys(const std::array<bool, 16>& keyState);
+    static std::array<bool, 16> unpackKeys(const uint16_t keys);
+
+private:
+    uint64_t mGameHash;
+    uint64_t mSeed;
+    uint64_t mTicksPerSecond;
+    uint64_t mLength;                   // Frames in the session
+    QuirkProfile mQuirkProfile;
+    std::vector<Event> mEvents;         // Ordered by frame
+};
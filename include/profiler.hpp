@@ -0,0 +1,35 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#include <cstdint>
+#include <map>
+#include <ostream>
+#include <string>
+#include <vector>
+
+// Samples where a game spends its cycles. Every sample records the program counter and the
+// subroutines on the CHIP-8 stack, each found from the 2NNN its stack entry points at.
+// The driver runs the machine in steps of getInterval cycles and calls sample in between,
+// so the core itself is untouched.
+class Profiler {
+public:
+    // An interval that is no multiple of common loop lengths avoids sampling the same spot every time
+    explicit Profiler(const uint64_t interval = 997);
+
+    void sample(const Chip8& chip8);
+    void clear();
+
+    // Writes one line per distinct stack in the folded format of flamegraph.pl:
+    // "root;sub_0x2A4;...;0x2B0 ADD V1, 0x01 count", the leaf disassembled from memory
+    void writeFolded(std::ostream& os, const std::string& root, const std::vector<Byte>& memory) const;
+
+    uint64_t getInterval() const;
+    uint64_t getSamples() const;
+
+private:
+    uint64_t mInterval;
+    uint64_t mSamples;
+    std::map<std::vector<Word>, uint64_t> mStacks; // Called subroutines from the outermost, then the program counter
+    std::vector<Word> mStack;           // Reused by sample to avoid allocating
+};
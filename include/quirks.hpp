@@ -0,0 +1,79 @@
+#pragma once
+
+#include <cstddef>
+#include <string>
+
+// Behaviors that CHIP-8 interpreters disagree on. Chip8 instantiates the affected handlers for every
+// profile ahead of time and picks them while decoding, so no handler tests a quirk at runtime.
+struct Quirks {
+    enum class IndexIncrement {
+        None,                           // I is left unchanged
+        X,                              // I += X
+        XPlusOne,                       // I += X + 1, I ends after the last register
+    };
+
+    enum class SpriteEdge {
+        Line,                           // The screen is one line of pixels, past the right edge a sprite continues on the next row
+        Clip,                           // The position wraps around the screen, the sprite is cut off at the right and bottom edges
+        Wrap,                           // The position and every pixel of the sprite wrap around the screen
+    };
+
+    enum class InstructionSet {
+        Chip8,                          // 64x32, 4 KB
+        SuperChip,                      // Adds 128x64, scrolling, 16x16 sprites, the large font and the RPL flags
+        XoChip,                         // Adds two bitplanes, 64 KB, F000 NNNN, 5XY2/5XY3, 00DN, FN01, F002 and FX3A
+    };
+
+    bool shiftReadsVY;                  // 8XY6/8XYE set VX to VY shifted, otherwise VX is shifted in place
+    IndexIncrement loadStoreIndex;      // Change of I by FX55/FX65
+    SpriteEdge spriteEdge;              // Drawing of DXYN past the edges of the screen
+    bool jumpWithVX;                    // BXNN jumps to XNN + VX, otherwise BNNN to NNN + V0
+    bool logicResetsVF;                 // 8XY1/8XY2/8XY3 set VF to 0
+    bool flagWrittenLast;               // 8XY4 to 8XYE write VF after VX, otherwise VF first and VX from the changed registers
+    InstructionSet instructionSet;
+};
+
+enum class QuirkProfile {
+    Legacy,                             // This emulator before profiles existed, the default
+    CosmacVip,                          // The original interpreter of the COSMAC VIP
+    Chip48,                             // CHIP-48 on the HP-48
+    SuperChip,                          // SUPER-CHIP 1.1
+    Modern,                             // Most current interpreters, e.g. Octo
+    XoChip,                             // XO-CHIP as specified by Octo
+};
+
+constexpr Quirks LEGACY_QUIRKS = {
+    false, Quirks::IndexIncrement::None, Quirks::SpriteEdge::Line, false, false, false, Quirks::InstructionSet::Chip8};
+constexpr Quirks COSMAC_VIP_QUIRKS = {
+    true, Quirks::IndexIncrement::XPlusOne, Quirks::SpriteEdge::Clip, false, true, true, Quirks::InstructionSet::Chip8};
+constexpr Quirks CHIP48_QUIRKS = {
+    false, Quirks::IndexIncrement::X, Quirks::SpriteEdge::Clip, true, false, true, Quirks::InstructionSet::Chip8};
+constexpr Quirks SUPER_CHIP_QUIRKS = {
+    false, Quirks::IndexIncrement::None, Quirks::SpriteEdge::Clip, true, false, true, Quirks::InstructionSet::SuperChip};
+constexpr Quirks MODERN_QUIRKS = {
+    true, Quirks::IndexIncrement::XPlusOne, Quirks::SpriteEdge::Clip, false, false, true, Quirks::InstructionSet::Chip8};
+constexpr Quirks XO_CHIP_QUIRKS = {
+    true, Quirks::IndexIncrement::XPlusOne, Quirks::SpriteEdge::Wrap, false, false, true, Quirks::InstructionSet::XoChip};
+
+constexpr Quirks getQuirks(const QuirkProfile profile) {
+    switch (profile) {
+        case QuirkProfile::CosmacVip: return COSMAC_VIP_QUIRKS;
+        case QuirkProfile::Chip48: return CHIP48_QUIRKS;
+        case QuirkProfile::SuperChip: return SUPER_CHIP_QUIRKS;
+        case QuirkProfile::Modern: return MODERN_QUIRKS;
+        case QuirkProfile::XoChip: return XO_CHIP_QUIRKS;
+        case QuirkProfile::Legacy: break;
+    }
+    return LEGACY_QUIRKS;
+}
+
+// Bytes of memory of a machine with the instruction set of quirks
+constexpr size_t getMemorySize(const Quirks& quirks) {
+    return quirks.instructionSet == Quirks::InstructionSet::XoChip ? 0x10000 : 0x1000;
+}
+
+// Names as given on the command line: legacy, vip, chip48, schip, modern and xochip
+const char* getQuirkProfileName(const QuirkProfile profile);
+bool parseQuirkProfile(const std::string& name, QuirkProfile& profile);
+// True if value is the number of a profile, for profiles read from files
+bool isQuirkProfile(const int value);
@@ -0,0 +1,51 @@
+#pragma once
+
+#include <cstdint>
+#include <limits>
+
+// PCG32 (XSH RR) generator, 16 bytes of state and a few instructions per number.
+// Satisfies UniformRandomBitGenerator, so it can be swapped for any standard engine.
+class Pcg32 {
+public:
+    using result_type = uint32_t;
+
+    Pcg32() : Pcg32(0) {}
+
+    explicit Pcg32(const uint64_t seed, const uint64_t stream = 0xDA3E39CB94B95BDB) {
+        reseed(seed, stream);
+    }
+
+    void reseed(const uint64_t seed, const uint64_t stream) {
+        mState = 0;
+        mIncrement = (stream << 1) | 1;
+        (*this)();
+        mState += seed;
+        (*this)();
+    }
+
+    result_type operator()() {
+        uint64_t state = mState;
+        mState = state * 6364136223846793005ULL + mIncrement;
+
+        uint32_t xorShifted = ((state >> 18) ^ state) >> 27;
+        uint32_t rotation = state >> 59;
+        return (xorShifted >> rotation) | (xorShifted << ((-rotation) & 31));
+    }
+
+    // Raw generator state, for saving and restoring it exactly
+    uint64_t getState() const { return mState; }
+    uint64_t getIncrement() const { return mIncrement; }
+    void restore(const uint64_t state, const uint64_t increment) {
+        mState = state;
+        mIncrement = increment | 1;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return std::numeric_limits<result_type>::max(); }
+
+    bool operator==(const Pcg32& other) const = default;
+
+private:
+    uint64_t mState;
+    uint64_t mIncrement;
+};
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "aot.hpp"
+#include "quirks.hpp"
+
+using Byte = uint8_t;
+using Word = uint16_t;
+
+// Compiles a game ahead of time into C++. The control flow graph is recovered from 0x200 by following
+// jumps, calls and their returns and both ways out of every skip. Every reachable address where a block
+// can start becomes a function running the instructions the Jit would translate, with the same signature,
+// so Chip8 calls them like Jit blocks. Code behind computed jumps (BNNN) is never reached by the analysis
+// and, like every other instruction outside a block, left to the interpreter.
+class Recompiler {
+public:
+    struct Block {
+        Word address;
+        Word last;                      // Last byte of the game the block was compiled from
+        Word instructions;
+    };
+
+    // data is the game as loaded to 0x200
+    Recompiler(const Byte* data, const size_t size, const QuirkProfile profile);
+
+    // Addresses of every instruction the analysis reached
+    const std::vector<Word>& getReached() const;
+    const std::vector<Block>& getBlocks() const;
+
+    // Writes a translation unit registering the program as name, see aot.hpp
+    void write(std::ostream& os, const std::string& name) const;
+    // Writes every reached instruction disassembled, blocks starting at the addresses marked with '>'
+    void writeListing(std::ostream& os) const;
+
+private:
+    bool isInGame(const int address) const;
+    Word getOperationCode(const int address) const;
+    // Instruction at address runs in a block, 1NNN and the skips end it
+    bool isTranslated(const int address) const;
+    bool isTerminator(const Word operationCode) const;
+    // Addresses the program counter can take after the instruction at address
+    std::vector<int> getSuccessors(const int address) const;
+
+    void analyze();
+    // Appends the statements of a translated instruction, or the return of the block for a terminator
+    void writeInstruction(std::ostream& os, const int address) const;
+
+    const Byte* mData;
+    const size_t mSize;
+    const QuirkProfile mProfile;
+    const Quirks mQuirks;
+
+    std::vector<Word> mReached;         // Sorted
+    std::vector<Block> mBlocks;         // Sorted by address
+};
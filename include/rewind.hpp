@@ -0,0 +1,50 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <vector>
+
+// Ring buffer of the states of the last frames, for stepping a game backward.
+// Every keyframeInterval frames a state is stored whole, the frames in between only as the
+// run length encoded XOR against that keyframe, so any frame is restored from two decodes.
+// The oldest keyframe and its frames are dropped once the buffer holds more than maxFrames or budgetBytes,
+// the newest keyframe is always kept.
+class Rewind {
+public:
+    Rewind(const size_t maxFrames, const size_t budgetBytes, const size_t keyframeInterval = 60);
+
+    void push(const Chip8::State& state);
+
+    // Removes the newest frame and returns it in state, false when the buffer is empty
+    bool pop(Chip8::State& state);
+    void clear();
+
+    size_t getFrames() const;
+    size_t getBytes() const;            // Encoded bytes of all frames held
+    double getBytesPerSecond() const;   // Encoded bytes per second of history at 60 frames per second
+
+private:
+    struct Frame {
+        std::vector<Byte> data;         // Run length encoded XOR against the keyframe, or zeros for a keyframe
+        size_t size;                    // Serialized size of the state, keyframes differ after a change of memory size
+        bool keyframe;
+    };
+
+    static void encode(const std::vector<Byte>& state, const std::vector<Byte>& base, std::vector<Byte>& data);
+    static void decode(const std::vector<Byte>& data, std::vector<Byte>& state);
+    void restoreKeyframe();
+
+    std::deque<Frame> mFrames;
+    std::vector<Byte> mKeyframe;        // Serialized newest keyframe in mFrames
+    std::vector<Byte> mZeros;           // Base of keyframes, as large as the newest one
+    size_t mSinceKeyframe;              // Frames pushed since the newest keyframe
+    size_t mKeyframes;                  // Keyframes in mFrames
+    size_t mBytes;
+
+    const size_t mMaxFrames;
+    const size_t mBudgetBytes;
+    const size_t mKeyframeInterval;
+};
@@ -0,0 +1,69 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstddef>
+
+// Bounded lock-free queue between one producer thread and one consumer thread.
+// Capacity must be a power of two, a full queue rejects new values instead of waiting.
+template <typename T, size_t Capacity>
+class RingBuffer {
+    static_assert(Capacity > 0 && (Capacity & (Capacity - 1)) == 0, "Capacity must be a power of two");
+
+public:
+    // Producer thread, fill writes the value into its slot, for values too large to copy twice
+    template <typename Fill>
+    bool pushWith(Fill fill) {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mTail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        fill(mValues[head & (Capacity - 1)]);
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Producer thread
+    bool push(const T& value) {
+        const size_t head = mHead.load(std::memory_order_relaxed);
+        if (head - mTail.load(std::memory_order_acquire) == Capacity) {
+            return false;
+        }
+        mValues[head & (Capacity - 1)] = value;
+        mHead.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread, read gets the value in its slot, which is released after read returns
+    template <typename Read>
+    bool popWith(Read read) {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHead.load(std::memory_order_acquire)) {
+            return false;
+        }
+        read(static_cast<const T&>(mValues[tail & (Capacity - 1)]));
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Consumer thread
+    bool pop(T& value) {
+        const size_t tail = mTail.load(std::memory_order_relaxed);
+        if (tail == mHead.load(std::memory_order_acquire)) {
+            return false;
+        }
+        value = mValues[tail & (Capacity - 1)];
+        mTail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    // Exact on the consumer thread, a lower bound on the producer thread
+    size_t size() const {
+        return mHead.load(std::memory_order_acquire) - mTail.load(std::memory_order_acquire);
+    }
+
+private:
+    std::array<T, Capacity> mValues{};
+    alignas(64) std::atomic<size_t> mHead{0}; // Next value written
+    alignas(64) std::atomic<size_t> mTail{0}; // Next value read
+};
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using Byte = uint8_t;
+
+// Read-only copy of a game file. Games are at most 64 KB, so they are read instead of memory mapped,
+// which would crash with SIGBUS when the file is truncated and change under a hash taken before.
+class Rom {
+public:
+    // Largest game any instruction set loads, 64 KB of XO-CHIP memory from 0x200 on
+    static constexpr size_t MAX_SIZE = 0x10000 - 0x200;
+
+    Rom(const Rom&) = delete;
+    Rom& operator=(const Rom&) = delete;
+
+    // nullptr if the file can not be read or is larger than MAX_SIZE
+    static std::shared_ptr<const Rom> open(const std::string& filepath);
+    // 64 bit FNV-1a, the hash Movie records for its game
+    static uint64_t hash(const Byte* data, const size_t size);
+
+    const Byte* getData() const;
+    size_t getSize() const;
+    uint64_t getHash() const;
+
+private:
+    Rom() = default;
+
+    std::vector<Byte> mBuffer;
+    uint64_t mHash = 0;
+};
+
+// Opens every game once and hands out shared images, files with the same contents share one image.
+// A file is opened again when its size or modification time changes, the image it had is dropped once
+// no other file has it. Thread safe.
+class RomCache {
+public:
+    // nullptr if the file can not be read or is larger than Rom::MAX_SIZE
+    std::shared_ptr<const Rom> load(const std::string& filepath) const;
+    // Distinct images held
+    size_t getSize() const;
+    void clear();
+
+private:
+    struct File {
+        std::filesystem::file_time_type modified;
+        uintmax_t size;
+        std::shared_ptr<const Rom> rom;
+    };
+
+    mutable std::mutex mMutex;
+    mutable std::unordered_map<std::string, File> mFiles;                   // By path as given
+    mutable std::unordered_map<uint64_t, std::shared_ptr<const Rom>> mRoms; // By content hash
+};
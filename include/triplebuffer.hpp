@@ -0,0 +1,44 @@
+#pragma once
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+
+// Lock-free hand-over of values from one writer thread to one reader thread.
+// The writer always has a buffer to write and the reader a buffer to read, the third is the newest
+// published one. Publishing and taking swap an index with the middle buffer, neither ever waits,
+// and the reader skips values published while it was busy.
+template <typename T>
+class TripleBuffer {
+public:
+    // Writer thread
+    T& getWriteBuffer() {
+        return mBuffers[mWrite];
+    }
+
+    void publish() {
+        mWrite = mMiddle.exchange(mWrite | FRESH, std::memory_order_acq_rel) & INDEX;
+    }
+
+    // Reader thread, returns false and keeps the read buffer when nothing new was published
+    bool update() {
+        if ((mMiddle.load(std::memory_order_relaxed) & FRESH) == 0) {
+            return false;
+        }
+        mRead = mMiddle.exchange(mRead, std::memory_order_acq_rel) & INDEX;
+        return true;
+    }
+
+    const T& getReadBuffer() const {
+        return mBuffers[mRead];
+    }
+
+private:
+    static constexpr uint8_t INDEX = 0x03;
+    static constexpr uint8_t FRESH = 0x04; // Middle buffer published and not yet taken
+
+    std::array<T, 3> mBuffers{};
+    alignas(64) std::atomic<uint8_t> mMiddle{1};
+    alignas(64) uint8_t mWrite = 0;     // Only touched by the writer
+    alignas(64) uint8_t mRead = 2;      // Only touched by the reader
+};
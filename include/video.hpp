@@ -0,0 +1,75 @@
+#pragma once
+
+#include "chip8.hpp"
+#include "framesink.hpp"
+#include "ringbuffer.hpp"
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <thread>
+
+enum class VideoFormat {
+    Y4m,                                // YUV4MPEG2 with only the luma plane (Cmono), 128x64 at 60 frames per second
+    Raw,                                // 128x64 gray bytes per frame without header, ffmpeg -f rawvideo -pix_fmt gray -s 128x64 -r 60
+    Hash,                               // A line per frame: number, resolution and FNV-1a hash of the framebuffer words
+};
+
+// Names as given on the command line: y4m, raw and hash
+bool parseVideoFormat(const std::string& name, VideoFormat& format);
+
+// Streams the frames of a machine to a file or pipe. frame() copies the packed framebuffer straight from the
+// machine into a slot of a bounded queue, the writer thread turns the slot into pixels and writes them,
+// so the emulation thread never converts or writes.
+//
+// Low resolution frames are scaled to 128x64, so a stream keeps one size across resolution changes. The planes
+// become the gray levels of the window: 0 for none, 255 for the first, 85 for the second and 170 for both.
+class VideoWriter : public FrameSink {
+public:
+    static constexpr size_t QUEUE_FRAMES = 64;
+
+    // filepath "-" writes to stdout. With dropWhenFull a frame arriving at a full queue is dropped and counted,
+    // which keeps real time emulation at speed, otherwise frame() waits for the writer so no frame is lost.
+    VideoWriter(const std::string& filepath, const VideoFormat format, const bool dropWhenFull = false);
+    ~VideoWriter() override;
+
+    VideoWriter(const VideoWriter&) = delete;
+    VideoWriter& operator=(const VideoWriter&) = delete;
+
+    bool isOpen() const;
+    void frame(const Chip8& chip8) override;
+    // Writes the queued frames and closes the output, false if any write failed
+    bool finish();
+
+    uint64_t getFrames() const;         // Frames queued
+    uint64_t getDropped() const;
+
+private:
+    struct Frame {
+        Chip8::Graphix graphix;
+        uint64_t number;
+        bool highResolution;
+    };
+
+    void write();
+    void encode(const Frame& frame);
+
+    std::FILE* mFile;
+    const VideoFormat mFormat;
+    const bool mDropWhenFull;
+
+    RingBuffer<Frame, QUEUE_FRAMES> mQueue;
+    std::atomic<uint64_t> mSignals{0};  // Bumped after every push and on finish, the writer waits on it
+    std::atomic<uint64_t> mWritten{0};  // Frames written, a waiting frame() waits on it
+    std::atomic<bool> mFinishing{false};
+    std::atomic<bool> mFailed{false};
+    std::thread mWriter;
+
+    // Only touched by the emulation thread
+    uint64_t mFrames = 0;
+    uint64_t mDropped = 0;
+
+    std::array<Byte, 128 * 64> mPixels; // Only touched by the writer thread
+};
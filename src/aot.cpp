@@ -0,0 +1,23 @@
+#include "aot.hpp"
+
+#include <vector>
+
+// Filled before main by the static initializers of the generated translation units, only read afterwards
+static std::vector<const AotProgram*>& programs() {
+    static std::vector<const AotProgram*> registered;
+    return registered;
+}
+
+bool registerAotProgram(const AotProgram* program) {
+    programs().push_back(program);
+    return true;
+}
+
+const AotProgram* findAotProgram(const uint64_t hash, const size_t size, const QuirkProfile profile) {
+    for (const AotProgram* program : programs()) {
+        if (program->hash == hash && program->size == size && program->profile == profile) {
+            return program;
+        }
+    }
+    return nullptr;
+}
@@ -0,0 +1,43 @@
+#include "audio.hpp"
+
+Beeper::Beeper(const int sampleRate, const double frequency, const int16_t amplitude) :
+mSamplesPerTick(sampleRate / 60), mPhaseStep(uint32_t(frequency / sampleRate * 4294967296.0)), mAmplitude(amplitude),
+mPhase(0), mTickSamples(0), mActive(false)
+{
+}
+
+void Beeper::tick(const bool active) {
+    // A full ring means the audio thread is not running, the tick is lost either way
+    mTicks.push(active ? 1 : 0);
+}
+
+void Beeper::render(int16_t* samples, const size_t count) {
+    for (size_t sample = 0; sample < count; sample++) {
+        if (mTickSamples == 0) {
+            uint8_t active = 0;
+            while (mTicks.size() > MAX_QUEUED_TICKS) {
+                mTicks.pop(active);
+            }
+
+            if (mTicks.pop(active)) {
+                mActive = active != 0;
+                mTickSamples = mSamplesPerTick;
+            }
+            else {
+                mActive = false;
+            }
+        }
+
+        if (mActive) {
+            samples[sample] = (mPhase & 0x80000000) != 0 ? mAmplitude : -mAmplitude;
+            mPhase += mPhaseStep;
+        }
+        else {
+            samples[sample] = 0;
+        }
+
+        if (mTickSamples > 0) {
+            mTickSamples--;
+        }
+    }
+}
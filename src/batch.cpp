@@ -0,0 +1,202 @@
+#include "batch.hpp"
+
+#include <algorithm>
+
+#ifdef __linux__
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+// Instances per chunk, small enough to balance and large enough to keep neighbouring instances on one core
+static constexpr size_t CHUNK_SIZE = 8;
+
+Batch::Batch(const size_t instances, const size_t threads) :
+mInstances(instances), mGeneration(0), mFrames(0), mRemaining(0), mStopping(false)
+{
+    size_t workers = threads;
+    if (workers == 0) {
+        workers = std::max<size_t>(std::thread::hardware_concurrency(), 1);
+    }
+
+    mQueues = std::vector<Queue>(workers);
+    for (size_t worker = 0; worker < workers; worker++) {
+        mWorkers.emplace_back(&Batch::work, this, worker);
+
+#ifdef __linux__
+        // Pin each worker to its own core so its instances stay in that core's caches
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(worker % std::max<size_t>(std::thread::hardware_concurrency(), 1), &cpus);
+        pthread_setaffinity_np(mWorkers.back().native_handle(), sizeof(cpus), &cpus);
+#endif
+    }
+}
+
+Batch::~Batch() {
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopping = true;
+    }
+    mStart.notify_all();
+
+    for (auto & worker : mWorkers) {
+        worker.join();
+    }
+}
+
+bool Batch::loadGame(const std::string& gameFilepath, const uint64_t ticksPerSecond, const uint64_t seed) {
+    const std::shared_ptr<const Rom> rom = Rom::open(gameFilepath);
+    return rom != nullptr && loadGame(*rom, ticksPerSecond, seed);
+}
+
+bool Batch::loadGame(const Rom& rom, const uint64_t ticksPerSecond, const uint64_t seed) {
+    mGolden.clear();
+    if (mInstances.empty()) {
+        return true;
+    }
+
+    mInstances[0].initialize(ticksPerSecond, seed);
+    if (!mInstances[0].loadGame(rom.getData(), rom.getSize())) {
+        return false;
+    }
+
+    // Forks share the decoded game with the first instance and differ only in the generator
+    Chip8::State state = mInstances[0].saveState();
+    for (size_t instance = 0; instance < mInstances.size(); instance++) {
+        if (instance > 0) {
+            mInstances[instance] = mInstances[0];
+        }
+        state.random = RandomEngine(seed + instance);
+        mInstances[instance].loadState(state);
+        mGolden.push_back(state);
+    }
+    return true;
+}
+
+void Batch::reset() {
+    for (size_t instance = 0; instance < mGolden.size(); instance++) {
+        mInstances[instance].loadState(mGolden[instance]);
+    }
+}
+
+void Batch::setBackend(const Backend backend) {
+    for (auto & instance : mInstances) {
+        instance.setBackend(backend);
+    }
+}
+
+void Batch::setAotProgram(const AotProgram* program) {
+    for (auto & instance : mInstances) {
+        instance.setAotProgram(program);
+    }
+}
+
+void Batch::setQuirkProfile(const QuirkProfile profile) {
+    for (auto & instance : mInstances) {
+        instance.setQuirkProfile(profile);
+    }
+}
+
+void Batch::runFrames(const uint64_t frames) {
+    if (mInstances.empty()) {
+        return;
+    }
+
+    const size_t chunks = (mInstances.size() + CHUNK_SIZE - 1) / CHUNK_SIZE;
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mFrames = frames;
+        mRemaining = chunks;
+    }
+
+    // Neighbouring chunks go to the same worker, stealing only happens when the load is uneven.
+    // A worker still busy with the previous run may already pick these up, mFrames is set before.
+    const size_t chunksPerWorker = (chunks + mQueues.size() - 1) / mQueues.size();
+    for (size_t chunk = 0; chunk < chunks; chunk++) {
+        Queue& queue = mQueues[chunk / chunksPerWorker];
+        std::lock_guard<std::mutex> lock(queue.mutex);
+        queue.chunks.push_back({chunk * CHUNK_SIZE, std::min((chunk + 1) * CHUNK_SIZE, mInstances.size())});
+    }
+
+    std::unique_lock<std::mutex> lock(mMutex);
+    mGeneration++;
+    mStart.notify_all();
+
+    mDone.wait(lock, [this] { return mRemaining == 0; });
+}
+
+bool Batch::takeChunk(const size_t worker, Chunk& chunk) {
+    {
+        Queue& own = mQueues[worker];
+        std::lock_guard<std::mutex> lock(own.mutex);
+        if (!own.chunks.empty()) {
+            chunk = own.chunks.front();
+            own.chunks.pop_front();
+            return true;
+        }
+    }
+
+    for (size_t offset = 1; offset < mQueues.size(); offset++) {
+        Queue& victim = mQueues[(worker + offset) % mQueues.size()];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+        if (!victim.chunks.empty()) {
+            chunk = victim.chunks.back();
+            victim.chunks.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void Batch::work(const size_t worker) {
+    uint64_t generation = 0;
+
+    while (true) {
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mStart.wait(lock, [&] { return mStopping || mGeneration != generation; });
+            if (mStopping) {
+                return;
+            }
+            generation = mGeneration;
+        }
+
+        Chunk chunk;
+        while (takeChunk(worker, chunk)) {
+            for (size_t instance = chunk.first; instance < chunk.last; instance++) {
+                for (uint64_t frame = 0; frame < mFrames; frame++) {
+                    mInstances[instance].runFrame();
+                }
+            }
+
+            if (--mRemaining == 0) {
+                std::lock_guard<std::mutex> lock(mMutex);
+                mDone.notify_all();
+            }
+        }
+    }
+}
+
+void Batch::setKeys(const size_t instance, const std::array<bool, 16>& keyState) {
+    mInstances[instance].setKeys(keyState);
+}
+
+const Chip8::Graphix& Batch::getGraphix(const size_t instance) const {
+    return mInstances[instance].getGraphix();
+}
+
+Chip8& Batch::getInstance(const size_t instance) {
+    return mInstances[instance];
+}
+
+const Chip8& Batch::getInstance(const size_t instance) const {
+    return mInstances[instance];
+}
+
+size_t Batch::getSize() const {
+    return mInstances.size();
+}
+
+size_t Batch::getThreads() const {
+    return mWorkers.size();
+}
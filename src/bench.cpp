@@ -0,0 +1,733 @@
+#include <batch.hpp>
+#include <chip8.hpp>
+#include <lockstep.hpp>
+#include <movie.hpp>
+#include <profiler.hpp>
+#include <romcache.hpp>
+#include <video.hpp>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+using Clock = std::chrono::steady_clock;
+
+// Opcode classes by their most significant nibble
+const std::array<std::string, 16> OPCODE_CLASSES = {
+    "0NNN", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+    "8XYN", "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EXNN", "FXNN"
+};
+
+struct Options {
+    std::vector<std::string> romFilepaths;
+    uint64_t cycles = 0;                // Cycles per repetition, 0 to run frames instead
+    uint64_t frames = 600;              // Frames per repetition
+    uint64_t ticksPerSecond = 1000000;  // Instructions per second, decides the cycles in a frame
+    uint64_t repetitions = 10;
+    uint64_t seed = 1;                  // Fixed so every repetition runs the same instructions
+    uint64_t batch = 0;                 // Instances in batch mode, 0 to bench single instances
+    uint64_t threads = 0;               // Most worker threads in batch mode, 0 for all hardware threads
+    bool lockstep = false;              // Run Lockstep::LANES machines per game in lockstep instead
+    std::string profileFilepath;        // Folded stacks of every game are written here when set
+    std::string replayFilepath;         // Movie replayed on every game instead of running without input
+    std::string videoFilepath;          // Frames of every game are streamed here when set, "-" for stdout
+    VideoFormat videoFormat = VideoFormat::Y4m;
+    Movie replay;
+    RomCache roms;                      // Every game is read once for all repetitions, batches and backends
+    Backend backend = Backend::Interpreter;
+    QuirkProfile quirkProfile = QuirkProfile::Legacy;
+    std::string format = "json";
+    std::string outputFilepath;
+};
+
+struct Percentiles {
+    double min;
+    double p50;
+    double p90;
+    double p99;
+    double max;
+    double mean;
+};
+
+struct RomReport {
+    std::string romFilepath;
+    uint64_t cyclesPerRepetition;
+    uint64_t elidedCycles;              // Of cyclesPerRepetition, fast-forwarded in idle loops
+    Percentiles instructionsPerSecond;
+    Percentiles nsPerInstruction;
+    Percentiles frameTimeUs;            // Only filled when running frames
+    bool hasFrames;
+    std::array<uint64_t, 16> opcodeClassCounts;
+    Counters counters;                  // Of the last timed repetition, only filled with CHIP8_INSTRUMENTATION
+    bool profiled = false;
+    uint64_t profileSamples = 0;
+    double profileOverheadPercent = 0;  // Profiled run against the median timed repetition
+};
+
+struct LockstepReport {
+    std::string romFilepath;
+    Percentiles instructionsPerSecond;  // Instructions of all lanes together
+};
+
+struct BatchReport {
+    std::string romFilepath;
+    uint64_t threads;
+    Percentiles instructionsPerSecond;
+    double speedup;                     // Median instructions per second relative to one thread
+};
+
+static void usage() {
+    std::cout << "\nUsage: 'chip8-bench [options] <filepath>...'" << std::endl;
+    std::cout << "  filepath            <required>      path to one or more game binaries" << std::endl;
+    std::cout << "  --cycles <n>        [optional]      run n cycles per repetition instead of frames" << std::endl;
+    std::cout << "  --frames <n>        [optional]      frames per repetition (default 600)" << std::endl;
+    std::cout << "  --ips <n>           [optional]      instructions per second when running frames (default 1000000)" << std::endl;
+    std::cout << "  --repetitions <n>   [optional]      repetitions per game (default 10)" << std::endl;
+    std::cout << "  --backend <name>    [optional]      interpreter, jit or aot (default interpreter)" << std::endl;
+    std::cout << "  --quirks <profile>  [optional]      legacy, vip, chip48, schip, modern or xochip (default legacy)" << std::endl;
+    std::cout << "  --seed <n>          [optional]      seed for CXNN random numbers (default 1)" << std::endl;
+    std::cout << "  --batch <n>         [optional]      run n instances per game on a thread pool instead" << std::endl;
+    std::cout << "  --threads <n>       [optional]      most worker threads in batch mode (default all)" << std::endl;
+    std::cout << "  --lockstep <0|1>    [optional]      run the SIMD lockstep engine on every game instead, legacy only," << std::endl;
+    std::cout << "                                      faster than the interpreter only while machines do not diverge" << std::endl;
+    std::cout << "  --profile <filepath>[optional]      write folded guest call stacks of every game for flamegraph.pl" << std::endl;
+    std::cout << "  --replay <filepath> [optional]      replay a movie recorded with chip8 --record, its frames, seed and ips" << std::endl;
+    std::cout << "  --video <filepath>  [optional]      stream the frames of every game to a file, - for stdout" << std::endl;
+    std::cout << "  --video-format <f>  [optional]      y4m, raw or hash (default y4m)" << std::endl;
+    std::cout << "  --format <json|csv> [optional]      report format (default json)" << std::endl;
+    std::cout << "  --output <filepath> [optional]      write the report to a file instead of stdout" << std::endl;
+    std::cout << "\nArguments in <> are required and arguments in [] are optional" << std::endl;
+}
+
+static Percentiles percentiles(std::vector<double> samples) {
+    std::sort(samples.begin(), samples.end());
+
+    // Nearest rank percentile
+    auto rank = [&](double percent) {
+        size_t index = static_cast<size_t>(percent / 100.0 * (samples.size() - 1) + 0.5);
+        return samples[index];
+    };
+
+    double sum = 0;
+    for (const auto & sample : samples) {
+        sum += sample;
+    }
+
+    return {samples.front(), rank(50), rank(90), rank(99), samples.back(), sum / samples.size()};
+}
+
+static bool loadMachine(Chip8& chip8, const Options& options, const std::string& romFilepath) {
+    const std::shared_ptr<const Rom> rom = options.roms.load(romFilepath);
+    if (rom == nullptr) {
+        return false;
+    }
+
+    chip8.setBackend(options.backend);
+    if (!options.replayFilepath.empty()) {
+        if (!options.replay.start(chip8, *rom)) {
+            return false;
+        }
+    }
+    else {
+        // The profile sizes the memory the game is loaded into
+        chip8.setQuirkProfile(options.quirkProfile);
+        chip8.initialize(options.ticksPerSecond, options.seed);
+        if (!chip8.loadGame(rom->getData(), rom->getSize())) {
+            return false;
+        }
+    }
+
+    if (options.backend == Backend::Aot) {
+        chip8.setAotProgram(findAotProgram(rom->getHash(), rom->getSize(), options.quirkProfile));
+    }
+    return true;
+}
+
+static bool benchRom(const Options& options, const std::string& romFilepath, RomReport& report) {
+    Chip8 chip8;
+    std::vector<double> instructionsPerSecond;
+    std::vector<double> nsPerInstruction;
+    std::vector<double> frameTimeUs;
+
+    report.romFilepath = romFilepath;
+    report.hasFrames = options.cycles == 0;
+
+    for (uint64_t repetition = 0; repetition < options.repetitions; repetition++) {
+        if (!loadMachine(chip8, options, romFilepath)) {
+            return false;
+        }
+
+        size_t nextEvent = 0;
+        Clock::time_point start = Clock::now();
+        if (report.hasFrames) {
+            for (uint64_t frame = 0; frame < options.frames; frame++) {
+                Clock::time_point frameStart = Clock::now();
+                options.replay.apply(chip8, frame, nextEvent);
+                chip8.runFrame();
+                frameTimeUs.push_back(std::chrono::duration<double, std::micro>(Clock::now() - frameStart).count());
+            }
+        }
+        else {
+            chip8.runCycles(options.cycles);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        report.cyclesPerRepetition = chip8.getCycleCount();
+        report.elidedCycles = chip8.getElidedCycles();
+        report.counters = chip8.getCounters();
+        instructionsPerSecond.push_back(chip8.getCycleCount() / seconds);
+        nsPerInstruction.push_back(seconds * 1e9 / chip8.getCycleCount());
+    }
+
+    report.instructionsPerSecond = percentiles(instructionsPerSecond);
+    report.nsPerInstruction = percentiles(nsPerInstruction);
+    if (report.hasFrames) {
+        report.frameTimeUs = percentiles(frameTimeUs);
+    }
+
+    // Separate untimed pass that classifies every executed instruction
+    report.opcodeClassCounts.fill(0);
+    if (!loadMachine(chip8, options, romFilepath)) {
+        return false;
+    }
+    if (!report.hasFrames) {
+        for (uint64_t cycle = 0; cycle < report.cyclesPerRepetition; cycle++) {
+            report.opcodeClassCounts[chip8.getMemory()[chip8.getProgramCounter()] >> 4]++;
+            chip8.emulateCycle();
+        }
+        return true;
+    }
+
+    // Frames end where runFrame would end them, so replayed keys change before the same instructions
+    size_t nextEvent = 0;
+    for (uint64_t frame = 0; frame < options.frames; frame++) {
+        options.replay.apply(chip8, frame, nextEvent);
+        const uint64_t frameEnd = (frame + 1) * options.ticksPerSecond / 60;
+        while (chip8.getCycleCount() < frameEnd) {
+            report.opcodeClassCounts[chip8.getMemory()[chip8.getProgramCounter()] >> 4]++;
+            chip8.emulateCycle();
+        }
+    }
+    return true;
+}
+
+// Runs one more repetition stopping every profiler interval cycles to sample,
+// the same frames and keys as the timed repetitions so its time shows the overhead
+static bool profileRom(const Options& options, const std::string& romFilepath, RomReport& report, Profiler& profiler, Chip8& chip8) {
+    if (!loadMachine(chip8, options, romFilepath)) {
+        return false;
+    }
+
+    const uint64_t frames = report.hasFrames ? options.frames : 1;
+    uint64_t nextSample = profiler.getInterval();
+    size_t nextEvent = 0;
+
+    Clock::time_point start = Clock::now();
+    for (uint64_t frame = 0; frame < frames; frame++) {
+        options.replay.apply(chip8, frame, nextEvent);
+        const uint64_t frameEnd = report.hasFrames ? (frame + 1) * options.ticksPerSecond / 60 : options.cycles;
+        while (chip8.getCycleCount() < frameEnd) {
+            chip8.runCycles(std::min(frameEnd, nextSample) - chip8.getCycleCount());
+            if (chip8.getCycleCount() == nextSample) {
+                profiler.sample(chip8);
+                nextSample += profiler.getInterval();
+            }
+        }
+    }
+    double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+    report.profiled = true;
+    report.profileSamples = profiler.getSamples();
+    report.profileOverheadPercent = (seconds * report.instructionsPerSecond.p50 / chip8.getCycleCount() - 1.0) * 100.0;
+    return true;
+}
+
+// Runs one more untimed repetition with the writer as frame sink, the same frames and keys as the timed ones
+static bool exportRom(const Options& options, const std::string& romFilepath, VideoWriter& writer) {
+    Chip8 chip8;
+    if (!loadMachine(chip8, options, romFilepath)) {
+        return false;
+    }
+
+    chip8.setFrameSink(&writer);
+    size_t nextEvent = 0;
+    for (uint64_t frame = 0; frame < options.frames; frame++) {
+        options.replay.apply(chip8, frame, nextEvent);
+        chip8.runFrame();
+    }
+    chip8.setFrameSink(nullptr);
+    return true;
+}
+
+// Runs the batch with 1, 2, 4, ... up to options.threads workers to show the scaling
+static bool benchBatch(const Options& options, const std::string& romFilepath, std::vector<BatchReport>& reports) {
+    const uint64_t maxThreads = options.threads == 0 ? std::max(std::thread::hardware_concurrency(), 1u) : options.threads;
+    double singleThread = 0;
+
+    for (uint64_t threads = 1; ; threads = std::min(threads * 2, maxThreads)) {
+        Batch batch(options.batch, threads);
+        std::vector<double> instructionsPerSecond;
+
+        for (uint64_t repetition = 0; repetition < options.repetitions; repetition++) {
+            batch.setQuirkProfile(options.quirkProfile);
+            const std::shared_ptr<const Rom> rom = options.roms.load(romFilepath);
+            if (rom == nullptr || !batch.loadGame(*rom, options.ticksPerSecond, options.seed)) {
+                return false;
+            }
+            batch.setBackend(options.backend);
+            if (options.backend == Backend::Aot) {
+                batch.setAotProgram(findAotProgram(rom->getHash(), rom->getSize(), options.quirkProfile));
+            }
+
+            Clock::time_point start = Clock::now();
+            batch.runFrames(options.frames);
+            double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+            uint64_t instructions = 0;
+            for (size_t instance = 0; instance < batch.getSize(); instance++) {
+                instructions += batch.getInstance(instance).getCycleCount();
+            }
+            instructionsPerSecond.push_back(instructions / seconds);
+        }
+
+        BatchReport report = {romFilepath, threads, percentiles(instructionsPerSecond), 1};
+        if (threads == 1) {
+            singleThread = report.instructionsPerSecond.p50;
+        }
+        report.speedup = report.instructionsPerSecond.p50 / singleThread;
+        reports.push_back(report);
+
+        if (threads == maxThreads) {
+            return true;
+        }
+    }
+}
+
+static bool benchLockstep(const Options& options, const std::string& romFilepath, LockstepReport& report) {
+    static Lockstep lockstep;           // Too large for the stack
+    std::vector<double> instructionsPerSecond;
+
+    const std::shared_ptr<const Rom> rom = options.roms.load(romFilepath);
+    if (rom == nullptr) {
+        return false;
+    }
+
+    std::array<uint64_t, Lockstep::LANES> seeds;
+    for (int lane = 0; lane < Lockstep::LANES; lane++) {
+        seeds[lane] = options.seed + lane;
+    }
+
+    for (uint64_t repetition = 0; repetition < options.repetitions; repetition++) {
+        if (!lockstep.loadGame(*rom, options.ticksPerSecond, seeds)) {
+            return false;
+        }
+
+        Clock::time_point start = Clock::now();
+        if (options.cycles == 0) {
+            for (uint64_t frame = 0; frame < options.frames; frame++) {
+                lockstep.runFrame();
+            }
+        }
+        else {
+            lockstep.runCycles(options.cycles);
+        }
+        double seconds = std::chrono::duration<double>(Clock::now() - start).count();
+
+        uint64_t instructions = 0;
+        for (int lane = 0; lane < Lockstep::LANES; lane++) {
+            instructions += lockstep.getCycleCount(lane);
+        }
+        instructionsPerSecond.push_back(instructions / seconds);
+    }
+
+    report.romFilepath = romFilepath;
+    report.instructionsPerSecond = percentiles(instructionsPerSecond);
+    return true;
+}
+
+static void writePercentilesJson(std::ostream& os, const std::string& name, const Percentiles& p) {
+    os << "      \"" << name << "\": {\"min\": " << p.min << ", \"p50\": " << p.p50 << ", \"p90\": " << p.p90
+       << ", \"p99\": " << p.p99 << ", \"max\": " << p.max << ", \"mean\": " << p.mean << "}";
+}
+
+static void writeJson(std::ostream& os, const std::vector<RomReport>& reports, const Options& options) {
+    os << "{\n  \"repetitions\": " << options.repetitions << ",\n";
+    const char* backend = options.backend == Backend::Jit ? "jit" : options.backend == Backend::Aot ? "aot" : "interpreter";
+    os << "  \"backend\": \"" << backend << "\",\n";
+    os << "  \"quirks\": \"" << getQuirkProfileName(options.quirkProfile) << "\",\n  \"roms\": [\n";
+    for (size_t i = 0; i < reports.size(); i++) {
+        const RomReport& report = reports[i];
+
+        os << "    {\n      \"rom\": \"" << report.romFilepath << "\",\n";
+        os << "      \"cycles\": " << report.cyclesPerRepetition << ",\n";
+        os << "      \"elided_cycles\": " << report.elidedCycles << ",\n";
+        writePercentilesJson(os, "instructions_per_second", report.instructionsPerSecond);
+        os << ",\n";
+        writePercentilesJson(os, "ns_per_instruction", report.nsPerInstruction);
+        if (report.hasFrames) {
+            os << ",\n";
+            writePercentilesJson(os, "frame_time_us", report.frameTimeUs);
+        }
+        os << ",\n      \"opcode_classes\": {";
+        for (size_t opClass = 0; opClass < OPCODE_CLASSES.size(); opClass++) {
+            os << (opClass == 0 ? "" : ", ") << "\"" << OPCODE_CLASSES[opClass] << "\": " << report.opcodeClassCounts[opClass];
+        }
+        os << "}";
+        if (report.profiled) {
+            os << ",\n      \"profile\": {\"samples\": " << report.profileSamples
+               << ", \"overhead_percent\": " << report.profileOverheadPercent << "}";
+        }
+        if (INSTRUMENTATION) {
+            os << ",\n      \"counters\": ";
+            report.counters.writeJson(os, 6);
+        }
+        os << "\n    }" << (i + 1 < reports.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}" << std::endl;
+}
+
+static void writeCsv(std::ostream& os, const std::vector<RomReport>& reports) {
+    os << "rom,cycles,ips_p50,ips_p90,ips_p99,ips_mean,ns_per_instruction_p50,ns_per_instruction_p99,frame_time_us_p50,frame_time_us_p99";
+    for (const auto & opClass : OPCODE_CLASSES) {
+        os << "," << opClass;
+    }
+    os << ",elided_cycles\n";
+
+    for (const auto & report : reports) {
+        os << report.romFilepath << "," << report.cyclesPerRepetition << ","
+           << report.instructionsPerSecond.p50 << "," << report.instructionsPerSecond.p90 << ","
+           << report.instructionsPerSecond.p99 << "," << report.instructionsPerSecond.mean << ","
+           << report.nsPerInstruction.p50 << "," << report.nsPerInstruction.p99 << ",";
+        if (report.hasFrames) {
+            os << report.frameTimeUs.p50 << "," << report.frameTimeUs.p99;
+        }
+        else {
+            os << ",";
+        }
+        for (const auto & count : report.opcodeClassCounts) {
+            os << "," << count;
+        }
+        os << "," << report.elidedCycles << "\n";
+    }
+    os.flush();
+}
+
+static void writeBatchJson(std::ostream& os, const std::vector<BatchReport>& reports, const Options& options) {
+    os << "{\n  \"repetitions\": " << options.repetitions << ",\n";
+    os << "  \"instances\": " << options.batch << ",\n";
+    os << "  \"frames\": " << options.frames << ",\n  \"runs\": [\n";
+    for (size_t i = 0; i < reports.size(); i++) {
+        const BatchReport& report = reports[i];
+
+        os << "    {\n      \"rom\": \"" << report.romFilepath << "\",\n";
+        os << "      \"threads\": " << report.threads << ",\n";
+        writePercentilesJson(os, "instructions_per_second", report.instructionsPerSecond);
+        os << ",\n      \"speedup\": " << report.speedup << "\n    }" << (i + 1 < reports.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}" << std::endl;
+}
+
+static void writeBatchCsv(std::ostream& os, const std::vector<BatchReport>& reports) {
+    os << "rom,threads,ips_p50,ips_p90,ips_mean,speedup\n";
+    for (const auto & report : reports) {
+        os << report.romFilepath << "," << report.threads << "," << report.instructionsPerSecond.p50 << ","
+           << report.instructionsPerSecond.p90 << "," << report.instructionsPerSecond.mean << "," << report.speedup << "\n";
+    }
+    os.flush();
+}
+
+static void writeLockstepJson(std::ostream& os, const std::vector<LockstepReport>& reports, const Options& options) {
+    os << "{\n  \"repetitions\": " << options.repetitions << ",\n";
+    os << "  \"lanes\": " << Lockstep::LANES << ",\n  \"roms\": [\n";
+    for (size_t i = 0; i < reports.size(); i++) {
+        os << "    {\n      \"rom\": \"" << reports[i].romFilepath << "\",\n";
+        writePercentilesJson(os, "instructions_per_second", reports[i].instructionsPerSecond);
+        os << "\n    }" << (i + 1 < reports.size() ? "," : "") << "\n";
+    }
+    os << "  ]\n}" << std::endl;
+}
+
+static void writeLockstepCsv(std::ostream& os, const std::vector<LockstepReport>& reports) {
+    os << "rom,lanes,ips_p50,ips_p90,ips_mean\n";
+    for (const auto & report : reports) {
+        os << report.romFilepath << "," << Lockstep::LANES << "," << report.instructionsPerSecond.p50 << ","
+           << report.instructionsPerSecond.p90 << "," << report.instructionsPerSecond.mean << "\n";
+    }
+    os.flush();
+}
+
+static bool parseArguments(int argc, char** argv, Options& options) {
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+
+        if (argument.rfind("--", 0) != 0) {
+            options.romFilepaths.push_back(argument);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cout << "ERROR: Missing value for '" << argument << "'" << std::endl;
+            return false;
+        }
+
+        std::string value = argv[++i];
+        try {
+            if (argument == "--cycles") {
+                options.cycles = std::stoull(value);
+            }
+            else if (argument == "--frames") {
+                options.frames = std::stoull(value);
+            }
+            else if (argument == "--ips") {
+                options.ticksPerSecond = std::stoull(value);
+            }
+            else if (argument == "--repetitions") {
+                options.repetitions = std::stoull(value);
+            }
+            else if (argument == "--seed") {
+                options.seed = std::stoull(value);
+            }
+            else if (argument == "--batch") {
+                options.batch = std::stoull(value);
+            }
+            else if (argument == "--threads") {
+                options.threads = std::stoull(value);
+            }
+            else if (argument == "--lockstep") {
+                options.lockstep = std::stoull(value) != 0;
+            }
+            else if (argument == "--backend") {
+                if (value == "interpreter") {
+                    options.backend = Backend::Interpreter;
+                }
+                else if (value == "jit") {
+                    options.backend = Backend::Jit;
+                }
+                else if (value == "aot") {
+                    options.backend = Backend::Aot;
+                }
+                else {
+                    std::cout << "ERROR: Unknown backend '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (argument == "--quirks") {
+                if (!parseQuirkProfile(value, options.quirkProfile)) {
+                    std::cout << "ERROR: Unknown quirk profile '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (argument == "--profile") {
+                options.profileFilepath = value;
+            }
+            else if (argument == "--replay") {
+                options.replayFilepath = value;
+            }
+            else if (argument == "--video") {
+                options.videoFilepath = value;
+            }
+            else if (argument == "--video-format") {
+                if (!parseVideoFormat(value, options.videoFormat)) {
+                    std::cout << "ERROR: Unknown video format '" << value << "'" << std::endl;
+                    return false;
+                }
+            }
+            else if (argument == "--format") {
+                options.format = value;
+            }
+            else if (argument == "--output") {
+                options.outputFilepath = value;
+            }
+            else {
+                std::cout << "ERROR: Unknown option '" << argument << "'" << std::endl;
+                return false;
+            }
+        }
+        catch (const std::exception& ex) {
+            std::cout << "ERROR: Invalid value for '" << argument << "', error message: '" << ex.what() << "'" << std::endl;
+            return false;
+        }
+    }
+
+    if (options.romFilepaths.empty()) {
+        std::cout << "ERROR: To few arguments" << std::endl;
+        return false;
+    }
+    if (options.format != "json" && options.format != "csv") {
+        std::cout << "ERROR: Unknown format '" << options.format << "'" << std::endl;
+        return false;
+    }
+    if (options.backend == Backend::Jit && !Chip8().setBackend(Backend::Jit)) {
+        std::cout << "ERROR: The jit backend is not available on this platform" << std::endl;
+        return false;
+    }
+    if (options.repetitions == 0 || options.ticksPerSecond == 0) {
+        std::cout << "ERROR: Repetitions and ips must be at least 1" << std::endl;
+        return false;
+    }
+    if (options.lockstep && options.quirkProfile != QuirkProfile::Legacy) {
+        std::cout << "ERROR: The lockstep engine only runs the legacy quirk profile" << std::endl;
+        return false;
+    }
+    if (!options.videoFilepath.empty()) {
+        if (options.cycles > 0 || options.batch > 0 || options.lockstep) {
+            std::cout << "ERROR: Video is exported from the frames of a single instance" << std::endl;
+            return false;
+        }
+        if (options.videoFilepath == "-" && options.outputFilepath.empty()) {
+            std::cout << "ERROR: Video on stdout needs the report written with --output" << std::endl;
+            return false;
+        }
+    }
+    if (!options.replayFilepath.empty()) {
+        if (!options.replay.load(options.replayFilepath)) {
+            std::cout << "ERROR: Could not read movie '" << options.replayFilepath << "'" << std::endl;
+            return false;
+        }
+        if (options.cycles > 0 || options.batch > 0 || options.lockstep) {
+            std::cout << "ERROR: A movie replays frames of a single instance" << std::endl;
+            return false;
+        }
+
+        // The recording decides the workload
+        options.frames = options.replay.getLength();
+        options.ticksPerSecond = options.replay.getTicksPerSecond();
+        options.seed = options.replay.getSeed();
+        options.quirkProfile = options.replay.getQuirkProfile();
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    for (const auto & romFilepath : options.romFilepaths) {
+        if (!std::filesystem::exists(romFilepath)) {
+            std::cout << "ERROR: No file with path: '" << romFilepath << "' found" << std::endl;
+            return 1;
+        }
+
+        const std::shared_ptr<const Rom> rom = options.roms.load(romFilepath);
+        if (options.backend == Backend::Aot
+            && (rom == nullptr || findAotProgram(rom->getHash(), rom->getSize(), options.quirkProfile) == nullptr)) {
+            std::cout << "ERROR: '" << romFilepath << "' was not compiled ahead of time for this quirk profile, "
+                      << "add it to CHIP8_AOT_GAMES and CHIP8_AOT_QUIRKS" << std::endl;
+            return 1;
+        }
+    }
+
+    std::ofstream file;
+    if (!options.outputFilepath.empty()) {
+        file.open(options.outputFilepath);
+        if (!file) {
+            std::cout << "ERROR: Could not open output file '" << options.outputFilepath << "'" << std::endl;
+            return 1;
+        }
+    }
+    std::ostream& os = options.outputFilepath.empty() ? std::cout : file;
+
+    if (options.lockstep) {
+        std::vector<LockstepReport> reports;
+        for (const auto & romFilepath : options.romFilepaths) {
+            LockstepReport report;
+            if (!benchLockstep(options, romFilepath, report)) {
+                std::cout << "ERROR: game file to large: '" << romFilepath << "'" << std::endl;
+                return 1;
+            }
+            reports.push_back(report);
+        }
+
+        if (options.format == "json") {
+            writeLockstepJson(os, reports, options);
+        }
+        else {
+            writeLockstepCsv(os, reports);
+        }
+        return 0;
+    }
+
+    if (options.batch > 0) {
+        std::vector<BatchReport> reports;
+        for (const auto & romFilepath : options.romFilepaths) {
+            if (!benchBatch(options, romFilepath, reports)) {
+                std::cout << "ERROR: game file to large: '" << romFilepath << "'" << std::endl;
+                return 1;
+            }
+        }
+
+        if (options.format == "json") {
+            writeBatchJson(os, reports, options);
+        }
+        else {
+            writeBatchCsv(os, reports);
+        }
+        return 0;
+    }
+
+    std::ofstream profileFile;
+    if (!options.profileFilepath.empty()) {
+        profileFile.open(options.profileFilepath);
+        if (!profileFile) {
+            std::cout << "ERROR: Could not open profile file '" << options.profileFilepath << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    // The writer waits for its queue instead of dropping frames, the export pass is not timed
+    std::unique_ptr<VideoWriter> video;
+    if (!options.videoFilepath.empty()) {
+        video = std::make_unique<VideoWriter>(options.videoFilepath, options.videoFormat);
+        if (!video->isOpen()) {
+            std::cout << "ERROR: Could not open video file '" << options.videoFilepath << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    std::vector<RomReport> reports;
+    for (const auto & romFilepath : options.romFilepaths) {
+        RomReport report;
+        bool loaded = benchRom(options, romFilepath, report);
+        if (loaded && profileFile.is_open()) {
+            Chip8 chip8;
+            Profiler profiler;
+            loaded = profileRom(options, romFilepath, report, profiler, chip8);
+            profiler.writeFolded(profileFile, std::filesystem::path(romFilepath).filename().string(), chip8.getMemory());
+        }
+        if (loaded && video) {
+            loaded = exportRom(options, romFilepath, *video);
+        }
+        if (!loaded) {
+            if (!options.replayFilepath.empty()) {
+                std::cout << "ERROR: game '" << romFilepath << "' is not the one the movie was recorded with" << std::endl;
+            }
+            else {
+                std::cout << "ERROR: game file to large: '" << romFilepath << "'" << std::endl;
+            }
+            return 1;
+        }
+        reports.push_back(report);
+    }
+    if (video && !video->finish()) {
+        std::cout << "ERROR: Could not write video file '" << options.videoFilepath << "'" << std::endl;
+        return 1;
+    }
+
+    if (options.format == "json") {
+        writeJson(os, reports, options);
+    }
+    else {
+        writeCsv(os, reports);
+    }
+    return 0;
+}
@@ -1,461 +1,1430 @@
 #include "chip8.hpp"
+#include "debugger.hpp"
 #include "FONTSET.hpp"
 
+#include <algorithm>
+#include <atomic>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
 #include <fstream>
 #include <random>
 #include <string>
-#include <thread>
-#include <chrono>
 
-static Byte randomNumber() {
-    std::random_device randomDevice;    
-    std::mt19937 generator(randomDevice());
-    std::uniform_int_distribution<> distribution(0,255);
-
-    return distribution(generator);
+void Chip8::initialize(uint64_t ticksPerSecond) {
+    // Without an explicit seed every run is different
+    std::random_device randomDevice;
+    initialize(ticksPerSecond, uint64_t(randomDevice()) << 32 | randomDevice());
 }
 
-void Chip8::initialize(uint64_t ticksPerSecond) {
+void Chip8::initialize(uint64_t ticksPerSecond, uint64_t seed) {
     mProgramCounter = 0x200; 
     mIndexRegistry = 0;      
     mStackP = 0;      
     
     mKeys.fill(false);
+    mHighResolution = false;
+    mPlanes = 1;
     mGraphix.fill(0);
+    mDirtyRows = getAllRows();
     mStack.fill(0);
     mV.fill(0);
-    mMemory.fill(0);
-
-    int start = 0x50;
-    for (const auto & byte : FONTSET) {
-        mMemory[start++] = byte;		
-    }
+    mFlags.fill(0);
+    mAudioPattern.fill(0);
+    mPitch = 64;
+
+    mMemory.clear();
+    resizeMemory(getMemorySize(getQuirks(mQuirkProfile)));
+    loadFonts();
+    invalidateMemory(0, mMemory.size() - 1);
     
-    mTicksPerSecond = ticksPerSecond;
+    mRandom = RandomEngine(seed);
+
+    mTicksPerSecond = std::max<uint64_t>(ticksPerSecond, 1);
+    mCycleCount = 0;
+    mElidedCycles = 0;
+    mTimerAccumulator = 0;
+    mFrameAccumulator = 0;
     mDelayTimer = 0;
     mSoundTimer = 0;
+    mDrawFlag = false;
+    mCounters = Counters();
 }
 
 bool Chip8::loadGame(const std::string& gameFilepath) {
-    std::ifstream fs(gameFilepath, std::ios::binary| std::ios::in);
-    char data;
-    int i = 0;
-    
-    while (fs.get(data)) {
-        if (0x200 + i > 4096) {
-            return false;
+    std::ifstream fs(gameFilepath, std::ios::binary | std::ios::in | std::ios::ate);
+    if (!fs) {
+        return false;
+    }
+
+    // Read in one piece, one byte more than fits is enough to reject the game
+    const size_t size = std::min<size_t>(fs.tellg(), mMemory.size() - 0x200 + 1);
+    std::vector<Byte> game(size);
+    fs.seekg(0);
+    if (!fs.read(reinterpret_cast<char*>(game.data()), size)) {
+        return false;
+    }
+    return loadGame(game.data(), game.size());
+}
+
+bool Chip8::loadGame(const Byte* data, const size_t size) {
+    if (size > mMemory.size() - 0x200) {
+        return false;
+    }
+
+    std::copy_n(data, size, mMemory.begin() + 0x200);
+    invalidateMemory(0x200, 0x200 + int(size) - 1);
+    return true;
+}
+
+Chip8::State Chip8::saveState() const {
+    State state;
+    state.memory = mMemory;
+    state.graphix = mGraphix;
+    state.V = mV;
+    state.stack = mStack;
+    state.keys = mKeys;
+    state.random = mRandom;
+    state.ticksPerSecond = mTicksPerSecond;
+    state.cycleCount = mCycleCount;
+    state.timerAccumulator = mTimerAccumulator;
+    state.frameAccumulator = mFrameAccumulator;
+    state.programCounter = mProgramCounter;
+    state.indexRegistry = mIndexRegistry;
+    state.stackP = mStackP;
+    state.delayTimer = mDelayTimer;
+    state.soundTimer = mSoundTimer;
+    state.drawFlag = mDrawFlag;
+    state.highResolution = mHighResolution;
+    state.planes = mPlanes;
+    state.flags = mFlags;
+    state.audioPattern = mAudioPattern;
+    state.pitch = mPitch;
+    return state;
+}
+
+void Chip8::loadState(const State& state) {
+    // Only pages that differ are copied and decoded again, a reset to a state of the same game decodes nothing
+    if (state.memory.size() != mMemory.size()) {
+        resizeMemory(state.memory.size());
+        mMemory = state.memory;
+        invalidateMemory(0, mMemory.size() - 1);
+    }
+    for (int first = 0; first < int(mMemory.size()); first += PAGE_SIZE) {
+        if (mDecoded[first / PAGE_SIZE] == nullptr || std::memcmp(&mMemory[first], &state.memory[first], PAGE_SIZE) != 0) {
+            std::memcpy(&mMemory[first], &state.memory[first], PAGE_SIZE);
+            invalidateMemory(first, first + PAGE_SIZE - 1);
         }
-        mMemory[0x200 + i] = static_cast<Byte>(data);
-        i++;
     }
+
+    mGraphix = state.graphix;
+    mHighResolution = state.highResolution;
+    mPlanes = state.planes;
+    mFlags = state.flags;
+    mAudioPattern = state.audioPattern;
+    mPitch = state.pitch;
+    mDirtyRows = getAllRows();
+    mV = state.V;
+    mStack = state.stack;
+    mKeys = state.keys;
+    mRandom = state.random;
+    mTicksPerSecond = state.ticksPerSecond;
+    mCycleCount = state.cycleCount;
+    mTimerAccumulator = state.timerAccumulator;
+    mFrameAccumulator = state.frameAccumulator;
+    mProgramCounter = state.programCounter;
+    mIndexRegistry = state.indexRegistry;
+    mStackP = state.stackP;
+    mDelayTimer = state.delayTimer;
+    mSoundTimer = state.soundTimer;
+    mDrawFlag = state.drawFlag;
+}
+
+// Serialized states are little endian, starting with STATE_MAGIC and STATE_VERSION
+static constexpr uint32_t STATE_MAGIC = 0x53384843; // "CH8S"
+
+template <typename T>
+static void writeLittleEndian(std::vector<Byte>& data, const T value) {
+    for (size_t byte = 0; byte < sizeof(T); byte++) {
+        data.push_back(Byte(uint64_t(value) >> (byte * 8)));
+    }
+}
+
+template <typename T>
+static bool readLittleEndian(const std::vector<Byte>& data, size_t& offset, T& value) {
+    if (offset + sizeof(T) > data.size()) {
+        return false;
+    }
+
+    uint64_t result = 0;
+    for (size_t byte = 0; byte < sizeof(T); byte++) {
+        result |= uint64_t(data[offset++]) << (byte * 8);
+    }
+    value = T(result);
     return true;
 }
 
+std::vector<Byte> Chip8::serializeState(const State& state) {
+    std::vector<Byte> data;
+    data.reserve(sizeof(State) + state.memory.size() + 12);
+
+    writeLittleEndian(data, STATE_MAGIC);
+    writeLittleEndian(data, STATE_VERSION);
+    writeLittleEndian(data, uint32_t(state.memory.size()));
+    data.insert(data.end(), state.memory.begin(), state.memory.end());
+    for (const auto & row : state.graphix) {
+        writeLittleEndian(data, row);
+    }
+    data.insert(data.end(), state.V.begin(), state.V.end());
+    for (const auto & address : state.stack) {
+        writeLittleEndian(data, address);
+    }
+    for (const auto & key : state.keys) {
+        writeLittleEndian(data, key);
+    }
+    writeLittleEndian(data, state.random.getState());
+    writeLittleEndian(data, state.random.getIncrement());
+    writeLittleEndian(data, state.ticksPerSecond);
+    writeLittleEndian(data, state.cycleCount);
+    writeLittleEndian(data, state.timerAccumulator);
+    writeLittleEndian(data, state.frameAccumulator);
+    writeLittleEndian(data, state.programCounter);
+    writeLittleEndian(data, state.indexRegistry);
+    writeLittleEndian(data, state.stackP);
+    writeLittleEndian(data, state.delayTimer);
+    writeLittleEndian(data, state.soundTimer);
+    writeLittleEndian(data, state.drawFlag);
+    writeLittleEndian(data, state.highResolution);
+    writeLittleEndian(data, state.planes);
+    data.insert(data.end(), state.flags.begin(), state.flags.end());
+    data.insert(data.end(), state.audioPattern.begin(), state.audioPattern.end());
+    writeLittleEndian(data, state.pitch);
+    return data;
+}
+
+bool Chip8::deserializeState(const std::vector<Byte>& data, State& state) {
+    size_t offset = 0;
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    if (!readLittleEndian(data, offset, magic) || magic != STATE_MAGIC
+        || !readLittleEndian(data, offset, version) || version != STATE_VERSION) {
+        return false;
+    }
+
+    // Only the memory sizes of the instruction sets are accepted
+    uint32_t memorySize = 0;
+    if (!readLittleEndian(data, offset, memorySize) || (memorySize != 0x1000 && memorySize != 0x10000)) {
+        return false;
+    }
+    state.memory.resize(memorySize);
+
+    bool complete = true;
+    for (auto & byte : state.memory) {
+        complete &= readLittleEndian(data, offset, byte);
+    }
+    for (auto & row : state.graphix) {
+        complete &= readLittleEndian(data, offset, row);
+    }
+    for (auto & byte : state.V) {
+        complete &= readLittleEndian(data, offset, byte);
+    }
+    for (auto & address : state.stack) {
+        complete &= readLittleEndian(data, offset, address);
+    }
+    for (auto & key : state.keys) {
+        complete &= readLittleEndian(data, offset, key);
+    }
+    uint64_t randomState = 0;
+    uint64_t randomIncrement = 0;
+    complete &= readLittleEndian(data, offset, randomState);
+    complete &= readLittleEndian(data, offset, randomIncrement);
+    state.random.restore(randomState, randomIncrement);
+    complete &= readLittleEndian(data, offset, state.ticksPerSecond);
+    complete &= readLittleEndian(data, offset, state.cycleCount);
+    complete &= readLittleEndian(data, offset, state.timerAccumulator);
+    complete &= readLittleEndian(data, offset, state.frameAccumulator);
+    complete &= readLittleEndian(data, offset, state.programCounter);
+    complete &= readLittleEndian(data, offset, state.indexRegistry);
+    complete &= readLittleEndian(data, offset, state.stackP);
+    complete &= readLittleEndian(data, offset, state.delayTimer);
+    complete &= readLittleEndian(data, offset, state.soundTimer);
+    complete &= readLittleEndian(data, offset, state.drawFlag);
+    complete &= readLittleEndian(data, offset, state.highResolution);
+    complete &= readLittleEndian(data, offset, state.planes);
+    for (auto & flag : state.flags) {
+        complete &= readLittleEndian(data, offset, flag);
+    }
+    for (auto & byte : state.audioPattern) {
+        complete &= readLittleEndian(data, offset, byte);
+    }
+    complete &= readLittleEndian(data, offset, state.pitch);
+
+    // tickCycles never finishes at zero instructions per second, and the stack pointer indexes mStack
+    return complete && offset == data.size() && state.ticksPerSecond > 0 && state.stackP <= state.stack.size();
+}
+
 void Chip8::emulateCycle() {
-    Word operationCode = mMemory[mProgramCounter] << 8 | mMemory[mProgramCounter + 1];
+    mRunEnd = mCycleCount + 1;
+    step();
+}
+
+void Chip8::step() {
+    const Word address = mProgramCounter & mAddressMask;
+    const Instruction& instruction = (*mDecoded[address / PAGE_SIZE])[address % PAGE_SIZE];
     mDrawFlag = false;
-    Word N;
-    Byte X;
-    Byte Y;
 
-    switch (operationCode & 0xF000) {
-        case 0x0000:
-            switch (operationCode & 0x00FF) {
-                case 0x00E0: // 00E0: Clears the screen
-                    mDrawFlag = true;
-                    mGraphix.fill(0);
+    if constexpr (INSTRUMENTATION) {
+        mCounters.families[instruction.operationCode >> 12]++;
+    }
+    instruction.handler(*this, instruction);
 
-                    mProgramCounter += 2;
-                    break;
+    tickCycles(1);
+}
 
-                case 0x00EE: // 00EE: Returns from subroutine
-                    mProgramCounter = mStack[--mStackP] + 2;
-                    break;
+void Chip8::elide(const uint64_t rounds, const std::initializer_list<int> families) {
+    if constexpr (INSTRUMENTATION) {
+        for (const int family : families) {
+            mCounters.families[family] += rounds;
+        }
+    }
+    tickCycles(rounds * families.size());
+    mElidedCycles += rounds * families.size();
+}
 
-                default:
-                    std::cout << "Unknown opcode: " << std::to_string(operationCode) << std::endl;
-            }
-            break;
-       
-        case 0x1000: // 1NNN: Jump to address NNN
-            N = operationCode & 0x0FFF;
+void Chip8::skipDelayWait(const Byte X) {
+    // Called by FX07 before its own tick, a round is FX07, 3XNN or 4XNN and the jump back
+    const Word pc = mProgramCounter;
+    const Word skip = mMemory[(pc + 2) & mAddressMask] << 8 | mMemory[(pc + 3) & mAddressMask];
+    const Word jump = mMemory[(pc + 4) & mAddressMask] << 8 | mMemory[(pc + 5) & mAddressMask];
+    if (jump != (0x1000 | pc) || (skip & 0x0F00) != X << 8) {
+        return;
+    }
 
-            mProgramCounter = N;
-            break;
-             
-        case 0x2000: // 2NNN: Calls subroutine at NNN 
-            N = operationCode & 0x0FFF;
+    // The loop goes on while the skip is not taken, which only changes with the delay timer
+    bool loops = false;
+    switch (skip & 0xF000) {
+        case 0x3000: loops = mDelayTimer != (skip & 0x00FF); break;
+        case 0x4000: loops = mDelayTimer == (skip & 0x00FF); break;
+    }
+    const uint64_t accumulator = mTimerAccumulator + 60;
+    if (!loops || accumulator >= mTicksPerSecond) {
+        return;
+    }
 
-            mStack[mStackP++] = mProgramCounter;
+    // Rounds that end before the next tick leave everything but the cycle count as it is now
+    const uint64_t beforeTick = (mTicksPerSecond - accumulator - 1) / 60;
+    const uint64_t rounds = std::min(beforeTick, mRunEnd - mCycleCount - 1) / 3;
+    if (rounds > 0) {
+        elide(rounds, {0xF, skip >> 12, 0x1});
+    }
+}
 
-            mProgramCounter = N;
-            break;
-             
-        case 0x3000: // 3XNN: Skips next instruction if VX == NN 
-            N = operationCode & 0x00FF;
-            X = (operationCode & 0x0F00) >> 8;
+void Chip8::tickCycles(const uint64_t cycles) {
+    // Timers tick at 60 Hz of emulated time, i.e. once every mTicksPerSecond / 60 cycles
+    mCycleCount += cycles;
+    mTimerAccumulator += 60 * cycles;
+    while (mTimerAccumulator >= mTicksPerSecond) {
+        mTimerAccumulator -= mTicksPerSecond;
 
-            if (mV[X] == N) {
-                mProgramCounter += 2;
-            }
+        if (mDelayTimer > 0) {
+            --mDelayTimer;
+        }
 
-            mProgramCounter += 2;
-            break;
-             
-        case 0x4000: // 4XNN: Skips next instruction if VX != NN 
-            N = operationCode & 0x00FF;
-            X = (operationCode & 0x0F00) >> 8;
+        mAudioSink->tick(mSoundTimer > 0);
+        if (mSoundTimer > 0) {
+            --mSoundTimer;
+        }
+    }
+}
 
-            if (mV[X] != N) {
-                mProgramCounter += 2;
-            }
+bool Chip8::runCycles(const uint64_t cycles) {
+    // Checked once per run, the instructions of the backends carry no debugger checks
+    if (mDebugger != nullptr) {
+        return runCyclesDebug(cycles);
+    }
+    if (mBackend == Backend::Jit) {
+        return runBlocks(cycles, [this]() -> const Jit::Block* {
+            return mProgramCounter < Jit::MEMORY_SIZE ? mJit.lookup(mMemory.data(), mProgramCounter) : nullptr;
+        });
+    }
+    if (mBackend == Backend::Aot && mAotProgram != nullptr) {
+        return runBlocks(cycles, [this]() { return lookupAot(mProgramCounter); });
+    }
 
-            mProgramCounter += 2;
-            break;
-             
-        case 0x5000: // 5XY0: Skips next instruction if VX == VY 
-            X = (operationCode & 0x0F00) >> 8;
-            Y = (operationCode & 0x00F0) >> 4;
+    bool drawn = false;
+    mRunEnd = mCycleCount + cycles;
+    while (mCycleCount < mRunEnd) {
+        step();
+        drawn |= mDrawFlag;
+    }
 
-            if (mV[X] == mV[Y]) {
-                mProgramCounter += 2;
+    // The draw flag covers the whole run, not only the last instruction
+    mDrawFlag = drawn;
+    return drawn;
+}
+
+bool Chip8::runCyclesDebug(const uint64_t cycles) {
+    // A run of one instruction at a time never fast-forwards an idle loop past a breakpoint or a check
+    bool drawn = false;
+    const uint64_t end = mCycleCount + cycles;
+    while (mCycleCount < end && mDebugger->beforeInstruction(*this)) {
+        mRunEnd = mCycleCount + 1;
+        step();
+        drawn |= mDrawFlag;
+        mDebugger->afterInstruction(*this);
+    }
+
+    mDrawFlag = drawn;
+    return drawn;
+}
+
+template <typename Lookup>
+bool Chip8::runBlocks(const uint64_t cycles, Lookup lookup) {
+    bool drawn = false;
+    mRunEnd = mCycleCount + cycles;
+    while (mCycleCount < mRunEnd) {
+        const auto* block = lookup();
+
+        // Blocks hold no timer, draw or memory instructions, so their cycles can be ticked afterwards
+        if (block != nullptr && block->instructions <= mRunEnd - mCycleCount) {
+            if constexpr (INSTRUMENTATION) {
+                // Blocks are straight-line, their instructions follow each other from the start address
+                for (int instruction = 0; instruction < block->instructions; instruction++) {
+                    mCounters.families[mMemory[(mProgramCounter + 2 * instruction) & mAddressMask] >> 4]++;
+                }
             }
-           
-            mProgramCounter += 2;
-            break;
-             
-        case 0x6000: // 6XNN: Sets VX to NN 
-            N = operationCode & 0x00FF;
-            X = (operationCode & 0x0F00) >> 8;
+            mProgramCounter = block->code(mV.data(), &mIndexRegistry);
+            tickCycles(block->instructions);
+        }
+        else {
+            step();
+            drawn |= mDrawFlag;
+        }
+    }
 
-            mV[X] = N;
+    mDrawFlag = drawn;
+    return drawn;
+}
 
-            mProgramCounter += 2;
-            break;
-             
-        case 0x7000: // 7XNN: Adds NN to VX 
-            N = operationCode & 0x00FF;
-            X = (operationCode & 0x0F00) >> 8;
+const AotBlock* Chip8::lookupAot(const Word address) {
+    if (address >= mAotEntries.size() || mAotEntries[address] == 0) {
+        return nullptr;
+    }
+
+    const size_t index = mAotEntries[address] - 1;
+    const AotBlock& block = mAotProgram->blocks[index];
+    if (mAotChecks[index] == AotCheck::Unchecked) {
+        const bool same = block.last < mMemory.size()
+            && std::equal(&mMemory[block.address], &mMemory[block.last] + 1, mAotProgram->game + (block.address - 0x200));
+        mAotChecks[index] = same ? AotCheck::Same : AotCheck::Changed;
+    }
+    return mAotChecks[index] == AotCheck::Same ? &block : nullptr;
+}
+
+void Chip8::invalidateAot(const int first, const int last) {
+    if (mAotProgram == nullptr) {
+        return;
+    }
 
-            mV[X] += N;
+    // Blocks are sorted by address and none is longer than AOT_MAX_BLOCK_INSTRUCTIONS
+    const AotBlock* blocks = mAotProgram->blocks;
+    const AotBlock* end = blocks + mAotProgram->blockCount;
+    const int from = first - 2 * AOT_MAX_BLOCK_INSTRUCTIONS;
+    const AotBlock* block = std::lower_bound(blocks, end, from, [](const AotBlock& block, const int address) {
+        return block.address < address;
+    });
+    for (; block != end && block->address <= last; ++block) {
+        if (block->last >= first) {
+            mAotChecks[block - blocks] = AotCheck::Unchecked;
+        }
+    }
+}
+
+bool Chip8::setAotProgram(const AotProgram* program) {
+    if (program != nullptr && program->profile != mQuirkProfile) {
+        return false;
+    }
+
+    mAotProgram = program;
+    mAotEntries.clear();
+    mAotChecks.assign(program != nullptr ? program->blockCount : 0, AotCheck::Unchecked);
+    if (program != nullptr && program->blockCount > 0) {
+        mAotEntries.assign(program->blocks[program->blockCount - 1].address + 1, 0);
+        for (size_t index = 0; index < program->blockCount; index++) {
+            mAotEntries[program->blocks[index].address] = uint16_t(index + 1);
+        }
+    }
+    return true;
+}
+
+void Chip8::setQuirkProfile(const QuirkProfile profile) {
+    const Quirks quirks = getQuirks(profile);
+    mQuirkProfile = profile;
+    resizeMemory(getMemorySize(quirks));
+    loadFonts();
+
+    // The CHIP-8 handlers only know the first plane at low resolution
+    if (quirks.instructionSet == Quirks::InstructionSet::Chip8 && (mHighResolution || mPlanes != 1)) {
+        mHighResolution = false;
+        mPlanes = 1;
+        mGraphix.fill(0);
+        mDirtyRows = getAllRows();
+    }
+
+    invalidateMemory(0, mMemory.size() - 1);
+    mJit.setQuirks(quirks);
+    if (mAotProgram != nullptr && mAotProgram->profile != profile) {
+        setAotProgram(nullptr);
+    }
+}
 
-            mProgramCounter += 2;
+void Chip8::resizeMemory(const size_t size) {
+    mMemory.resize(size, 0);
+    mAddressMask = Word(size - 1);
+    for (size_t page = size / PAGE_SIZE; page < mDecoded.size(); page++) {
+        mDecoded[page].reset();
+    }
+}
+
+void Chip8::loadFonts() {
+    std::copy(FONTSET.begin(), FONTSET.end(), mMemory.begin() + 0x50);
+    if (getQuirks(mQuirkProfile).instructionSet != Quirks::InstructionSet::Chip8) {
+        std::copy(BIG_FONTSET.begin(), BIG_FONTSET.end(), mMemory.begin() + 0xA0);
+    }
+}
+
+uint64_t Chip8::getAllRows() const {
+    return mHighResolution ? ~uint64_t(0) : 0xFFFFFFFF;
+}
+
+bool Chip8::setBackend(const Backend backend) {
+    if (backend == Backend::Jit && !mJit.isAvailable()) {
+        return false;
+    }
+    mBackend = backend;
+    return true;
+}
+
+void Chip8::setAudioSink(AudioSink* sink) {
+    mAudioSink = sink != nullptr ? sink : &NULL_AUDIO_SINK;
+}
+
+void Chip8::setFrameSink(FrameSink* sink) {
+    mFrameSink = sink != nullptr ? sink : &NULL_FRAME_SINK;
+}
+
+void Chip8::setDebugger(Debugger* debugger) {
+    mDebugger = debugger;
+}
+
+bool Chip8::runFrame() {
+    // Runs the instructions of one 60 Hz frame, carrying the remainder when mTicksPerSecond is not a multiple of 60
+    mFrameAccumulator += mTicksPerSecond;
+    uint64_t cycles = mFrameAccumulator / 60;
+    mFrameAccumulator %= 60;
+
+    const bool drawn = runCycles(cycles);
+    mFrameSink->frame(*this);
+    return drawn;
+}
+
+Chip8::Instruction Chip8::decode(const Word operationCode) const {
+    switch (mQuirkProfile) {
+        case QuirkProfile::CosmacVip: return decodeWith<COSMAC_VIP_QUIRKS>(operationCode);
+        case QuirkProfile::Chip48: return decodeWith<CHIP48_QUIRKS>(operationCode);
+        case QuirkProfile::SuperChip: return decodeWith<SUPER_CHIP_QUIRKS>(operationCode);
+        case QuirkProfile::Modern: return decodeWith<MODERN_QUIRKS>(operationCode);
+        case QuirkProfile::XoChip: return decodeWith<XO_CHIP_QUIRKS>(operationCode);
+        case QuirkProfile::Legacy: break;
+    }
+    return decodeWith<LEGACY_QUIRKS>(operationCode);
+}
+
+template <Quirks QUIRKS>
+Chip8::Instruction Chip8::decodeWith(const Word operationCode) {
+    Instruction instruction;
+    instruction.handler = opUnknown;
+    instruction.operationCode = operationCode;
+    instruction.NNN = operationCode & 0x0FFF;
+    instruction.NN = operationCode & 0x00FF;
+    instruction.N = operationCode & 0x000F;
+    instruction.X = (operationCode & 0x0F00) >> 8;
+    instruction.Y = (operationCode & 0x00F0) >> 4;
+
+    constexpr bool SUPER_CHIP = QUIRKS.instructionSet != Quirks::InstructionSet::Chip8;
+    constexpr bool XO_CHIP = QUIRKS.instructionSet == Quirks::InstructionSet::XoChip;
+
+    switch (operationCode & 0xF000) {
+        case 0x0000:
+            switch (operationCode & 0x00FF) {
+                case 0x00E0: instruction.handler = op00E0<QUIRKS>; break;
+                case 0x00EE: instruction.handler = op00EE; break;
+            }
+            if constexpr (SUPER_CHIP) {
+                switch (operationCode & 0xFFF0) {
+                    case 0x00C0: instruction.handler = op00CN; break;
+                    case 0x00D0: instruction.handler = XO_CHIP ? op00DN : opUnknown; break;
+                }
+                switch (operationCode) {
+                    case 0x00FB: instruction.handler = op00FB; break;
+                    case 0x00FC: instruction.handler = op00FC; break;
+                    case 0x00FD: instruction.handler = op00FD; break;
+                    case 0x00FE: instruction.handler = op00FE; break;
+                    case 0x00FF: instruction.handler = op00FF; break;
+                }
+            }
+            break;
+        case 0x1000: instruction.handler = op1NNN; break;
+        case 0x2000: instruction.handler = op2NNN; break;
+        case 0x3000: instruction.handler = op3XNN<QUIRKS>; break;
+        case 0x4000: instruction.handler = op4XNN<QUIRKS>; break;
+        case 0x5000:
+            instruction.handler = op5XY0<QUIRKS>;
+            if constexpr (XO_CHIP) {
+                switch (operationCode & 0x000F) {
+                    case 0x0002: instruction.handler = op5XY2; break;
+                    case 0x0003: instruction.handler = op5XY3; break;
+                }
+            }
             break;
-             
-        case 0x8000: 
+        case 0x6000: instruction.handler = op6XNN; break;
+        case 0x7000: instruction.handler = op7XNN; break;
+        case 0x8000:
             switch (operationCode & 0x000F) {
-                case 0x0000: // 8XY0: Sets VX to VY
-                    X = (operationCode & 0x0F00) >> 8;
-                    Y = (operationCode & 0x00F0) >> 4;
+                case 0x0000: instruction.handler = op8XY0; break;
+                case 0x0001: instruction.handler = op8XY1<QUIRKS>; break;
+                case 0x0002: instruction.handler = op8XY2<QUIRKS>; break;
+                case 0x0003: instruction.handler = op8XY3<QUIRKS>; break;
+                case 0x0004: instruction.handler = op8XY4<QUIRKS>; break;
+                case 0x0005: instruction.handler = op8XY5<QUIRKS>; break;
+                case 0x0006: instruction.handler = op8XY6<QUIRKS>; break;
+                case 0x0007: instruction.handler = op8XY7<QUIRKS>; break;
+                case 0x000E: instruction.handler = op8XYE<QUIRKS>; break;
+            }
+            break;
+        case 0x9000: instruction.handler = op9XY0<QUIRKS>; break;
+        case 0xA000: instruction.handler = opANNN; break;
+        case 0xB000: instruction.handler = opBNNN<QUIRKS>; break;
+        case 0xC000: instruction.handler = opCXNN; break;
+        case 0xD000: instruction.handler = opDXYN<QUIRKS>; break;
+        case 0xE000:
+            switch (operationCode & 0x00FF) {
+                case 0x009E: instruction.handler = opEX9E<QUIRKS>; break;
+                case 0x00A1: instruction.handler = opEXA1<QUIRKS>; break;
+            }
+            break;
+        case 0xF000:
+            switch (operationCode & 0x00FF) {
+                case 0x0007: instruction.handler = opFX07; break;
+                case 0x000A: instruction.handler = opFX0A; break;
+                case 0x0015: instruction.handler = opFX15; break;
+                case 0x0018: instruction.handler = opFX18; break;
+                case 0x001E: instruction.handler = opFX1E; break;
+                case 0x0029: instruction.handler = opFX29; break;
+                case 0x0033: instruction.handler = opFX33; break;
+                case 0x0055: instruction.handler = opFX55<QUIRKS>; break;
+                case 0x0065: instruction.handler = opFX65<QUIRKS>; break;
+            }
+            if constexpr (SUPER_CHIP) {
+                switch (operationCode & 0x00FF) {
+                    case 0x0030: instruction.handler = opFX30; break;
+                    case 0x0075: instruction.handler = opFX75; break;
+                    case 0x0085: instruction.handler = opFX85; break;
+                }
+            }
+            if constexpr (XO_CHIP) {
+                switch (operationCode & 0x00FF) {
+                    case 0x0000: instruction.handler = operationCode == 0xF000 ? opF000 : opUnknown; break;
+                    case 0x0001: instruction.handler = opFN01; break;
+                    case 0x0002: instruction.handler = operationCode == 0xF002 ? opF002 : opUnknown; break;
+                    case 0x003A: instruction.handler = opFX3A; break;
+                }
+            }
+            break;
+    }
+    return instruction;
+}
 
-                    mV[X] = mV[Y];
-                    
-                    mProgramCounter += 2;
-                    break;
+Chip8::DecodedPage& Chip8::writableDecodedPage(const int page) {
+    std::shared_ptr<DecodedPage>& decoded = mDecoded[page];
+    if (decoded == nullptr) {
+        decoded = std::make_shared<DecodedPage>();
+    }
+    else if (decoded.use_count() > 1) {
+        // Shared with a copy of this machine, which keeps the old page
+        decoded = std::make_shared<DecodedPage>(*decoded);
+    }
+    else {
+        // The last copy may have just let go of the page on another thread, see its reads before writing
+        std::atomic_thread_fence(std::memory_order_acquire);
+    }
+    return *decoded;
+}
 
-                case 0x0001: // 8XY1: Sets VX to VX OR VY 
-                    X = (operationCode & 0x0F00) >> 8;
-                    Y = (operationCode & 0x00F0) >> 4;
+void Chip8::invalidateMemory(const int first, const int last) {
+    // An instruction starting at first - 1 also contains the byte at first
+    const int size = mMemory.size();
+    for (int address = std::max(first - 1, 0); address <= std::min(last, size - 1);) {
+        DecodedPage& page = writableDecodedPage(address / PAGE_SIZE);
+        const int pageLast = std::min(last, (address / PAGE_SIZE + 1) * PAGE_SIZE - 1);
+        for (; address <= pageLast; address++) {
+            Word operationCode = mMemory[address] << 8 | mMemory[(address + 1) % size];
+            page[address % PAGE_SIZE] = decode(operationCode);
+        }
+    }
+    mJit.invalidate(first, last);
+    invalidateAot(first, last);
+}
 
-                    mV[X] |= mV[Y];
+void Chip8::invalidateWrapped(const Word address, const int count) {
+    const int first = address & mAddressMask;
+    const int last = first + count - 1;
+    invalidateMemory(first, std::min<int>(last, mAddressMask));
+    if (last > mAddressMask) {
+        invalidateMemory(0, last & mAddressMask);
+    }
+}
 
-                    mProgramCounter += 2;
-                    break;
+// Calls function with the first word of every plane selected by planes
+template <typename Function>
+static void forEachPlane(Chip8::Graphix& graphix, const Byte planes, Function function) {
+    for (int plane = 0; plane < 2; plane++) {
+        if (((planes >> plane) & 1) != 0) {
+            function(graphix.data() + plane * Chip8::PLANE_WORDS);
+        }
+    }
+}
 
-                case 0x0002: // 8XY2: Sets VX to VX AND VY 
-                    X = (operationCode & 0x0F00) >> 8;
-                    Y = (operationCode & 0x00F0) >> 4;
+// Skips the next instruction, XO-CHIP F000 NNNN is four bytes long and skipped as a whole
+template <Quirks QUIRKS>
+void Chip8::skip(Chip8& chip8) {
+    if constexpr (QUIRKS.instructionSet == Quirks::InstructionSet::XoChip) {
+        const Word next = chip8.mProgramCounter + 2;
+        if (chip8.mMemory[next & chip8.mAddressMask] == 0xF0 && chip8.mMemory[(next + 1) & chip8.mAddressMask] == 0x00) {
+            chip8.mProgramCounter += 2;
+        }
+    }
+    chip8.mProgramCounter += 2;
+}
 
-                    mV[X] &= mV[Y];
+template <Quirks QUIRKS>
+void Chip8::op00E0(Chip8& chip8, const Instruction&) { // 00E0: Clears the screen, or the selected planes
+    chip8.mDrawFlag = true;
+    if constexpr (QUIRKS.instructionSet == Quirks::InstructionSet::Chip8) {
+        std::fill_n(chip8.mGraphix.begin(), 32, 0);
+    }
+    else {
+        forEachPlane(chip8.mGraphix, chip8.mPlanes, [](uint64_t* plane) {
+            std::fill_n(plane, PLANE_WORDS, 0);
+        });
+    }
+    chip8.mDirtyRows = chip8.getAllRows();
 
-                    mProgramCounter += 2;
-                    break;
+    chip8.mProgramCounter += 2;
+}
 
-                case 0x0003: // 8XY3: Sets VX to VX XOR VY 
-                    X = (operationCode & 0x0F00) >> 8;
-                    Y = (operationCode & 0x00F0) >> 4;
+void Chip8::op00EE(Chip8& chip8, const Instruction&) { // 00EE: Returns from subroutine
+    chip8.mProgramCounter = chip8.mStack[--chip8.mStackP] + 2;
+}
 
-                    mV[X] ^= mV[Y];
+void Chip8::op1NNN(Chip8& chip8, const Instruction& instruction) { // 1NNN: Jump to address NNN
+    // A jump to itself repeats until the end of the run
+    if (instruction.NNN == chip8.mProgramCounter) {
+        chip8.elide(chip8.mRunEnd - chip8.mCycleCount - 1, {0x1});
+    }
+    chip8.mProgramCounter = instruction.NNN;
+}
 
-                    mProgramCounter += 2;
-                    break;
+void Chip8::op2NNN(Chip8& chip8, const Instruction& instruction) { // 2NNN: Calls subroutine at NNN 
+    chip8.mStack[chip8.mStackP++] = chip8.mProgramCounter;
 
-                case 0x0004: // 8XY4: Adds VY to VX, Sets VF to 1 if overflow and 0 if not
-                    X = (operationCode & 0x0F00) >> 8;
-                    Y = (operationCode & 0x00F0) >> 4;
+    chip8.mProgramCounter = instruction.NNN;
+}
 
-                    if (Word(mV[X] + mV[Y]) > 0x00FF) {
-                        mV[0xF] = 1;
-                    }
-                    else {
-                        mV[0xF] = 0;
-                    }
-                    mV[X] += mV[Y];
+template <Quirks QUIRKS>
+void Chip8::op3XNN(Chip8& chip8, const Instruction& instruction) { // 3XNN: Skips next instruction if VX == NN 
+    if (chip8.mV[instruction.X] == instruction.NN) {
+        skip<QUIRKS>(chip8);
+    }
 
-                    mProgramCounter += 2;
-                    break;
+    chip8.mProgramCounter += 2;
+}
 
-                case 0x0005: // 8XY5: Subtracts VY from VX, Sets VF to 0 if underflow and 1 if not
-                    X = (operationCode & 0x0F00) >> 8;
-                    Y = (operationCode & 0x00F0) >> 4;
+template <Quirks QUIRKS>
+void Chip8::op4XNN(Chip8& chip8, const Instruction& instruction) { // 4XNN: Skips next instruction if VX != NN 
+    if (chip8.mV[instruction.X] != instruction.NN) {
+        skip<QUIRKS>(chip8);
+    }
 
-                    if (mV[X] >= mV[Y]) {
-                        mV[0xF] = 1;
-                    }
-                    else {
-                        mV[0xF] = 0;
-                    }
-                    mV[X] = mV[X] - mV[Y];
+    chip8.mProgramCounter += 2;
+}
 
-                    mProgramCounter += 2;
-                    break;
+template <Quirks QUIRKS>
+void Chip8::op5XY0(Chip8& chip8, const Instruction& instruction) { // 5XY0: Skips next instruction if VX == VY 
+    if (chip8.mV[instruction.X] == chip8.mV[instruction.Y]) {
+        skip<QUIRKS>(chip8);
+    }
 
-                case 0x0006: // 8XY6: Stores the LSB of VX into VF before right shifting VX by 1 
-                    X = (operationCode & 0x0F00) >> 8;
+    chip8.mProgramCounter += 2;
+}
 
-                    mV[0xF] = mV[X] & 0x0001;
-                    mV[X] >>= 1;
+void Chip8::op6XNN(Chip8& chip8, const Instruction& instruction) { // 6XNN: Sets VX to NN 
+    chip8.mV[instruction.X] = instruction.NN;
 
-                    mProgramCounter += 2;
-                    break;
+    chip8.mProgramCounter += 2;
+}
 
-                case 0x0007: // 8XY7: Sets VX to VY subtracted by VX, Sets VF to 0 if overflow and 1 if not
-                    X = (operationCode & 0x0F00) >> 8;
-                    Y = (operationCode & 0x00F0) >> 4;
+void Chip8::op7XNN(Chip8& chip8, const Instruction& instruction) { // 7XNN: Adds NN to VX 
+    chip8.mV[instruction.X] += instruction.NN;
 
-                    if (mV[Y] >= mV[X]) {
-                        mV[0xF] = 1;
-                    }
-                    else {
-                        mV[0xF] = 0;
-                    }
-                    mV[X] = mV[Y] - mV[X];
+    chip8.mProgramCounter += 2;
+}
 
-                    mProgramCounter += 2;
-                    break;
+void Chip8::op8XY0(Chip8& chip8, const Instruction& instruction) { // 8XY0: Sets VX to VY
+    chip8.mV[instruction.X] = chip8.mV[instruction.Y];
 
-                case 0x000E: // 8XYE: Sets VF to 1 if VX MSB is set and 0 if not before left shifting VX by 1 
-                    X = (operationCode & 0x0F00) >> 8;
-                    Y = (operationCode & 0x00F0) >> 4;
+    chip8.mProgramCounter += 2;
+}
 
-                    mV[0xF] = mV[X] >> 7;
-                    mV[X] <<= 1;
+template <Quirks QUIRKS>
+void Chip8::op8XY1(Chip8& chip8, const Instruction& instruction) { // 8XY1: Sets VX to VX OR VY 
+    chip8.mV[instruction.X] |= chip8.mV[instruction.Y];
+    if constexpr (QUIRKS.logicResetsVF) {
+        chip8.mV[0xF] = 0;
+    }
 
-                    mProgramCounter += 2;
-                    break;
+    chip8.mProgramCounter += 2;
+}
 
-                default:
-                    std::cout << "Unknown opcode: " << std::to_string(operationCode) << std::endl;
-            }
-            break;
-             
-        case 0x9000: // 9XY0: Skips next instruction if VX != VY  
-            X = (operationCode & 0x0F00) >> 8;
-            Y = (operationCode & 0x00F0) >> 4;
+template <Quirks QUIRKS>
+void Chip8::op8XY2(Chip8& chip8, const Instruction& instruction) { // 8XY2: Sets VX to VX AND VY 
+    chip8.mV[instruction.X] &= chip8.mV[instruction.Y];
+    if constexpr (QUIRKS.logicResetsVF) {
+        chip8.mV[0xF] = 0;
+    }
 
-            if (mV[X] != mV[Y]) {
-                mProgramCounter += 2;
-            }
-           
-            mProgramCounter += 2;
-            break;
+    chip8.mProgramCounter += 2;
+}
 
-        case 0xA000: // ANNN: Sets index registry to the address NNN
-            N = operationCode & 0x0FFF;
+template <Quirks QUIRKS>
+void Chip8::op8XY3(Chip8& chip8, const Instruction& instruction) { // 8XY3: Sets VX to VX XOR VY 
+    chip8.mV[instruction.X] ^= chip8.mV[instruction.Y];
+    if constexpr (QUIRKS.logicResetsVF) {
+        chip8.mV[0xF] = 0;
+    }
 
-            mIndexRegistry = N;
+    chip8.mProgramCounter += 2;
+}
 
-            mProgramCounter += 2;
-            break;
-             
-        case 0xB000: // BNNN: Jumps to the address NNN + V0 
-            N = operationCode & 0x0FFF;
+template <Quirks QUIRKS>
+void Chip8::op8XY4(Chip8& chip8, const Instruction& instruction) { // 8XY4: Adds VY to VX, Sets VF to 1 if overflow and 0 if not
+    std::array<Byte, 16>& V = chip8.mV;
 
-            mProgramCounter = N + mV[0];
-            break;
-             
-        case 0xC000: // CXNN: Sets VX to NN AND random number (0-255)
-            N = operationCode & 0x00FF;
-            X = (operationCode & 0x0F00) >> 8;
+    const Byte flag = Word(V[instruction.X] + V[instruction.Y]) > 0x00FF ? 1 : 0;
+    if constexpr (QUIRKS.flagWrittenLast) {
+        V[instruction.X] += V[instruction.Y];
+        V[0xF] = flag;
+    }
+    else {
+        V[0xF] = flag;
+        V[instruction.X] += V[instruction.Y];
+    }
 
-            mV[X] = N & randomNumber(); 
+    chip8.mProgramCounter += 2;
+}
 
-            mProgramCounter += 2;
-            break;
-             
-        case 0xD000: // DXYN: Draws sprite with height N in memory location I at position (X, Y) and sets VF to 1 on collision
-            {
-                N = operationCode & 0x000F;
-                X = (operationCode & 0x0F00) >> 8;
-                Y = (operationCode & 0x00F0) >> 4;
-
-                mDrawFlag = true;
-
-                mV[0xF] = 0;
-                for (int row = 0; row < N; row++) {
-                    for (int bit = 0; bit < 8; bit++) {
-                        Word index = ((mV[X] + bit) + (mV[Y] + row) * 64) % 2048; 
-                        if ((mMemory[mIndexRegistry + row] & (0b10000000 >> bit)) != 0) {
-                            if (mGraphix[index] == 1) {
-                                mV[0xF] = 1;
-                            }
-                            mGraphix[index] ^= 1;
-                        }
+template <Quirks QUIRKS>
+void Chip8::op8XY5(Chip8& chip8, const Instruction& instruction) { // 8XY5: Subtracts VY from VX, Sets VF to 0 if underflow and 1 if not
+    std::array<Byte, 16>& V = chip8.mV;
+
+    const Byte flag = V[instruction.X] >= V[instruction.Y] ? 1 : 0;
+    if constexpr (QUIRKS.flagWrittenLast) {
+        V[instruction.X] = V[instruction.X] - V[instruction.Y];
+        V[0xF] = flag;
+    }
+    else {
+        V[0xF] = flag;
+        V[instruction.X] = V[instruction.X] - V[instruction.Y];
+    }
+
+    chip8.mProgramCounter += 2;
+}
+
+template <Quirks QUIRKS>
+void Chip8::op8XY6(Chip8& chip8, const Instruction& instruction) { // 8XY6: Stores the LSB of VX (or VY) into VF before right shifting it by 1 into VX
+    std::array<Byte, 16>& V = chip8.mV;
+    const Byte source = QUIRKS.shiftReadsVY ? instruction.Y : instruction.X;
+
+    const Byte flag = V[source] & 0x01;
+    if constexpr (QUIRKS.flagWrittenLast) {
+        V[instruction.X] = V[source] >> 1;
+        V[0xF] = flag;
+    }
+    else {
+        V[0xF] = flag;
+        V[instruction.X] = V[source] >> 1;
+    }
+
+    chip8.mProgramCounter += 2;
+}
+
+template <Quirks QUIRKS>
+void Chip8::op8XY7(Chip8& chip8, const Instruction& instruction) { // 8XY7: Sets VX to VY subtracted by VX, Sets VF to 0 if overflow and 1 if not
+    std::array<Byte, 16>& V = chip8.mV;
+
+    const Byte flag = V[instruction.Y] >= V[instruction.X] ? 1 : 0;
+    if constexpr (QUIRKS.flagWrittenLast) {
+        V[instruction.X] = V[instruction.Y] - V[instruction.X];
+        V[0xF] = flag;
+    }
+    else {
+        V[0xF] = flag;
+        V[instruction.X] = V[instruction.Y] - V[instruction.X];
+    }
+
+    chip8.mProgramCounter += 2;
+}
+
+template <Quirks QUIRKS>
+void Chip8::op8XYE(Chip8& chip8, const Instruction& instruction) { // 8XYE: Sets VF to 1 if the MSB of VX (or VY) is set and 0 if not before left shifting it by 1 into VX
+    std::array<Byte, 16>& V = chip8.mV;
+    const Byte source = QUIRKS.shiftReadsVY ? instruction.Y : instruction.X;
+
+    const Byte flag = V[source] >> 7;
+    if constexpr (QUIRKS.flagWrittenLast) {
+        V[instruction.X] = V[source] << 1;
+        V[0xF] = flag;
+    }
+    else {
+        V[0xF] = flag;
+        V[instruction.X] = V[source] << 1;
+    }
+
+    chip8.mProgramCounter += 2;
+}
+
+template <Quirks QUIRKS>
+void Chip8::op9XY0(Chip8& chip8, const Instruction& instruction) { // 9XY0: Skips next instruction if VX != VY  
+    if (chip8.mV[instruction.X] != chip8.mV[instruction.Y]) {
+        skip<QUIRKS>(chip8);
+    }
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opANNN(Chip8& chip8, const Instruction& instruction) { // ANNN: Sets index registry to the address NNN
+    chip8.mIndexRegistry = instruction.NNN;
+
+    chip8.mProgramCounter += 2;
+}
+
+template <Quirks QUIRKS>
+void Chip8::opBNNN(Chip8& chip8, const Instruction& instruction) { // BNNN: Jumps to the address NNN + V0, or XNN + VX
+    chip8.mProgramCounter = instruction.NNN + chip8.mV[QUIRKS.jumpWithVX ? instruction.X : 0];
+}
+
+void Chip8::opCXNN(Chip8& chip8, const Instruction& instruction) { // CXNN: Sets VX to NN AND random number (0-255)
+    chip8.mV[instruction.X] = instruction.NN & (chip8.mRandom() >> (sizeof(RandomEngine::result_type) * 8 - 8)); 
+
+    chip8.mProgramCounter += 2;
+}
+
+template <Quirks QUIRKS>
+void Chip8::opDXYN(Chip8& chip8, const Instruction& instruction) { // DXYN: Draws sprite with height N in memory location I at position (X, Y) and sets VF to 1 on collision
+    if constexpr (QUIRKS.instructionSet != Quirks::InstructionSet::Chip8) {
+        drawExtended<QUIRKS>(chip8, instruction);
+        return;
+    }
+
+    std::array<Byte, 16>& V = chip8.mV;
+    Graphix& graphix = chip8.mGraphix;
+
+    chip8.mDrawFlag = true;
+
+    if constexpr (QUIRKS.spriteEdge != Quirks::SpriteEdge::Line) {
+        // The position wraps around the screen, the sprite itself is cut off at the right and bottom edges
+        const int column = V[instruction.X] & 63;
+        const int top = V[instruction.Y] & 31;
+
+        uint64_t collision = 0;
+        for (int row = 0; row < instruction.N && top + row < 32; row++) {
+            const uint64_t bits = (uint64_t(chip8.mMemory[(chip8.mIndexRegistry + row) & chip8.mAddressMask]) << 56) >> column;
+            uint64_t& line = graphix[top + row];
+            collision |= line & bits;
+            line ^= bits;
+            chip8.mDirtyRows |= 1u << (top + row);
+        }
+        V[0xF] = collision != 0 ? 1 : 0;
+
+        if constexpr (INSTRUMENTATION) {
+            chip8.mCounters.draws++;
+            chip8.mCounters.spriteRows += instruction.N;
+            chip8.mCounters.collisions += V[0xF];
+        }
+        chip8.mProgramCounter += 2;
+        return;
+    }
+
+    // The screen is drawn as one 2048 pixel line, so pixels past the right edge continue on the next row
+    // and rows past the bottom wrap to the top.
+    if (instruction.X == 0xF || instruction.Y == 0xF) {
+        // Position is read from VF, which changes while drawing, so every pixel is placed on its own
+        V[0xF] = 0;
+        for (int row = 0; row < instruction.N; row++) {
+            for (int bit = 0; bit < 8; bit++) {
+                Word index = ((V[instruction.X] + bit) + (V[instruction.Y] + row) * 64) % 2048; 
+                if ((chip8.mMemory[(chip8.mIndexRegistry + row) & chip8.mAddressMask] & (0b10000000 >> bit)) != 0) {
+                    uint64_t pixel = uint64_t(1) << (63 - (index & 63));
+                    if ((graphix[index >> 6] & pixel) != 0) {
+                        V[0xF] = 1;
                     }
+                    graphix[index >> 6] ^= pixel;
+                    chip8.mDirtyRows |= 1u << (index >> 6);
                 }
-                mProgramCounter += 2;
             }
-            break;
-             
-        case 0xE000: 
-            switch (operationCode & 0x00FF) {
-                case 0x009E: // EX9E: Skips next instruction if key X is pressed 
-                    X = (operationCode & 0x0F00) >> 8;
+        }
 
-                    if (mKeys[mV[X]] == true) {
-                        mProgramCounter += 2;
-                    }
+        if constexpr (INSTRUMENTATION) {
+            chip8.mCounters.draws++;
+            chip8.mCounters.spriteRows += instruction.N;
+            chip8.mCounters.collisions += V[0xF];
+        }
+        chip8.mProgramCounter += 2;
+        return;
+    }
+
+    uint64_t collision = 0;
+    for (int row = 0; row < instruction.N; row++) {
+        const uint64_t sprite = chip8.mMemory[(chip8.mIndexRegistry + row) & chip8.mAddressMask];
+        const Word index = (V[instruction.X] + (V[instruction.Y] + row) * 64) % 2048;
+        const int column = index & 63;
+        uint64_t& line = graphix[index >> 6];
+
+        const uint64_t bits = (sprite << 56) >> column;
+        collision |= line & bits;
+        line ^= bits;
+        chip8.mDirtyRows |= 1u << (index >> 6);
+
+        if (column > 56) {
+            uint64_t& nextLine = graphix[((index >> 6) + 1) & 31];
+            const uint64_t spill = sprite << (120 - column);
+            collision |= nextLine & spill;
+            nextLine ^= spill;
+            chip8.mDirtyRows |= 1u << (((index >> 6) + 1) & 31);
+        }
+    }
+    V[0xF] = collision != 0 ? 1 : 0;
 
-                    mProgramCounter += 2;
-                    break;
+    if constexpr (INSTRUMENTATION) {
+        chip8.mCounters.draws++;
+        chip8.mCounters.spriteRows += instruction.N;
+        chip8.mCounters.collisions += V[0xF];
+    }
 
-                case 0x00A1: // EXA1: Skips next instruction if key X is not pressed 
-                    X = (operationCode & 0x0F00) >> 8;
+    chip8.mProgramCounter += 2;
+}
 
-                    if (mKeys[mV[X]] == false) {
-                        mProgramCounter += 2;
-                    }
+// DXYN of SUPER-CHIP and XO-CHIP at either resolution, DXY0 draws a 16x16 sprite. A sprite row is shifted
+// across the two words it can touch, so at high resolution a row is drawn with two word operations like at low.
+template <Quirks QUIRKS>
+void Chip8::drawExtended(Chip8& chip8, const Instruction& instruction) {
+    std::array<Byte, 16>& V = chip8.mV;
+
+    const int rowWords = chip8.mHighResolution ? 2 : 1;
+    const int width = 64 * rowWords;
+    const int height = 32 * rowWords;
+    const int column = V[instruction.X] & (width - 1);
+    const int top = V[instruction.Y] & (height - 1);
+    const bool large = instruction.N == 0;
+    const int rows = large ? 16 : instruction.N;
+
+    const int word = column >> 6;
+    const int shift = column & 63;
+    // Word receiving the bits shifted past the right end of word, -1 where the sprite is clipped
+    int spillWord = word + 1;
+    if (spillWord == rowWords) {
+        spillWord = QUIRKS.spriteEdge == Quirks::SpriteEdge::Wrap ? 0 : -1;
+    }
 
-                    mProgramCounter += 2;
-                    break;
+    chip8.mDrawFlag = true;
 
-                default:
-                    std::cout << "Unknown opcode: " << std::to_string(operationCode) << std::endl;
+    // Each selected plane takes the next sprite from memory
+    Word address = chip8.mIndexRegistry;
+    uint64_t collision = 0;
+    forEachPlane(chip8.mGraphix, chip8.mPlanes, [&](uint64_t* plane) {
+        for (int row = 0; row < rows; row++) {
+            uint64_t bits = uint64_t(chip8.mMemory[address++ & chip8.mAddressMask]) << 56;
+            if (large) {
+                bits |= uint64_t(chip8.mMemory[address++ & chip8.mAddressMask]) << 48;
             }
-            break;
-             
-        case 0xF000: 
-            switch (operationCode & 0x00FF) {
-                case 0x0007: // FX07: sets VX to the delay timers value
-                    X = (operationCode & 0x0F00) >> 8;
 
-                    mV[X] = mDelayTimer;
+            int y = top + row;
+            if (y >= height) {
+                if constexpr (QUIRKS.spriteEdge != Quirks::SpriteEdge::Wrap) {
+                    continue;
+                }
+                y -= height;
+            }
 
-                    mProgramCounter += 2;
-                    break;
+            uint64_t* line = plane + y * rowWords;
+            const uint64_t high = bits >> shift;
+            collision |= line[word] & high;
+            line[word] ^= high;
+            if (shift != 0 && spillWord >= 0) {
+                const uint64_t low = bits << (64 - shift);
+                collision |= line[spillWord] & low;
+                line[spillWord] ^= low;
+            }
+            chip8.mDirtyRows |= uint64_t(1) << y;
+        }
+    });
+    V[0xF] = collision != 0 ? 1 : 0;
 
-                case 0x000A: // FX0A: Waits for input and sets VX to the pressed key
-                    X = (operationCode & 0x0F00) >> 8;
+    if constexpr (INSTRUMENTATION) {
+        chip8.mCounters.draws++;
+        chip8.mCounters.spriteRows += rows;
+        chip8.mCounters.collisions += V[0xF];
+    }
+    chip8.mProgramCounter += 2;
+}
 
-                    for (uint64_t i = 0; i < mKeys.size(); i++) {
-                        if (mKeys[i] == true) {
+template <Quirks QUIRKS>
+void Chip8::opEX9E(Chip8& chip8, const Instruction& instruction) { // EX9E: Skips next instruction if key X is pressed 
+    if (chip8.mKeys[chip8.mV[instruction.X]] == true) {
+        skip<QUIRKS>(chip8);
+    }
 
-                            mV[X] = i;
+    chip8.mProgramCounter += 2;
+}
 
-                            mProgramCounter += 2;
-                            break;
-                        }
-                    }
-                    break;
+template <Quirks QUIRKS>
+void Chip8::opEXA1(Chip8& chip8, const Instruction& instruction) { // EXA1: Skips next instruction if key X is not pressed 
+    if (chip8.mKeys[chip8.mV[instruction.X]] == false) {
+        skip<QUIRKS>(chip8);
+    }
 
-                case 0x0015: // FX15: Sets delay timer to VX
-                    X = (operationCode & 0x0F00) >> 8;
+    chip8.mProgramCounter += 2;
+}
 
-                    mDelayTimer = mV[X];
+void Chip8::opFX07(Chip8& chip8, const Instruction& instruction) { // FX07: sets VX to the delay timers value
+    chip8.mV[instruction.X] = chip8.mDelayTimer;
+    chip8.skipDelayWait(instruction.X);
 
-                    mProgramCounter += 2;
-                    break;
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opFX0A(Chip8& chip8, const Instruction& instruction) { // FX0A: Waits for input and sets VX to the pressed key
+    for (uint64_t i = 0; i < chip8.mKeys.size(); i++) {
+        if (chip8.mKeys[i] == true) {
 
-                case 0x0018: // FX18: Sets the sound timer to VX 
-                    X = (operationCode & 0x0F00) >> 8;
+            chip8.mV[instruction.X] = i;
 
-                    mSoundTimer = mV[X];
+            chip8.mProgramCounter += 2;
+            return;
+        }
+    }
 
-                    mProgramCounter += 2;
-                    break;
+    // The keys only change between runs, so the machine waits here until the end of the run
+    chip8.elide(chip8.mRunEnd - chip8.mCycleCount - 1, {0xF});
+}
 
-                case 0x001E: // FX1E: Adds VX to I
-                    X = (operationCode & 0x0F00) >> 8;
+void Chip8::opFX15(Chip8& chip8, const Instruction& instruction) { // FX15: Sets delay timer to VX
+    chip8.mDelayTimer = chip8.mV[instruction.X];
+    if constexpr (INSTRUMENTATION) {
+        chip8.mCounters.timerWrites++;
+    }
 
-                    mIndexRegistry += mV[X];
+    chip8.mProgramCounter += 2;
+}
 
-                    mProgramCounter += 2;
-                    break;
+void Chip8::opFX18(Chip8& chip8, const Instruction& instruction) { // FX18: Sets the sound timer to VX 
+    chip8.mSoundTimer = chip8.mV[instruction.X];
+    if constexpr (INSTRUMENTATION) {
+        chip8.mCounters.timerWrites++;
+    }
 
-                case 0x0029: // FX29: Sets I to the memory address of font for character X
-                    X = (operationCode & 0x0F00) >> 8;
+    chip8.mProgramCounter += 2;
+}
 
-                    mIndexRegistry = 0x50 + (5 * mV[X]);
+void Chip8::opFX1E(Chip8& chip8, const Instruction& instruction) { // FX1E: Adds VX to I
+    chip8.mIndexRegistry += chip8.mV[instruction.X];
 
-                    mProgramCounter += 2;
-                    break;
+    chip8.mProgramCounter += 2;
+}
 
-                case 0x0033: // FX33: Stores BCD of VX in memory addresses I to I + 2 
-                    X = (operationCode & 0x0F00) >> 8;
+void Chip8::opFX29(Chip8& chip8, const Instruction& instruction) { // FX29: Sets I to the memory address of font for character X
+    chip8.mIndexRegistry = 0x50 + (5 * chip8.mV[instruction.X]);
 
-                    mMemory[mIndexRegistry] = ( mV[X] / 100);
-                    mMemory[mIndexRegistry + 1] = ( (mV[X] / 10) % 10);
-                    mMemory[mIndexRegistry + 2] = ( (mV[X] % 100) % 10);
+    chip8.mProgramCounter += 2;
+}
 
-                    mProgramCounter += 2;
-                    break;
+void Chip8::opFX33(Chip8& chip8, const Instruction& instruction) { // FX33: Stores BCD of VX in memory addresses I to I + 2 
+    const Word I = chip8.mIndexRegistry;
+    const Byte VX = chip8.mV[instruction.X];
 
-                case 0x0055: // FX55: Stores from V0 to VX into memory starting at address I 
-                    X = (operationCode & 0x0F00) >> 8;
+    chip8.mMemory[I & chip8.mAddressMask] = (VX / 100);
+    chip8.mMemory[(I + 1) & chip8.mAddressMask] = ((VX / 10) % 10);
+    chip8.mMemory[(I + 2) & chip8.mAddressMask] = ((VX % 100) % 10);
+    chip8.invalidateWrapped(I, 3);
 
-                    for (int i = 0; i <= X; i++) {
-                        mMemory[mIndexRegistry + i] = mV[i];
-                    }
+    chip8.mProgramCounter += 2;
+}
 
-                    mProgramCounter += 2;
-                    break;
+// Moves I past the registers stored or loaded by FX55/FX65
+template <Quirks QUIRKS>
+static void advanceIndex(Word& indexRegistry, const Byte X) {
+    if constexpr (QUIRKS.loadStoreIndex == Quirks::IndexIncrement::X) {
+        indexRegistry += X;
+    }
+    else if constexpr (QUIRKS.loadStoreIndex == Quirks::IndexIncrement::XPlusOne) {
+        indexRegistry += X + 1;
+    }
+}
 
-                case 0x0065: // FX65: Fills from V0 to VX from memory starting at address I 
-                    X = (operationCode & 0x0F00) >> 8;
+template <Quirks QUIRKS>
+void Chip8::opFX55(Chip8& chip8, const Instruction& instruction) { // FX55: Stores from V0 to VX into memory starting at address I 
+    const Word I = chip8.mIndexRegistry;
 
-                    for (int i = 0; i <= X; i++) {
-                         mV[i] = mMemory[mIndexRegistry + i];
-                    }
+    for (int i = 0; i <= instruction.X; i++) {
+        chip8.mMemory[(I + i) & chip8.mAddressMask] = chip8.mV[i];
+    }
+    chip8.invalidateWrapped(I, instruction.X + 1);
+    advanceIndex<QUIRKS>(chip8.mIndexRegistry, instruction.X);
+
+    chip8.mProgramCounter += 2;
+}
+
+template <Quirks QUIRKS>
+void Chip8::opFX65(Chip8& chip8, const Instruction& instruction) { // FX65: Fills from V0 to VX from memory starting at address I 
+    for (int i = 0; i <= instruction.X; i++) {
+        chip8.mV[i] = chip8.mMemory[(chip8.mIndexRegistry + i) & chip8.mAddressMask];
+    }
+    advanceIndex<QUIRKS>(chip8.mIndexRegistry, instruction.X);
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::op00CN(Chip8& chip8, const Instruction& instruction) { // 00CN: Scrolls the selected planes down by N rows
+    const int rowWords = chip8.mHighResolution ? 2 : 1;
+    const int words = 32 * rowWords * rowWords;
+    const int scrolled = instruction.N * rowWords;
 
-                    mProgramCounter += 2;
-                    break;
+    // Rows are consecutive words, so scrolling vertically moves one block of memory
+    forEachPlane(chip8.mGraphix, chip8.mPlanes, [&](uint64_t* plane) {
+        std::copy_backward(plane, plane + words - scrolled, plane + words);
+        std::fill_n(plane, scrolled, 0);
+    });
+    chip8.mDrawFlag = true;
+    chip8.mDirtyRows = chip8.getAllRows();
 
-                default:
-                    std::cout << "Unknown opcode: " << std::to_string(operationCode) << std::endl;
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::op00DN(Chip8& chip8, const Instruction& instruction) { // 00DN: Scrolls the selected planes up by N rows
+    const int rowWords = chip8.mHighResolution ? 2 : 1;
+    const int words = 32 * rowWords * rowWords;
+    const int scrolled = instruction.N * rowWords;
+
+    forEachPlane(chip8.mGraphix, chip8.mPlanes, [&](uint64_t* plane) {
+        std::copy(plane + scrolled, plane + words, plane);
+        std::fill_n(plane + words - scrolled, scrolled, 0);
+    });
+    chip8.mDrawFlag = true;
+    chip8.mDirtyRows = chip8.getAllRows();
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::op00FB(Chip8& chip8, const Instruction&) { // 00FB: Scrolls the selected planes right by 4 pixels
+    const bool highResolution = chip8.mHighResolution;
+
+    // Whole rows are shifted, the bits leaving the left word of a row enter the right one
+    forEachPlane(chip8.mGraphix, chip8.mPlanes, [&](uint64_t* plane) {
+        if (highResolution) {
+            for (int row = 0; row < 64; row++) {
+                uint64_t* line = plane + 2 * row;
+                line[1] = line[1] >> 4 | line[0] << 60;
+                line[0] >>= 4;
             }
-            break;
+        }
+        else {
+            for (int row = 0; row < 32; row++) {
+                plane[row] >>= 4;
+            }
+        }
+    });
+    chip8.mDrawFlag = true;
+    chip8.mDirtyRows = chip8.getAllRows();
 
-        default:
-            std::cout << "Unknown opcode: " << std::to_string(operationCode) << std::endl;
-    }  
+    chip8.mProgramCounter += 2;
+}
 
-    if (mDelayTimer > 0) {
-        --mDelayTimer;
-    }
+void Chip8::op00FC(Chip8& chip8, const Instruction&) { // 00FC: Scrolls the selected planes left by 4 pixels
+    const bool highResolution = chip8.mHighResolution;
 
-    if (mSoundTimer > 0) {
-        if (mSoundTimer == 1) {
-            std::cout << "BEEP!" << std::endl;
+    forEachPlane(chip8.mGraphix, chip8.mPlanes, [&](uint64_t* plane) {
+        if (highResolution) {
+            for (int row = 0; row < 64; row++) {
+                uint64_t* line = plane + 2 * row;
+                line[0] = line[0] << 4 | line[1] >> 60;
+                line[1] <<= 4;
+            }
+        }
+        else {
+            for (int row = 0; row < 32; row++) {
+                plane[row] <<= 4;
+            }
         }
-        --mSoundTimer;
-    } 
+    });
+    chip8.mDrawFlag = true;
+    chip8.mDirtyRows = chip8.getAllRows();
 
-    std::this_thread::sleep_for(std::chrono::milliseconds(1000/mTicksPerSecond));
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::op00FD(Chip8&, const Instruction&) { // 00FD: Exits the interpreter, the program counter stays on this instruction
+}
+
+void Chip8::op00FE(Chip8& chip8, const Instruction&) { // 00FE: Switches to 64x32 and clears the screen
+    chip8.mHighResolution = false;
+    chip8.mGraphix.fill(0);
+    chip8.mDrawFlag = true;
+    chip8.mDirtyRows = chip8.getAllRows();
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::op00FF(Chip8& chip8, const Instruction&) { // 00FF: Switches to 128x64 and clears the screen
+    chip8.mHighResolution = true;
+    chip8.mGraphix.fill(0);
+    chip8.mDrawFlag = true;
+    chip8.mDirtyRows = chip8.getAllRows();
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::op5XY2(Chip8& chip8, const Instruction& instruction) { // 5XY2: Stores VX to VY into memory starting at address I, I is unchanged
+    const Word I = chip8.mIndexRegistry;
+    const int step = instruction.X <= instruction.Y ? 1 : -1;
+    const int count = std::abs(instruction.Y - instruction.X) + 1;
+
+    for (int i = 0; i < count; i++) {
+        chip8.mMemory[(I + i) & chip8.mAddressMask] = chip8.mV[instruction.X + i * step];
+    }
+    chip8.invalidateWrapped(I, count);
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::op5XY3(Chip8& chip8, const Instruction& instruction) { // 5XY3: Fills VX to VY from memory starting at address I, I is unchanged
+    const Word I = chip8.mIndexRegistry;
+    const int step = instruction.X <= instruction.Y ? 1 : -1;
+    const int count = std::abs(instruction.Y - instruction.X) + 1;
+
+    for (int i = 0; i < count; i++) {
+        chip8.mV[instruction.X + i * step] = chip8.mMemory[(I + i) & chip8.mAddressMask];
+    }
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opF000(Chip8& chip8, const Instruction&) { // F000 NNNN: Sets I to the 16 bit address NNNN following the instruction
+    const Word next = chip8.mProgramCounter + 2;
+    chip8.mIndexRegistry = chip8.mMemory[next & chip8.mAddressMask] << 8 | chip8.mMemory[(next + 1) & chip8.mAddressMask];
+
+    chip8.mProgramCounter += 4;
+}
+
+void Chip8::opFN01(Chip8& chip8, const Instruction& instruction) { // FN01: Selects the planes N (bit per plane) for drawing, scrolling and clearing
+    chip8.mPlanes = instruction.X & 0x3;
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opF002(Chip8& chip8, const Instruction&) { // F002: Loads the 16 byte audio pattern from memory starting at address I
+    for (size_t i = 0; i < chip8.mAudioPattern.size(); i++) {
+        chip8.mAudioPattern[i] = chip8.mMemory[(chip8.mIndexRegistry + i) & chip8.mAddressMask];
+    }
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opFX30(Chip8& chip8, const Instruction& instruction) { // FX30: Sets I to the memory address of the large font for character X
+    chip8.mIndexRegistry = 0xA0 + (10 * (chip8.mV[instruction.X] & 0x0F));
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opFX3A(Chip8& chip8, const Instruction& instruction) { // FX3A: Sets the pitch of the audio pattern to VX
+    chip8.mPitch = chip8.mV[instruction.X];
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opFX75(Chip8& chip8, const Instruction& instruction) { // FX75: Stores from V0 to VX into the user flags
+    std::copy_n(chip8.mV.begin(), instruction.X + 1, chip8.mFlags.begin());
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opFX85(Chip8& chip8, const Instruction& instruction) { // FX85: Fills from V0 to VX from the user flags
+    std::copy_n(chip8.mFlags.begin(), instruction.X + 1, chip8.mV.begin());
+
+    chip8.mProgramCounter += 2;
+}
+
+void Chip8::opUnknown(Chip8& chip8, const Instruction& instruction) {
+    // The program counter stays, so the machine runs into the same instruction every cycle and only
+    // reports it the first time
+    if (chip8.mCounters.unknownOpcodes++ == 0) {
+        std::cout << "Unknown opcode: " << std::to_string(instruction.operationCode) << "\n";
+    }
 }
 
 void Chip8::setKeys(const std::array<bool, 16>& keyState) {
     mKeys = keyState; 
 }
 
-const std::array<Byte, 4096>& Chip8::getMemory() const {
+const std::vector<Byte>& Chip8::getMemory() const {
     return mMemory;
 }
 
-const std::array<Byte, 64 * 32>& Chip8::getGraphix() const {
+const Chip8::Graphix& Chip8::getGraphix() const {
     return mGraphix;
 }
 
+std::vector<Byte> Chip8::getUnpackedGraphix() const {
+    const int width = getWidth();
+    std::vector<Byte> pixels(width * getHeight());
+    for (int pixel = 0; pixel < int(pixels.size()); pixel++) {
+        // A row is width / 64 words in both planes
+        const int word = pixel / 64;
+        const int bit = 63 - pixel % 64;
+        pixels[pixel] = ((mGraphix[word] >> bit) & 1) | ((mGraphix[PLANE_WORDS + word] >> bit) & 1) << 1;
+    }
+    return pixels;
+}
+
+bool Chip8::isHighResolution() const {
+    return mHighResolution;
+}
+
+int Chip8::getWidth() const {
+    return mHighResolution ? 128 : 64;
+}
+
+int Chip8::getHeight() const {
+    return mHighResolution ? 64 : 32;
+}
+
+uint64_t Chip8::getDirtyRows() const {
+    return mDirtyRows;
+}
+
+void Chip8::clearDirtyRows() {
+    mDirtyRows = 0;
+}
+
 Word Chip8::getProgramCounter() const {
     return mProgramCounter;
 }
@@ -476,6 +1445,10 @@ Byte Chip8::getSoundTimer() const {
     return mSoundTimer;
 }
 
+bool Chip8::isSoundActive() const {
+    return mSoundTimer > 0;
+}
+
 const std::array<Word, 16>& Chip8::getStack() const {
     return mStack;
 }
@@ -491,3 +1464,33 @@ const std::array<bool, 16>& Chip8::getKeys() const {
 bool Chip8::getDrawFlag() const {
     return mDrawFlag;
 }
+
+uint64_t Chip8::getCycleCount() const {
+    return mCycleCount;
+}
+
+uint64_t Chip8::getElidedCycles() const {
+    return mElidedCycles;
+}
+
+bool Chip8::isWaitingForKey() const {
+    const Word address = mProgramCounter & mAddressMask;
+    return (mMemory[address] & 0xF0) == 0xF0 && mMemory[(address + 1) & mAddressMask] == 0x0A
+        && std::none_of(mKeys.begin(), mKeys.end(), [](const bool pressed) { return pressed; });
+}
+
+const RandomEngine& Chip8::getRandomEngine() const {
+    return mRandom;
+}
+
+Backend Chip8::getBackend() const {
+    return mBackend;
+}
+
+QuirkProfile Chip8::getQuirkProfile() const {
+    return mQuirkProfile;
+}
+
+const Counters& Chip8::getCounters() const {
+    return mCounters;
+}
@@ -0,0 +1,25 @@
+#include "counters.hpp"
+
+#include <string>
+
+// Instruction families by their most significant nibble, as in chip8-bench
+static const std::array<const char*, 16> FAMILIES = {
+    "0NNN", "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+    "8XYN", "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EXNN", "FXNN"
+};
+
+void Counters::writeJson(std::ostream& os, const int indent) const {
+    const std::string pad(indent, ' ');
+
+    os << "{\n" << pad << "  \"families\": {";
+    for (size_t family = 0; family < FAMILIES.size(); family++) {
+        os << (family == 0 ? "" : ", ") << "\"" << FAMILIES[family] << "\": " << families[family];
+    }
+    os << "},\n";
+    os << pad << "  \"draws\": " << draws << ",\n";
+    os << pad << "  \"sprite_rows\": " << spriteRows << ",\n";
+    os << pad << "  \"collisions\": " << collisions << ",\n";
+    os << pad << "  \"timer_writes\": " << timerWrites << ",\n";
+    os << pad << "  \"unknown_opcodes\": " << unknownOpcodes << "\n";
+    os << pad << "}";
+}
@@ -0,0 +1,191 @@
+#include "debugger.hpp"
+
+#include <algorithm>
+
+Debugger::Debugger(Chip8& chip8) :
+mChip8(chip8)
+{
+}
+
+Debugger::~Debugger() {
+    mChip8.setDebugger(nullptr);
+}
+
+void Debugger::addBreakpoint(const Word address) {
+    if (!mBreakpoints[address]) {
+        mBreakpoints[address] = true;
+        mBreakpointCount++;
+    }
+    attach();
+}
+
+bool Debugger::removeBreakpoint(const Word address) {
+    if (!mBreakpoints[address]) {
+        return false;
+    }
+    mBreakpoints[address] = false;
+    mBreakpointCount--;
+    attach();
+    return true;
+}
+
+void Debugger::addWatchpoint(const Word first, const Word last) {
+    const std::vector<Byte>& memory = mChip8.getMemory();
+    Watchpoint watchpoint{first, last, {}};
+    for (size_t address = first; address <= last && address < memory.size(); address++) {
+        watchpoint.bytes.push_back(memory[address]);
+    }
+    mWatchpoints.push_back(std::move(watchpoint));
+    attach();
+}
+
+bool Debugger::removeWatchpoint(const Word first, const Word last) {
+    const auto watchpoint = std::find_if(mWatchpoints.begin(), mWatchpoints.end(), [&](const Watchpoint& other) {
+        return other.first == first && other.last == last;
+    });
+    if (watchpoint == mWatchpoints.end()) {
+        return false;
+    }
+    mWatchpoints.erase(watchpoint);
+    attach();
+    return true;
+}
+
+bool Debugger::addCondition(const int reg, const Word value) {
+    if (reg < 0 || reg >= REGISTERS) {
+        return false;
+    }
+    mConditions.push_back({reg, value, readRegister(mChip8, reg) == value});
+    attach();
+    return true;
+}
+
+bool Debugger::removeCondition(const int reg, const Word value) {
+    const auto condition = std::find_if(mConditions.begin(), mConditions.end(), [&](const Condition& other) {
+        return other.reg == reg && other.value == value;
+    });
+    if (condition == mConditions.end()) {
+        return false;
+    }
+    mConditions.erase(condition);
+    attach();
+    return true;
+}
+
+void Debugger::clear() {
+    mBreakpoints.reset();
+    mBreakpointCount = 0;
+    mWatchpoints.clear();
+    mConditions.clear();
+    attach();
+}
+
+void Debugger::interrupt() {
+    if (mStop == Stop::None) {
+        stop(Stop::Interrupt);
+    }
+}
+
+void Debugger::resume() {
+    sync();
+    mStop = Stop::None;
+    mResuming = true;
+    attach();
+}
+
+void Debugger::step() {
+    sync();
+    mStop = Stop::None;
+    mChip8.emulateCycle();
+    afterInstruction(mChip8);
+    if (mStop == Stop::None) {
+        stop(Stop::Step);
+    }
+}
+
+void Debugger::sync() {
+    const std::vector<Byte>& memory = mChip8.getMemory();
+    for (Watchpoint& watchpoint : mWatchpoints) {
+        for (size_t byte = 0; byte < watchpoint.bytes.size() && watchpoint.first + byte < memory.size(); byte++) {
+            watchpoint.bytes[byte] = memory[watchpoint.first + byte];
+        }
+    }
+    for (Condition& condition : mConditions) {
+        condition.held = readRegister(mChip8, condition.reg) == condition.value;
+    }
+}
+
+bool Debugger::isStopped() const {
+    return mStop != Stop::None;
+}
+
+Debugger::Stop Debugger::getStop() const {
+    return mStop;
+}
+
+Word Debugger::getStopAddress() const {
+    return mStopAddress;
+}
+
+Chip8& Debugger::getMachine() {
+    return mChip8;
+}
+
+bool Debugger::beforeInstruction(const Chip8& chip8) {
+    if (mStop != Stop::None) {
+        return false;
+    }
+
+    const Word address = chip8.getProgramCounter() & Word(chip8.getMemory().size() - 1);
+    if (mBreakpoints[address] && !mResuming) {
+        stop(Stop::Breakpoint);
+        return false;
+    }
+    mResuming = false;
+    return true;
+}
+
+void Debugger::afterInstruction(const Chip8& chip8) {
+    // Every watchpoint and condition is brought up to date, the first that triggered is the stop reason
+    const std::vector<Byte>& memory = chip8.getMemory();
+    for (Watchpoint& watchpoint : mWatchpoints) {
+        for (size_t byte = 0; byte < watchpoint.bytes.size() && watchpoint.first + byte < memory.size(); byte++) {
+            const Byte value = memory[watchpoint.first + byte];
+            if (value != watchpoint.bytes[byte]) {
+                watchpoint.bytes[byte] = value;
+                if (mStop == Stop::None) {
+                    mStopAddress = Word(watchpoint.first + byte);
+                    stop(Stop::Watchpoint);
+                }
+            }
+        }
+    }
+
+    for (Condition& condition : mConditions) {
+        const bool held = readRegister(chip8, condition.reg) == condition.value;
+        if (held && !condition.held && mStop == Stop::None) {
+            stop(Stop::Condition);
+        }
+        condition.held = held;
+    }
+}
+
+Word Debugger::readRegister(const Chip8& chip8, const int reg) {
+    switch (reg) {
+        case REGISTER_I: return chip8.getIndexRegistry();
+        case REGISTER_DELAY: return chip8.getDelayTimer();
+        case REGISTER_SOUND: return chip8.getSoundTimer();
+        default: return chip8.getVReg()[reg];
+    }
+}
+
+void Debugger::stop(const Stop reason) {
+    mStop = reason;
+    attach();
+}
+
+void Debugger::attach() {
+    const bool armed = mStop != Stop::None || mBreakpointCount > 0 || !mWatchpoints.empty() || !mConditions.empty();
+    mChip8.setDebugger(armed ? this : nullptr);
+    mResuming &= armed;
+}
@@ -0,0 +1,426 @@
+#include "debugserver.hpp"
+
+#include <algorithm>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#define CHIP8_DEBUG_SOCKET 1
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/un.h>
+#include <unistd.h>
+#else
+#define CHIP8_DEBUG_SOCKET 0
+#endif
+
+#ifndef MSG_NOSIGNAL
+#define MSG_NOSIGNAL 0
+#endif
+
+// Registers in the order of the g packet: V0 to VF, I, PC, SP, DT and ST
+static constexpr size_t REGISTER_BYTES = 16 + 2 + 2 + 2 + 1 + 1;
+// Longest m packet reply, in bytes of memory
+static constexpr uint64_t MAX_READ = 0x800;
+
+static void appendHex(std::string& hex, const uint64_t value, const int bytes) {
+    // Multi byte values are little endian like the registers of a GDB target
+    static constexpr char DIGITS[] = "0123456789abcdef";
+    for (int byte = 0; byte < bytes; byte++) {
+        const Byte part = Byte(value >> (byte * 8));
+        hex += DIGITS[part >> 4];
+        hex += DIGITS[part & 0xF];
+    }
+}
+
+static bool parseHex(const std::string& text, uint64_t& value) {
+    if (text.empty() || text.size() > 16) {
+        return false;
+    }
+    value = 0;
+    for (const char digit : text) {
+        int nibble;
+        if (digit >= '0' && digit <= '9') {
+            nibble = digit - '0';
+        }
+        else if (digit >= 'a' && digit <= 'f') {
+            nibble = digit - 'a' + 10;
+        }
+        else if (digit >= 'A' && digit <= 'F') {
+            nibble = digit - 'A' + 10;
+        }
+        else {
+            return false;
+        }
+        value = value << 4 | nibble;
+    }
+    return true;
+}
+
+static bool parseBytes(const std::string& hex, std::vector<Byte>& bytes) {
+    if (hex.size() % 2 != 0) {
+        return false;
+    }
+    bytes.clear();
+    for (size_t digit = 0; digit < hex.size(); digit += 2) {
+        uint64_t value;
+        if (!parseHex(hex.substr(digit, 2), value)) {
+            return false;
+        }
+        bytes.push_back(Byte(value));
+    }
+    return true;
+}
+
+// Splits "a,b,c" into hex numbers, false unless there are exactly count
+static bool parseArguments(const std::string& text, const size_t count, std::vector<uint64_t>& values) {
+    values.clear();
+    size_t start = 0;
+    while (values.size() < count) {
+        const size_t end = std::min(text.find(',', start), text.size());
+        uint64_t value;
+        if (!parseHex(text.substr(start, end - start), value)) {
+            return false;
+        }
+        values.push_back(value);
+        start = end + 1;
+    }
+    return start == text.size() + 1;
+}
+
+static std::string checksum(const std::string& packet) {
+    Byte sum = 0;
+    for (const char character : packet) {
+        sum += Byte(character);
+    }
+    std::string hex;
+    appendHex(hex, sum, 1);
+    return hex;
+}
+
+DebugServer::DebugServer(Debugger& debugger) :
+mDebugger(debugger)
+{
+}
+
+DebugServer::~DebugServer() {
+#if CHIP8_DEBUG_SOCKET
+    if (mClient >= 0) {
+        close(mClient);
+    }
+    if (mListener >= 0) {
+        close(mListener);
+        unlink(mPath.c_str());
+    }
+#endif
+}
+
+bool DebugServer::listen(const std::string& path) {
+#if CHIP8_DEBUG_SOCKET
+    sockaddr_un address{};
+    address.sun_family = AF_UNIX;
+    if (path.empty() || path.size() >= sizeof(address.sun_path) || mListener >= 0) {
+        return false;
+    }
+    path.copy(address.sun_path, path.size());
+
+    // Only a stale socket is replaced, a mistyped path must not delete a file
+    struct stat status;
+    if (lstat(path.c_str(), &status) == 0 && (!S_ISSOCK(status.st_mode) || unlink(path.c_str()) != 0)) {
+        return false;
+    }
+
+    const int listener = socket(AF_UNIX, SOCK_STREAM, 0);
+    if (listener < 0) {
+        return false;
+    }
+    // Clients read and write guest memory, so only the owner may connect
+    const mode_t mask = umask(0077);
+    const bool bound = bind(listener, reinterpret_cast<const sockaddr*>(&address), sizeof(address)) == 0;
+    umask(mask);
+    if (!bound || ::listen(listener, 1) != 0) {
+        close(listener);
+        return false;
+    }
+    mListener = listener;
+    mPath = path;
+    return true;
+#else
+    (void)path;
+    return false;
+#endif
+}
+
+void DebugServer::attach(const int socket) {
+    disconnect();
+    mClient = socket;
+    mDebugger.interrupt();
+}
+
+void DebugServer::poll(const int timeoutMs) {
+#if CHIP8_DEBUG_SOCKET
+    if (mClient < 0) {
+        pollfd listener{mListener, POLLIN, 0};
+        if (mListener >= 0 && ::poll(&listener, 1, timeoutMs) > 0) {
+            const int client = accept(mListener, nullptr, nullptr);
+            if (client >= 0) {
+                attach(client);
+            }
+        }
+        return;
+    }
+
+    if (mRunning && mDebugger.isStopped()) {
+        mRunning = false;
+        send(getStopReply());
+    }
+
+    pollfd client{mClient, POLLIN, 0};
+    if (::poll(&client, 1, timeoutMs) <= 0) {
+        return;
+    }
+    char buffer[4096];
+    ssize_t received;
+    while ((received = recv(mClient, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        mInput.append(buffer, received);
+    }
+    if (received == 0) {
+        disconnect();
+        return;
+    }
+
+    while (!mInput.empty() && mClient >= 0) {
+        if (mInput[0] == '\x03') {
+            mDebugger.interrupt();
+            mInput.erase(0, 1);
+            continue;
+        }
+        if (mInput[0] != '$') {
+            // Acknowledgements and noise between packets
+            mInput.erase(0, 1);
+            continue;
+        }
+
+        const size_t end = mInput.find('#');
+        if (end == std::string::npos || end + 3 > mInput.size()) {
+            break;
+        }
+        const std::string packet = mInput.substr(1, end - 1);
+        const bool intact = mInput.compare(end + 1, 2, checksum(packet)) == 0;
+        mInput.erase(0, end + 3);
+        if (!intact) {
+            ::send(mClient, "-", 1, MSG_NOSIGNAL);
+            continue;
+        }
+        ::send(mClient, "+", 1, MSG_NOSIGNAL);
+        handle(packet);
+    }
+
+    if (mRunning && mDebugger.isStopped()) {
+        mRunning = false;
+        send(getStopReply());
+    }
+#else
+    (void)timeoutMs;
+#endif
+}
+
+bool DebugServer::isAttached() const {
+    return mClient >= 0;
+}
+
+void DebugServer::handle(const std::string& packet) {
+    const char command = packet.empty() ? '\0' : packet[0];
+    const std::string arguments = packet.empty() ? "" : packet.substr(1);
+
+    if (packet == "?") {
+        send(getStopReply());
+    }
+    else if (packet == "g") {
+        send(readRegisters());
+    }
+    else if (command == 'G') {
+        send(writeRegisters(arguments) ? "OK" : "E01");
+    }
+    else if (command == 'm') {
+        const std::string bytes = readMemory(arguments);
+        send(bytes.empty() ? "E01" : bytes);
+    }
+    else if (command == 'M') {
+        send(writeMemory(arguments) ? "OK" : "E01");
+    }
+    else if (packet == "c") {
+        mDebugger.resume();
+        mRunning = true;
+    }
+    else if (packet == "s") {
+        mDebugger.step();
+        send(getStopReply());
+    }
+    else if ((command == 'Z' || command == 'z') && arguments.size() > 1 && arguments[1] == ',' &&
+             (arguments[0] == '0' || arguments[0] == '2' || arguments[0] == 'r')) {
+        send(setPoint(arguments, command == 'Z') ? "OK" : "E01");
+    }
+    else if (packet == "D") {
+        send("OK");
+        disconnect();
+    }
+    else if (packet == "k") {
+        disconnect();
+    }
+    else if (packet.rfind("qSupported", 0) == 0) {
+        send("PacketSize=1000");
+    }
+    else {
+        send("");
+    }
+}
+
+std::string DebugServer::readRegisters() const {
+    const Chip8& chip8 = mDebugger.getMachine();
+    std::string hex;
+    for (const Byte V : chip8.getVReg()) {
+        appendHex(hex, V, 1);
+    }
+    appendHex(hex, chip8.getIndexRegistry(), 2);
+    appendHex(hex, chip8.getProgramCounter(), 2);
+    appendHex(hex, chip8.getStackP(), 2);
+    appendHex(hex, chip8.getDelayTimer(), 1);
+    appendHex(hex, chip8.getSoundTimer(), 1);
+    return hex;
+}
+
+bool DebugServer::writeRegisters(const std::string& hex) {
+    std::vector<Byte> bytes;
+    if (!parseBytes(hex, bytes) || bytes.size() != REGISTER_BYTES) {
+        return false;
+    }
+
+    Chip8& chip8 = mDebugger.getMachine();
+    Chip8::State state = chip8.saveState();
+    std::copy_n(bytes.begin(), 16, state.V.begin());
+    state.indexRegistry = Word(bytes[16] | bytes[17] << 8);
+    state.programCounter = Word(bytes[18] | bytes[19] << 8);
+    state.stackP = Word(bytes[20] | bytes[21] << 8);
+    state.delayTimer = bytes[22];
+    state.soundTimer = bytes[23];
+    if (state.stackP > state.stack.size()) {
+        return false;
+    }
+    chip8.loadState(state);
+    mDebugger.sync();
+    return true;
+}
+
+std::string DebugServer::readMemory(const std::string& arguments) const {
+    const std::vector<Byte>& memory = mDebugger.getMachine().getMemory();
+    std::vector<uint64_t> values;
+    if (!parseArguments(arguments, 2, values) || values[1] == 0 || values[1] > MAX_READ ||
+        values[0] >= memory.size() || values[1] > memory.size() - values[0]) {
+        return "";
+    }
+
+    std::string hex;
+    for (uint64_t address = values[0]; address < values[0] + values[1]; address++) {
+        appendHex(hex, memory[address], 1);
+    }
+    return hex;
+}
+
+bool DebugServer::writeMemory(const std::string& arguments) {
+    const size_t colon = arguments.find(':');
+    std::vector<uint64_t> values;
+    std::vector<Byte> bytes;
+    if (colon == std::string::npos || !parseArguments(arguments.substr(0, colon), 2, values) ||
+        !parseBytes(arguments.substr(colon + 1), bytes) || bytes.size() != values[1]) {
+        return false;
+    }
+
+    // Written through a state, so the machine decodes the changed pages and drops their compiled blocks
+    Chip8& chip8 = mDebugger.getMachine();
+    Chip8::State state = chip8.saveState();
+    if (values[0] >= state.memory.size() || values[1] > state.memory.size() - values[0]) {
+        return false;
+    }
+    std::copy(bytes.begin(), bytes.end(), state.memory.begin() + values[0]);
+    chip8.loadState(state);
+    mDebugger.sync();
+    return true;
+}
+
+bool DebugServer::setPoint(const std::string& arguments, const bool set) {
+    const char type = arguments[0];
+    std::vector<uint64_t> values;
+    if (!parseArguments(arguments.substr(2), 2, values) || values[0] > 0xFFFF || values[1] > 0xFFFF) {
+        return false;
+    }
+
+    const Word first = Word(values[0]);
+    if (type == '0') {
+        if (set) {
+            mDebugger.addBreakpoint(first);
+            return true;
+        }
+        return mDebugger.removeBreakpoint(first);
+    }
+    if (type == '2') {
+        if (values[1] == 0 || values[0] + values[1] - 1 > 0xFFFF) {
+            return false;
+        }
+        const Word last = Word(values[0] + values[1] - 1);
+        if (set) {
+            mDebugger.addWatchpoint(first, last);
+            return true;
+        }
+        return mDebugger.removeWatchpoint(first, last);
+    }
+    return set ? mDebugger.addCondition(int(values[0]), Word(values[1])) : mDebugger.removeCondition(int(values[0]), Word(values[1]));
+}
+
+std::string DebugServer::getStopReply() const {
+    switch (mDebugger.getStop()) {
+        case Debugger::Stop::None: return "S00";
+        case Debugger::Stop::Interrupt: return "S02";
+        case Debugger::Stop::Watchpoint: {
+            std::string reply = "T05watch:";
+            const Word address = mDebugger.getStopAddress();
+            appendHex(reply, address >> 8, 1);
+            appendHex(reply, address & 0xFF, 1);
+            return reply + ";";
+        }
+        default: return "S05";
+    }
+}
+
+void DebugServer::send(const std::string& reply) {
+#if CHIP8_DEBUG_SOCKET
+    const std::string packet = "$" + reply + "#" + checksum(reply);
+    size_t sent = 0;
+    while (mClient >= 0 && sent < packet.size()) {
+        const ssize_t written = ::send(mClient, packet.data() + sent, packet.size() - sent, MSG_NOSIGNAL);
+        if (written <= 0) {
+            disconnect();
+            return;
+        }
+        sent += written;
+    }
+#else
+    (void)reply;
+#endif
+}
+
+void DebugServer::disconnect() {
+    // Without a client nothing may stay stopped, the machine returns to its backend
+    if (mClient >= 0) {
+#if CHIP8_DEBUG_SOCKET
+        close(mClient);
+#endif
+        mClient = -1;
+    }
+    mInput.clear();
+    mRunning = false;
+    mDebugger.clear();
+    if (mDebugger.isStopped()) {
+        mDebugger.resume();
+    }
+}
@@ -0,0 +1,100 @@
+#include "disassembler.hpp"
+
+#include <iomanip>
+#include <sstream>
+
+static std::string hex(const unsigned value, const int digits) {
+    std::ostringstream os;
+    os << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+    return os.str();
+}
+
+std::string disassemble(const Word operationCode) {
+    const std::string X = {'V', "0123456789ABCDEF"[(operationCode & 0x0F00) >> 8]};
+    const std::string Y = {'V', "0123456789ABCDEF"[(operationCode & 0x00F0) >> 4]};
+    const std::string NNN = hex(operationCode & 0x0FFF, 3);
+    const std::string NN = hex(operationCode & 0x00FF, 2);
+    const std::string N = std::to_string(operationCode & 0x000F);
+
+    switch (operationCode & 0xF000) {
+        case 0x0000:
+            switch (operationCode) {
+                case 0x00E0: return "CLS";
+                case 0x00EE: return "RET";
+                case 0x00FB: return "SCR";
+                case 0x00FC: return "SCL";
+                case 0x00FD: return "EXIT";
+                case 0x00FE: return "LOW";
+                case 0x00FF: return "HIGH";
+            }
+            switch (operationCode & 0xFFF0) {
+                case 0x00C0: return "SCD " + N;
+                case 0x00D0: return "SCU " + N;
+            }
+            return "SYS " + NNN;
+        case 0x1000: return "JP " + NNN;
+        case 0x2000: return "CALL " + NNN;
+        case 0x3000: return "SE " + X + ", " + NN;
+        case 0x4000: return "SNE " + X + ", " + NN;
+        case 0x5000:
+            switch (operationCode & 0x000F) {
+                case 0x0000: return "SE " + X + ", " + Y;
+                case 0x0002: return "LD [I], " + X + " - " + Y;
+                case 0x0003: return "LD " + X + " - " + Y + ", [I]";
+            }
+            break;
+        case 0x6000: return "LD " + X + ", " + NN;
+        case 0x7000: return "ADD " + X + ", " + NN;
+        case 0x8000:
+            switch (operationCode & 0x000F) {
+                case 0x0000: return "LD " + X + ", " + Y;
+                case 0x0001: return "OR " + X + ", " + Y;
+                case 0x0002: return "AND " + X + ", " + Y;
+                case 0x0003: return "XOR " + X + ", " + Y;
+                case 0x0004: return "ADD " + X + ", " + Y;
+                case 0x0005: return "SUB " + X + ", " + Y;
+                case 0x0006: return "SHR " + X;
+                case 0x0007: return "SUBN " + X + ", " + Y;
+                case 0x000E: return "SHL " + X;
+            }
+            break;
+        case 0x9000:
+            if ((operationCode & 0x000F) == 0) {
+                return "SNE " + X + ", " + Y;
+            }
+            break;
+        case 0xA000: return "LD I, " + NNN;
+        case 0xB000: return "JP V0, " + NNN;
+        case 0xC000: return "RND " + X + ", " + NN;
+        case 0xD000: return "DRW " + X + ", " + Y + ", " + N;
+        case 0xE000:
+            switch (operationCode & 0x00FF) {
+                case 0x009E: return "SKP " + X;
+                case 0x00A1: return "SKNP " + X;
+            }
+            break;
+        case 0xF000:
+            switch (operationCode) {
+                case 0xF000: return "LD I, LONG";
+                case 0xF002: return "LD AUDIO, [I]";
+            }
+            switch (operationCode & 0x00FF) {
+                case 0x0001: return "PLANE " + std::to_string((operationCode & 0x0F00) >> 8);
+                case 0x0007: return "LD " + X + ", DT";
+                case 0x000A: return "LD " + X + ", K";
+                case 0x0015: return "LD DT, " + X;
+                case 0x0018: return "LD ST, " + X;
+                case 0x001E: return "ADD I, " + X;
+                case 0x0029: return "LD F, " + X;
+                case 0x0030: return "LD HF, " + X;
+                case 0x003A: return "PITCH " + X;
+                case 0x0033: return "LD B, " + X;
+                case 0x0055: return "LD [I], " + X;
+                case 0x0065: return "LD " + X + ", [I]";
+                case 0x0075: return "LD R, " + X;
+                case 0x0085: return "LD " + X + ", R";
+            }
+            break;
+    }
+    return "DW " + hex(operationCode, 4);
+}
@@ -2,13 +2,32 @@
 #include "KEYMAP.hpp"
 
 #include <SDL_events.h>
+#include <algorithm>
+#include <bit>
 #include <cstdint>
 #include <iostream>
 #include <array>
 
-Game::Game(const std::string& title) :
-mIsRunning(false), mWidth(640), mHeight(320) 
+// The texture has the size of the high resolution, a low resolution pixel covers 2x2 texels
+static constexpr int TEXTURE_WIDTH = 128;
+static constexpr int TEXTURE_HEIGHT = 64;
+
+Game::Game(const std::string& title, const int scale, const bool vsync) :
+mIsRunning(false), mIsRewinding(false), mHasVsync(false), mScale(scale), mWidth(64 * scale), mHeight(32 * scale), mAudioDevice(0)
 {
+    mPalette = {
+        0xFF000000,                     // Black (ARGB: 255, 0, 0, 0)
+        0xFFFFFFFF,                     // White, the first plane (ARGB: 255, 255, 255, 255)
+        0xFF555555,                     // Dark gray, the second plane
+        0xFFAAAAAA,                     // Light gray, both planes
+    };
+    for (int byte = 0; byte < 256; byte++) {
+        for (int bit = 0; bit < 8; bit++) {
+            mExpansion[byte][bit] = mPalette[(byte >> (7 - bit)) & 1];
+        }
+    }
+
+
     mWindowP = SDL_CreateWindow(title.c_str(), SDL_WINDOWPOS_CENTERED, SDL_WINDOWPOS_CENTERED, mWidth, mHeight, SDL_WINDOW_SHOWN);
     if (mWindowP == NULL) {
         std::cout << "Window could not be created, SDL_Error: " << SDL_GetError() << std::endl;
@@ -16,7 +35,14 @@ mIsRunning(false), mWidth(640), mHeight(320)
         return;
     } 
 
-    mRendererP = SDL_CreateRenderer(mWindowP, -1, SDL_RENDERER_SOFTWARE);
+    // Vsync needs an accelerated renderer, the software renderer is the fallback
+    mRendererP = vsync ? SDL_CreateRenderer(mWindowP, -1, SDL_RENDERER_ACCELERATED | SDL_RENDERER_PRESENTVSYNC) : NULL;
+    if (mRendererP == NULL) {
+        if (vsync) {
+            std::cout << "Vsync renderer could not be created, SDL_Error: " << SDL_GetError() << std::endl;
+        }
+        mRendererP = SDL_CreateRenderer(mWindowP, -1, SDL_RENDERER_SOFTWARE);
+    }
     if (mRendererP == NULL) {
         std::cout << "Renderer could not be created, SDL_Error: " << SDL_GetError() << std::endl;
         SDL_DestroyWindow(mWindowP);
@@ -24,17 +50,25 @@ mIsRunning(false), mWidth(640), mHeight(320)
         return;
     }
 
-    mTextureP = SDL_CreateTexture(mRendererP, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, mWidth, mHeight);
+    // Scaled to the window by SDL_RenderCopy
+    mTextureP = SDL_CreateTexture(mRendererP, SDL_PIXELFORMAT_ARGB8888, SDL_TEXTUREACCESS_STREAMING, TEXTURE_WIDTH, TEXTURE_HEIGHT);
     if (mTextureP == NULL) {
         std::cout << "Texture could not be created, SDL_Error: " << SDL_GetError() << std::endl;
         SDL_DestroyWindow(mWindowP);
         SDL_Quit();
         return;
     }
+
+    SDL_RendererInfo info;
+    mHasVsync = SDL_GetRendererInfo(mRendererP, &info) == 0 && (info.flags & SDL_RENDERER_PRESENTVSYNC) != 0;
     mIsRunning = true;
 }
 
 Game::~Game() {
+    if (mAudioDevice != 0) {
+        SDL_CloseAudioDevice(mAudioDevice);
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+    }
     SDL_DestroyRenderer(mRendererP);
     SDL_DestroyWindow(mWindowP);
     SDL_DestroyTexture(mTextureP);
@@ -44,53 +78,136 @@ Game::~Game() {
 
 void Game::handleEvents(std::array<bool, 16>& keyState) {
     SDL_Event event;
-    SDL_PollEvent(&event);
-    
+    while (SDL_PollEvent(&event)) {
+        handleEvent(event, keyState);
+    }
+}
+
+void Game::waitEvents(std::array<bool, 16>& keyState, const int timeoutMs) {
+    SDL_Event event;
+    if (SDL_WaitEventTimeout(&event, timeoutMs)) {
+        handleEvent(event, keyState);
+        handleEvents(keyState);
+    }
+}
+
+void Game::handleEvent(const SDL_Event& event, std::array<bool, 16>& keyState) {
     if (event.type == SDL_QUIT) {
         mIsRunning = false;
     }
-    if (event.type == SDL_KEYDOWN) {
-        for (const auto & [keyCode, button] : KEYMAP) {
-            if (event.key.keysym.sym == keyCode) {
-                keyState[button] = true;
-            }
+    if (event.type == SDL_KEYDOWN || event.type == SDL_KEYUP) {
+        const bool pressed = event.type == SDL_KEYDOWN;
+        const SDL_Keycode keyCode = event.key.keysym.sym;
+        if (keyCode == REWIND_KEY) {
+            mIsRewinding = pressed;
         }
-    }
-    if (event.type == SDL_KEYUP) {
-        for (const auto & [keyCode, button] : KEYMAP) {
-            if (event.key.keysym.sym == keyCode) {
-                keyState[button] = false;
-            }
+        if (keyCode >= 0 && keyCode < KEY_LOOKUP_SIZE && KEY_LOOKUP[keyCode] >= 0) {
+            keyState[KEY_LOOKUP[keyCode]] = pressed;
         }
     }
 }
 
-void Game::drawScreen(const std::array<uint8_t, 64 * 32>& screenState) {
-    int sdl2X;
-    int sdl2Y;
-    int chip8Col;    
-    int chip8Row; 
-    std::array<uint32_t, 640 * 320> sdl2Pixels;
-    
-    for (int pixel = 0; pixel < 640 * 320; pixel++) {
-        sdl2X = pixel % mWidth;
-        sdl2Y = pixel / mWidth;
-        chip8Col = sdl2X / 10;    
-        chip8Row = sdl2Y / 10;
-        if (screenState[chip8Col + (chip8Row * 64)] != 0) {
-            sdl2Pixels[sdl2X + (sdl2Y * mWidth)] = 0xFFFFFFFF; // White (ARGB: 255, 255, 255, 255)
-        } 
-        else {
-            sdl2Pixels[sdl2X + (sdl2Y * mWidth)] = 0xFF000000; // Black (ARGB: 255, 0, 0, 0)
-        }
+void Game::drawScreen(const Chip8::Graphix& screenState, const bool highResolution, const uint64_t dirtyRows) {
+    // Each run of consecutive dirty rows is locked and rewritten as one rectangle
+    const int height = highResolution ? 64 : 32;
+    uint64_t rows = highResolution ? dirtyRows : dirtyRows & 0xFFFFFFFF;
+    while (rows != 0) {
+        int first = std::countr_zero(rows);
+        int last = first + std::countr_one(rows >> first) - 1;
+        drawRows(screenState, highResolution, first, last);
+
+        rows &= last == height - 1 ? 0 : ~uint64_t(0) << (last + 1);
     }
+}
 
-    SDL_UpdateTexture(mTextureP, NULL, sdl2Pixels.data(), mWidth * sizeof(uint32_t));
+void Game::present() {
     SDL_RenderClear(mRendererP);
     SDL_RenderCopy(mRendererP, mTextureP, NULL, NULL);
     SDL_RenderPresent(mRendererP);
 }
 
+void Game::drawRows(const Chip8::Graphix& screenState, const bool highResolution, const int first, const int last) {
+    const int texels = highResolution ? 1 : 2;      // Texels per side of a chip8 pixel
+    const int rowWords = highResolution ? 2 : 1;
+    SDL_Rect rect = {0, first * texels, TEXTURE_WIDTH, (last - first + 1) * texels};
+    void* pixels;
+    int pitch;
+
+    if (SDL_LockTexture(mTextureP, &rect, &pixels, &pitch) != 0) {
+        std::cout << "Texture could not be locked, SDL_Error: " << SDL_GetError() << std::endl;
+        return;
+    }
+
+    for (int chip8Row = first; chip8Row <= last; chip8Row++) {
+        uint32_t* line = reinterpret_cast<uint32_t*>(static_cast<uint8_t*>(pixels) + (chip8Row - first) * texels * pitch);
+        uint32_t* sdl2Pixel = line;
+
+        for (int word = chip8Row * rowWords; word < (chip8Row + 1) * rowWords; word++) {
+            const uint64_t firstPlane = screenState[word];
+            const uint64_t secondPlane = screenState[Chip8::PLANE_WORDS + word];
+
+            // Words without the second plane are expanded a byte at a time
+            if (secondPlane == 0) {
+                for (int byte = 7; byte >= 0; byte--) {
+                    for (const auto & color : mExpansion[(firstPlane >> (byte * 8)) & 0xFF]) {
+                        sdl2Pixel = std::fill_n(sdl2Pixel, texels, color);
+                    }
+                }
+                continue;
+            }
+            for (int bit = 63; bit >= 0; bit--) {
+                const uint32_t color = mPalette[((firstPlane >> bit) & 1) | ((secondPlane >> bit) & 1) << 1];
+                sdl2Pixel = std::fill_n(sdl2Pixel, texels, color);
+            }
+        }
+
+        // A low resolution row covers two lines of the texture
+        if (texels == 2) {
+            std::copy_n(line, TEXTURE_WIDTH, reinterpret_cast<uint32_t*>(reinterpret_cast<uint8_t*>(line) + pitch));
+        }
+    }
+
+    SDL_UnlockTexture(mTextureP);
+}
+
+bool Game::startAudio(Beeper& beeper) {
+    if (SDL_InitSubSystem(SDL_INIT_AUDIO) != 0) {
+        std::cout << "Audio could not be initialized, SDL_Error: " << SDL_GetError() << std::endl;
+        return false;
+    }
+
+    SDL_AudioSpec desired{};
+    desired.freq = AUDIO_SAMPLE_RATE;
+    desired.format = AUDIO_S16SYS;
+    desired.channels = 1;
+    desired.samples = 512;              // About 11 ms per callback
+    desired.callback = renderAudio;
+    desired.userdata = &beeper;
+
+    // SDL converts if the device wants another format
+    mAudioDevice = SDL_OpenAudioDevice(NULL, 0, &desired, NULL, 0);
+    if (mAudioDevice == 0) {
+        std::cout << "Audio device could not be opened, SDL_Error: " << SDL_GetError() << std::endl;
+        SDL_QuitSubSystem(SDL_INIT_AUDIO);
+        return false;
+    }
+    SDL_PauseAudioDevice(mAudioDevice, 0);
+    return true;
+}
+
+void Game::renderAudio(void* beeper, Uint8* stream, int length) {
+    // Runs on the SDL audio thread
+    static_cast<Beeper*>(beeper)->render(reinterpret_cast<int16_t*>(stream), length / sizeof(int16_t));
+}
+
 bool Game::isRunning() {
     return mIsRunning;
 }
+
+bool Game::isRewinding() const {
+    return mIsRewinding;
+}
+
+bool Game::hasVsync() const {
+    return mHasVsync;
+}
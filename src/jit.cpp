@@ -0,0 +1,411 @@
+#include "jit.hpp"
+
+#include <algorithm>
+
+#if defined(__x86_64__) && defined(__unix__)
+#define CHIP8_JIT_SUPPORTED 1
+#include <sys/mman.h>
+#include <unistd.h>
+#else
+#define CHIP8_JIT_SUPPORTED 0
+#endif
+
+static constexpr size_t CODE_BUFFER_SIZE = 256 * 1024;
+static constexpr size_t MAX_BLOCK_CODE_SIZE = 4096;
+static constexpr int MAX_BLOCK_INSTRUCTIONS = 64;
+static constexpr int MAX_BLOCK_BYTES = 2 * (MAX_BLOCK_INSTRUCTIONS + 1);
+
+Jit::Jit() :
+mQuirks(LEGACY_QUIRKS), mCodePages(0), mCode(nullptr), mCodeSize(0), mCodeUsed(0)
+{
+}
+
+Jit::~Jit() {
+#if CHIP8_JIT_SUPPORTED
+    if (mCode != nullptr) {
+        munmap(mCode, mCodeSize);
+    }
+#endif
+}
+
+Jit::Jit(const Jit& other) : Jit() {
+    mQuirks = other.mQuirks;
+}
+
+Jit& Jit::operator=(const Jit& other) {
+    mQuirks = other.mQuirks;
+    flush();
+    return *this;
+}
+
+bool Jit::isAvailable() const {
+    return CHIP8_JIT_SUPPORTED;
+}
+
+void Jit::setQuirks(const Quirks& quirks) {
+    mQuirks = quirks;
+    flush();
+}
+
+const Jit::Block* Jit::lookup(const Byte* memory, const Word address) {
+#if CHIP8_JIT_SUPPORTED
+    if (mEntries == nullptr) {
+        // Never writable and executable at once, compile makes the pages it emits into writable meanwhile
+        void* code = mmap(nullptr, CODE_BUFFER_SIZE, PROT_READ | PROT_EXEC, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+        if (code == MAP_FAILED) {
+            return nullptr;
+        }
+        mCode = static_cast<Byte*>(code);
+        mCodeSize = CODE_BUFFER_SIZE;
+        mEntries = std::make_unique<Entry[]>(MEMORY_SIZE);
+        flush();
+    }
+
+    Entry& entry = mEntries[address];
+    if (!entry.translated) {
+        if (mCodeSize - mCodeUsed < MAX_BLOCK_CODE_SIZE) {
+            flush();
+        }
+        entry.translated = true;
+        const size_t first = mCodeUsed;
+        if (!protect(first, true)) {
+            entry.block.code = nullptr;
+            return nullptr;
+        }
+        if (!compile(memory, address, entry.block)) {
+            entry.block.code = nullptr;
+        }
+        if (!protect(first, false)) {
+            entry.block.code = nullptr;
+        }
+    }
+    return entry.block.code != nullptr ? &entry.block : nullptr;
+#else
+    (void)memory;
+    (void)address;
+    return nullptr;
+#endif
+}
+
+void Jit::invalidate(const int first, const int last) {
+    if (mEntries == nullptr) {
+        return;
+    }
+
+    // A failed translation only depends on the instruction at its own address
+    for (int address = std::max(first - 1, 0); address <= std::min(last, MEMORY_SIZE - 1); address++) {
+        mEntries[address].translated = false;
+    }
+
+    bool code = false;
+    for (int page = std::max(first, 0) >> 8; page <= std::min(last, MEMORY_SIZE - 1) >> 8; page++) {
+        code |= (mCodePages >> page) & 1;
+    }
+    if (!code) {
+        return;
+    }
+
+    for (int address = std::max(first - MAX_BLOCK_BYTES, 0); address <= std::min(last, MEMORY_SIZE - 1); address++) {
+        Entry& entry = mEntries[address];
+        if (entry.translated && entry.block.code != nullptr && entry.block.last >= first) {
+            entry.translated = false;
+        }
+    }
+}
+
+void Jit::flush() {
+    if (mEntries != nullptr) {
+        std::fill(mEntries.get(), mEntries.get() + MEMORY_SIZE, Entry{{nullptr, 0, 0}, false});
+    }
+    mCodePages = 0;
+    mCodeUsed = 0;
+}
+
+bool Jit::protect(const size_t first, const bool writable) {
+#if CHIP8_JIT_SUPPORTED
+    // The pages a block starting at first can be emitted into
+    const size_t pageSize = size_t(sysconf(_SC_PAGESIZE));
+    const size_t begin = first / pageSize * pageSize;
+    const size_t end = std::min(first + MAX_BLOCK_CODE_SIZE + pageSize - 1, mCodeSize) / pageSize * pageSize;
+    return mprotect(mCode + begin, end - begin, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) == 0;
+#else
+    (void)first;
+    (void)writable;
+    return false;
+#endif
+}
+
+void Jit::emit(std::initializer_list<Byte> bytes) {
+    for (const auto & byte : bytes) {
+        mCode[mCodeUsed++] = byte;
+    }
+}
+
+void Jit::emit16(const Word value) {
+    emit({Byte(value), Byte(value >> 8)});
+}
+
+void Jit::emit32(const uint32_t value) {
+    emit({Byte(value), Byte(value >> 8), Byte(value >> 16), Byte(value >> 24)});
+}
+
+// Register use inside a block (System V ABI):
+//   rdi    V registry, the registers are accessed as [rdi + X]
+//   rsi    pointer to the index registry
+//   dx     index registry, loaded on entry and stored on exit
+//   eax    next program counter on exit, scratch (al) otherwise
+//   cl     scratch for VF
+bool Jit::compile(const Byte* memory, const Word address, Block& block) {
+    const size_t start = mCodeUsed;
+    Word pc = address;
+    int instructions = 0;
+    bool terminated = false;
+
+    emit({0x0F, 0xB7, 0x16});                                               // movzx edx, word [rsi]
+
+    auto exitTo = [&](const Word target) {
+        emit({0x66, 0x89, 0x16});                                           // mov [rsi], dx
+        emit({0xB8}); emit32(target);                                       // mov eax, target
+        emit({0xC3});                                                       // ret
+    };
+    auto resetFlag = [&]() {
+        if (mQuirks.logicResetsVF) {
+            emit({0xC6, 0x47, 0x0F, 0x00});                                 // mov byte [rdi + 15], 0
+        }
+    };
+    auto exitSkip = [&](const Byte cmov) {
+        emit({0x66, 0x89, 0x16});                                           // mov [rsi], dx
+        emit({0xB8}); emit32(Word(pc + 2));                                 // mov eax, pc + 2
+        emit({0xB9}); emit32(Word(pc + 4));                                 // mov ecx, pc + 4
+        emit({0x0F, cmov, 0xC1});                                           // cmovcc eax, ecx
+        emit({0xC3});                                                       // ret
+    };
+
+    // A skip over XO-CHIP F000 NNNN jumps four bytes, which only the interpreter knows
+    const bool skips = mQuirks.instructionSet != Quirks::InstructionSet::XoChip;
+
+    while (!terminated && instructions < MAX_BLOCK_INSTRUCTIONS && pc + 1 < MEMORY_SIZE) {
+        const Word operationCode = memory[pc] << 8 | memory[pc + 1];
+        const Byte NN = operationCode & 0x00FF;
+        const Byte X = (operationCode & 0x0F00) >> 8;
+        const Byte Y = (operationCode & 0x00F0) >> 4;
+        const Byte S = mQuirks.shiftReadsVY ? Y : X;                        // Register shifted by 8XY6 and 8XYE
+        bool translated = true;
+
+        switch (operationCode & 0xF000) {
+            case 0x1000: // 1NNN
+                // A jump to itself is an idle loop the interpreter fast-forwards
+                if ((operationCode & 0x0FFF) == pc) {
+                    translated = false;
+                    break;
+                }
+                exitTo(operationCode & 0x0FFF);
+                terminated = true;
+                break;
+
+            case 0x3000: // 3XNN
+                if (!skips) {
+                    translated = false;
+                    break;
+                }
+                emit({0x80, 0x7F, X, NN});                                  // cmp byte [rdi + X], NN
+                exitSkip(0x44);                                             // cmove
+                terminated = true;
+                break;
+
+            case 0x4000: // 4XNN
+                if (!skips) {
+                    translated = false;
+                    break;
+                }
+                emit({0x80, 0x7F, X, NN});                                  // cmp byte [rdi + X], NN
+                exitSkip(0x45);                                             // cmovne
+                terminated = true;
+                break;
+
+            case 0x5000: // 5XY0
+            case 0x9000: // 9XY0
+                if (!skips) {
+                    translated = false;
+                    break;
+                }
+                emit({0x8A, 0x47, X});                                      // mov al, [rdi + X]
+                emit({0x3A, 0x47, Y});                                      // cmp al, [rdi + Y]
+                exitSkip((operationCode & 0xF000) == 0x5000 ? 0x44 : 0x45); // cmove / cmovne
+                terminated = true;
+                break;
+
+            case 0x6000: // 6XNN
+                emit({0xC6, 0x47, X, NN});                                  // mov byte [rdi + X], NN
+                break;
+
+            case 0x7000: // 7XNN
+                emit({0x80, 0x47, X, NN});                                  // add byte [rdi + X], NN
+                break;
+
+            case 0x8000:
+                switch (operationCode & 0x000F) {
+                    case 0x0000: // 8XY0
+                        emit({0x8A, 0x47, Y});                              // mov al, [rdi + Y]
+                        emit({0x88, 0x47, X});                              // mov [rdi + X], al
+                        break;
+
+                    case 0x0001: // 8XY1
+                        emit({0x8A, 0x47, Y});                              // mov al, [rdi + Y]
+                        emit({0x08, 0x47, X});                              // or [rdi + X], al
+                        resetFlag();
+                        break;
+
+                    case 0x0002: // 8XY2
+                        emit({0x8A, 0x47, Y});                              // mov al, [rdi + Y]
+                        emit({0x20, 0x47, X});                              // and [rdi + X], al
+                        resetFlag();
+                        break;
+
+                    case 0x0003: // 8XY3
+                        emit({0x8A, 0x47, Y});                              // mov al, [rdi + Y]
+                        emit({0x30, 0x47, X});                              // xor [rdi + X], al
+                        resetFlag();
+                        break;
+
+                    // Without flagWrittenLast VF is written before VX is updated from a fresh read of VY, as the interpreter does
+                    case 0x0004: // 8XY4
+                        emit({0x8A, 0x47, X});                              // mov al, [rdi + X]
+                        emit({0x02, 0x47, Y});                              // add al, [rdi + Y]
+                        emit({0x0F, 0x92, 0xC1});                           // setc cl
+                        if (mQuirks.flagWrittenLast) {
+                            emit({0x88, 0x47, X});                          // mov [rdi + X], al
+                            emit({0x88, 0x4F, 0x0F});                       // mov [rdi + 15], cl
+                            break;
+                        }
+                        emit({0x88, 0x4F, 0x0F});                           // mov [rdi + 15], cl
+                        emit({0x8A, 0x47, Y});                              // mov al, [rdi + Y]
+                        emit({0x00, 0x47, X});                              // add [rdi + X], al
+                        break;
+
+                    case 0x0005: // 8XY5
+                        if (mQuirks.flagWrittenLast) {
+                            emit({0x8A, 0x47, X});                          // mov al, [rdi + X]
+                            emit({0x2A, 0x47, Y});                          // sub al, [rdi + Y]
+                            emit({0x0F, 0x93, 0xC1});                       // setae cl
+                            emit({0x88, 0x47, X});                          // mov [rdi + X], al
+                            emit({0x88, 0x4F, 0x0F});                       // mov [rdi + 15], cl
+                            break;
+                        }
+                        emit({0x8A, 0x47, X});                              // mov al, [rdi + X]
+                        emit({0x3A, 0x47, Y});                              // cmp al, [rdi + Y]
+                        emit({0x0F, 0x93, 0xC1});                           // setae cl
+                        emit({0x88, 0x4F, 0x0F});                           // mov [rdi + 15], cl
+                        emit({0x8A, 0x47, Y});                              // mov al, [rdi + Y]
+                        emit({0x28, 0x47, X});                              // sub [rdi + X], al
+                        break;
+
+                    case 0x0006: // 8XY6
+                        if (mQuirks.flagWrittenLast) {
+                            emit({0x8A, 0x47, S});                          // mov al, [rdi + S]
+                            emit({0x88, 0xC1});                             // mov cl, al
+                            emit({0x80, 0xE1, 0x01});                       // and cl, 1
+                            emit({0xD0, 0xE8});                             // shr al, 1
+                            emit({0x88, 0x47, X});                          // mov [rdi + X], al
+                            emit({0x88, 0x4F, 0x0F});                       // mov [rdi + 15], cl
+                            break;
+                        }
+                        emit({0x8A, 0x47, S});                              // mov al, [rdi + S]
+                        emit({0x24, 0x01});                                 // and al, 1
+                        emit({0x88, 0x47, 0x0F});                           // mov [rdi + 15], al
+                        emit({0x8A, 0x47, S});                              // mov al, [rdi + S]
+                        emit({0xD0, 0xE8});                                 // shr al, 1
+                        emit({0x88, 0x47, X});                              // mov [rdi + X], al
+                        break;
+
+                    case 0x0007: // 8XY7
+                        if (mQuirks.flagWrittenLast) {
+                            emit({0x8A, 0x47, Y});                          // mov al, [rdi + Y]
+                            emit({0x2A, 0x47, X});                          // sub al, [rdi + X]
+                            emit({0x0F, 0x93, 0xC1});                       // setae cl
+                            emit({0x88, 0x47, X});                          // mov [rdi + X], al
+                            emit({0x88, 0x4F, 0x0F});                       // mov [rdi + 15], cl
+                            break;
+                        }
+                        emit({0x8A, 0x47, Y});                              // mov al, [rdi + Y]
+                        emit({0x3A, 0x47, X});                              // cmp al, [rdi + X]
+                        emit({0x0F, 0x93, 0xC1});                           // setae cl
+                        emit({0x88, 0x4F, 0x0F});                           // mov [rdi + 15], cl
+                        emit({0x8A, 0x47, Y});                              // mov al, [rdi + Y]
+                        emit({0x2A, 0x47, X});                              // sub al, [rdi + X]
+                        emit({0x88, 0x47, X});                              // mov [rdi + X], al
+                        break;
+
+                    case 0x000E: // 8XYE
+                        if (mQuirks.flagWrittenLast) {
+                            emit({0x8A, 0x47, S});                          // mov al, [rdi + S]
+                            emit({0x88, 0xC1});                             // mov cl, al
+                            emit({0xC0, 0xE9, 0x07});                       // shr cl, 7
+                            emit({0xD0, 0xE0});                             // shl al, 1
+                            emit({0x88, 0x47, X});                          // mov [rdi + X], al
+                            emit({0x88, 0x4F, 0x0F});                       // mov [rdi + 15], cl
+                            break;
+                        }
+                        emit({0x8A, 0x47, S});                              // mov al, [rdi + S]
+                        emit({0xC0, 0xE8, 0x07});                           // shr al, 7
+                        emit({0x88, 0x47, 0x0F});                           // mov [rdi + 15], al
+                        emit({0x8A, 0x47, S});                              // mov al, [rdi + S]
+                        emit({0xD0, 0xE0});                                 // shl al, 1
+                        emit({0x88, 0x47, X});                              // mov [rdi + X], al
+                        break;
+
+                    default:
+                        translated = false;
+                }
+                break;
+
+            case 0xA000: // ANNN
+                emit({0x66, 0xBA}); emit16(operationCode & 0x0FFF);         // mov dx, NNN
+                break;
+
+            case 0xF000:
+                switch (NN) {
+                    case 0x1E: // FX1E
+                        emit({0x0F, 0xB6, 0x47, X});                        // movzx eax, byte [rdi + X]
+                        emit({0x66, 0x01, 0xC2});                           // add dx, ax
+                        break;
+
+                    case 0x29: // FX29
+                        emit({0x0F, 0xB6, 0x47, X});                        // movzx eax, byte [rdi + X]
+                        emit({0x8D, 0x44, 0x80, 0x50});                     // lea eax, [rax + rax * 4 + 0x50]
+                        emit({0x89, 0xC2});                                 // mov edx, eax
+                        break;
+
+                    default:
+                        translated = false;
+                }
+                break;
+
+            default:
+                translated = false;
+        }
+
+        if (!translated) {
+            break;
+        }
+        instructions++;
+        pc += 2;
+    }
+
+    if (instructions == 0) {
+        mCodeUsed = start;
+        return false;
+    }
+
+    if (!terminated) {
+        exitTo(pc);
+    }
+
+    block.code = reinterpret_cast<Code>(mCode + start);
+    block.instructions = instructions;
+    block.last = std::min(address + 2 * instructions - 1, MEMORY_SIZE - 1);
+    for (int page = address >> 8; page <= block.last >> 8; page++) {
+        mCodePages |= 1 << page;
+    }
+    return true;
+}
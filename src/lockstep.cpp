@@ -0,0 +1,533 @@
+#include "lockstep.hpp"
+#include "FONTSET.hpp"
+
+#include <algorithm>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+bool Lockstep::loadGame(const std::string& gameFilepath, const uint64_t ticksPerSecond, const std::array<uint64_t, LANES>& seeds) {
+    const std::shared_ptr<const Rom> rom = Rom::open(gameFilepath);
+    return rom != nullptr && loadGame(*rom, ticksPerSecond, seeds);
+}
+
+bool Lockstep::loadGame(const Rom& rom, const uint64_t ticksPerSecond, const std::array<uint64_t, LANES>& seeds) {
+    if (rom.getSize() > 4096 - 0x200) {
+        return false;
+    }
+
+    for (auto & V : mV) {
+        V.fill(0);
+    }
+    mProgramCounter.fill(0x200);
+    mIndexRegistry.fill(0);
+    mDelayTimer.fill(0);
+    mSoundTimer.fill(0);
+    mStackP.fill(0);
+    mCycleCount.fill(0);
+    mTimerAccumulator.fill(0);
+    mRemaining.fill(0);
+    mWrittenFirst = 0xFFFF;
+    mWrittenLast = 0;
+
+    for (int lane = 0; lane < LANES; lane++) {
+        mStack[lane].fill(0);
+        mKeys[lane].fill(false);
+        mGraphix[lane].fill(0);
+        mRandom[lane] = RandomEngine(seeds[lane]);
+
+        std::array<Byte, 4096>& memory = mMemory[lane];
+        memory.fill(0);
+        std::copy(FONTSET.begin(), FONTSET.end(), memory.begin() + 0x50);
+        std::copy_n(rom.getData(), rom.getSize(), memory.begin() + 0x200);
+    }
+
+    mTicksPerSecond = std::max<uint64_t>(ticksPerSecond, 1);
+    mFrameAccumulator = 0;
+    return true;
+}
+
+void Lockstep::runCycles(const uint64_t cycles) {
+    Mask running = cycles > 0 ? ALL_LANES : 0;
+    mRemaining.fill(cycles);
+
+    // Timers tick at 60 Hz of emulated time per lane, as in Chip8::tickCycles. Ticking steps cycles at once
+    // decrements the timers as often as ticking them one by one.
+    auto tick = [&](const Mask lanes, const uint64_t steps) {
+        if (lanes == 0 || steps == 0) {
+            return;
+        }
+        for (int lane = 0; lane < LANES; lane++) {
+            if (((lanes >> lane) & 1) == 0) {
+                continue;
+            }
+
+            mCycleCount[lane] += steps;
+            mTimerAccumulator[lane] += 60 * steps;
+            while (mTimerAccumulator[lane] >= mTicksPerSecond) {
+                mTimerAccumulator[lane] -= mTicksPerSecond;
+                if (mDelayTimer[lane] > 0) {
+                    --mDelayTimer[lane];
+                }
+                if (mSoundTimer[lane] > 0) {
+                    --mSoundTimer[lane];
+                }
+            }
+
+            mRemaining[lane] -= steps;
+            if (mRemaining[lane] == 0) {
+                running &= ~(1u << lane);
+            }
+        }
+    };
+
+    while (running != 0) {
+        // The lane furthest behind leads, lanes at the same program counter with the same instruction follow
+        int leader = 0;
+        for (int lane = 1; lane < LANES; lane++) {
+            if (mRemaining[lane] > mRemaining[leader]) {
+                leader = lane;
+            }
+        }
+        Mask group = matchingLanes(leader, running);
+        uint64_t budget = mRemaining[leader];
+        for (int lane = 0; lane < LANES; lane++) {
+            if (((group >> lane) & 1) != 0) {
+                budget = std::min(budget, mRemaining[lane]);
+            }
+        }
+
+        // The group runs on together until its lanes branch apart or one of them has no cycles left.
+        // Its program counters stay equal and memory only differs between lanes where FX33 and FX55 wrote,
+        // so instructions are only compared again there and lanes only checked again after branches.
+        uint64_t pending = 0;           // Steps of the group not yet ticked
+        for (uint64_t step = 0; step < budget; step++) {
+            const Word pc = mProgramCounter[leader] & 0x0FFF;
+            if (step > 0 && pc + 1 >= mWrittenFirst && pc <= mWrittenLast) {
+                const Mask same = matchingLanes(leader, group);
+                tick(group & ~same, pending);
+                group = same;
+            }
+            const Word operationCode = mMemory[leader][pc] << 8 | mMemory[leader][(pc + 1) & 0x0FFF];
+
+            // FX07, FX15 and FX18 see the ticks of every instruction before them
+            if ((operationCode & 0xF000) == 0xF000) {
+                tick(group, pending);
+                pending = 0;
+            }
+            execute(operationCode, group);
+            pending++;
+
+            if (mayBranch(operationCode)) {
+                const Word next = mProgramCounter[leader];
+                Mask same = 0;
+                for (int lane = 0; lane < LANES; lane++) {
+                    if (((group >> lane) & 1) != 0 && mProgramCounter[lane] == next) {
+                        same |= 1u << lane;
+                    }
+                }
+                tick(group & ~same, pending);
+                group = same;
+            }
+        }
+        tick(group, pending);
+    }
+}
+
+Lockstep::Mask Lockstep::matchingLanes(const int leader, const Mask lanes) const {
+    const Word pc = mProgramCounter[leader] & 0x0FFF;
+    const Byte high = mMemory[leader][pc];
+    const Byte low = mMemory[leader][(pc + 1) & 0x0FFF];
+
+    Mask mask = 0;
+    for (int lane = 0; lane < LANES; lane++) {
+        if (((lanes >> lane) & 1) != 0 && mProgramCounter[lane] == mProgramCounter[leader]
+            && mMemory[lane][pc] == high && mMemory[lane][(pc + 1) & 0x0FFF] == low) {
+            mask |= 1u << lane;
+        }
+    }
+    return mask;
+}
+
+bool Lockstep::mayBranch(const Word operationCode) {
+    // Skips, computed jumps, returns and FX0A move the program counters of lanes apart
+    switch (operationCode & 0xF000) {
+        case 0x0000: return operationCode == 0x00EE;
+        case 0x3000:
+        case 0x4000:
+        case 0x5000:
+        case 0x9000:
+        case 0xB000:
+        case 0xE000: return true;
+        case 0xF000: return (operationCode & 0x00FF) == 0x000A;
+        default: return false;
+    }
+}
+
+void Lockstep::runFrame() {
+    mFrameAccumulator += mTicksPerSecond;
+    uint64_t cycles = mFrameAccumulator / 60;
+    mFrameAccumulator %= 60;
+
+    runCycles(cycles);
+}
+
+void Lockstep::execute(const Word operationCode, const Mask mask) {
+    if (executeVector(operationCode, mask)) {
+        return;
+    }
+
+    for (int lane = 0; lane < LANES; lane++) {
+        if (((mask >> lane) & 1) != 0) {
+            executeLane(operationCode, lane);
+        }
+    }
+}
+
+bool Lockstep::executeVector(const Word operationCode, const Mask mask) {
+#ifdef __SSE2__
+    const Byte NN = operationCode & 0x00FF;
+    const Byte X = (operationCode & 0x0F00) >> 8;
+    const Byte Y = (operationCode & 0x00F0) >> 4;
+
+    // 0xFF in the bytes of the lanes that execute, bit lane % 8 of the mask byte of the lane selected and compared
+    const __m128i laneBits = _mm_set1_epi64x(0x8040201008040201);
+    const __m128i maskBytes = _mm_set_epi8(
+        char(mask >> 8), char(mask >> 8), char(mask >> 8), char(mask >> 8), char(mask >> 8), char(mask >> 8), char(mask >> 8), char(mask >> 8),
+        char(mask), char(mask), char(mask), char(mask), char(mask), char(mask), char(mask), char(mask));
+    const __m128i lanes = _mm_cmpeq_epi8(_mm_and_si128(maskBytes, laneBits), laneBits);
+    const __m128i one = _mm_set1_epi8(1);
+
+    auto load = [&](const Byte reg) {
+        return _mm_load_si128(reinterpret_cast<const __m128i*>(mV[reg].data()));
+    };
+    auto store = [&](const Byte reg, const __m128i value) {
+        __m128i old = load(reg);
+        _mm_store_si128(reinterpret_cast<__m128i*>(mV[reg].data()), _mm_or_si128(_mm_and_si128(lanes, value), _mm_andnot_si128(lanes, old)));
+    };
+
+    // VF is written before VX is updated from fresh reads, as the interpreter does when X or Y is F
+    switch (operationCode & 0xF000) {
+        case 0x6000: // 6XNN
+            store(X, _mm_set1_epi8(NN));
+            break;
+
+        case 0x7000: // 7XNN
+            store(X, _mm_add_epi8(load(X), _mm_set1_epi8(NN)));
+            break;
+
+        case 0x8000:
+            switch (operationCode & 0x000F) {
+                case 0x0000: // 8XY0
+                    store(X, load(Y));
+                    break;
+
+                case 0x0001: // 8XY1
+                    store(X, _mm_or_si128(load(X), load(Y)));
+                    break;
+
+                case 0x0002: // 8XY2
+                    store(X, _mm_and_si128(load(X), load(Y)));
+                    break;
+
+                case 0x0003: // 8XY3
+                    store(X, _mm_xor_si128(load(X), load(Y)));
+                    break;
+
+                case 0x0004: { // 8XY4: carry when the saturated sum differs from the wrapped sum
+                    __m128i saturated = _mm_adds_epu8(load(X), load(Y));
+                    __m128i wrapped = _mm_add_epi8(load(X), load(Y));
+                    store(0xF, _mm_andnot_si128(_mm_cmpeq_epi8(saturated, wrapped), one));
+                    store(X, _mm_add_epi8(load(X), load(Y)));
+                    break;
+                }
+
+                case 0x0005: // 8XY5: VX >= VY when max(VX, VY) == VX
+                    store(0xF, _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(load(X), load(Y)), load(X)), one));
+                    store(X, _mm_sub_epi8(load(X), load(Y)));
+                    break;
+
+                case 0x0006: // 8XY6
+                    store(0xF, _mm_and_si128(load(X), one));
+                    store(X, _mm_and_si128(_mm_srli_epi16(load(X), 1), _mm_set1_epi8(0x7F)));
+                    break;
+
+                case 0x0007: // 8XY7
+                    store(0xF, _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(load(Y), load(X)), load(Y)), one));
+                    store(X, _mm_sub_epi8(load(Y), load(X)));
+                    break;
+
+                case 0x000E: // 8XYE
+                    store(0xF, _mm_and_si128(_mm_srli_epi16(load(X), 7), one));
+                    store(X, _mm_add_epi8(load(X), load(X)));
+                    break;
+
+                default:
+                    return false;
+            }
+            break;
+
+        default:
+            return false;
+    }
+
+    // Words of the lanes that execute are 0xFFFF, so subtracting them adds 1 twice
+    __m128i* pcs = reinterpret_cast<__m128i*>(mProgramCounter.data());
+    const __m128i low = _mm_unpacklo_epi8(lanes, lanes);
+    const __m128i high = _mm_unpackhi_epi8(lanes, lanes);
+    _mm_storeu_si128(pcs, _mm_sub_epi16(_mm_sub_epi16(_mm_loadu_si128(pcs), low), low));
+    _mm_storeu_si128(pcs + 1, _mm_sub_epi16(_mm_sub_epi16(_mm_loadu_si128(pcs + 1), high), high));
+    return true;
+#else
+    (void)operationCode;
+    (void)mask;
+    return false;
+#endif
+}
+
+void Lockstep::executeLane(const Word operationCode, const int lane) {
+    const Word NNN = operationCode & 0x0FFF;
+    const Byte NN = operationCode & 0x00FF;
+    const Byte X = (operationCode & 0x0F00) >> 8;
+    const Byte Y = (operationCode & 0x00F0) >> 4;
+
+    Word& pc = mProgramCounter[lane];
+    Word& I = mIndexRegistry[lane];
+    std::array<Byte, 4096>& memory = mMemory[lane];
+    auto V = [&](const Byte reg) -> Byte& {
+        return mV[reg][lane];
+    };
+
+    switch (operationCode & 0xF000) {
+        case 0x0000:
+            switch (NN) {
+                case 0x00E0: // 00E0
+                    mGraphix[lane].fill(0);
+                    pc += 2;
+                    break;
+
+                case 0x00EE: // 00EE
+                    pc = mStack[lane][--mStackP[lane]] + 2;
+                    break;
+            }
+            break;
+
+        case 0x1000: // 1NNN
+            pc = NNN;
+            break;
+
+        case 0x2000: // 2NNN
+            mStack[lane][mStackP[lane]++] = pc;
+            pc = NNN;
+            break;
+
+        case 0x3000: // 3XNN
+            pc += V(X) == NN ? 4 : 2;
+            break;
+
+        case 0x4000: // 4XNN
+            pc += V(X) != NN ? 4 : 2;
+            break;
+
+        case 0x5000: // 5XY0
+            pc += V(X) == V(Y) ? 4 : 2;
+            break;
+
+        case 0x6000: // 6XNN
+            V(X) = NN;
+            pc += 2;
+            break;
+
+        case 0x7000: // 7XNN
+            V(X) += NN;
+            pc += 2;
+            break;
+
+        case 0x8000:
+            switch (operationCode & 0x000F) {
+                case 0x0000: V(X) = V(Y); break;
+                case 0x0001: V(X) |= V(Y); break;
+                case 0x0002: V(X) &= V(Y); break;
+                case 0x0003: V(X) ^= V(Y); break;
+                case 0x0004: V(0xF) = Word(V(X) + V(Y)) > 0x00FF ? 1 : 0; V(X) += V(Y); break;
+                case 0x0005: V(0xF) = V(X) >= V(Y) ? 1 : 0; V(X) = V(X) - V(Y); break;
+                case 0x0006: V(0xF) = V(X) & 0x0001; V(X) >>= 1; break;
+                case 0x0007: V(0xF) = V(Y) >= V(X) ? 1 : 0; V(X) = V(Y) - V(X); break;
+                case 0x000E: V(0xF) = V(X) >> 7; V(X) <<= 1; break;
+                default: return;
+            }
+            pc += 2;
+            break;
+
+        case 0x9000: // 9XY0
+            pc += V(X) != V(Y) ? 4 : 2;
+            break;
+
+        case 0xA000: // ANNN
+            I = NNN;
+            pc += 2;
+            break;
+
+        case 0xB000: // BNNN
+            pc = NNN + V(0);
+            break;
+
+        case 0xC000: // CXNN
+            V(X) = NN & (mRandom[lane]() >> (sizeof(RandomEngine::result_type) * 8 - 8));
+            pc += 2;
+            break;
+
+        case 0xD000: // DXYN
+            drawLane(X, Y, operationCode & 0x000F, lane);
+            pc += 2;
+            break;
+
+        case 0xE000:
+            switch (NN) {
+                case 0x009E: pc += mKeys[lane][V(X)] ? 4 : 2; break;
+                case 0x00A1: pc += !mKeys[lane][V(X)] ? 4 : 2; break;
+            }
+            break;
+
+        case 0xF000:
+            switch (NN) {
+                case 0x0007: V(X) = mDelayTimer[lane]; break;
+                case 0x000A:
+                    for (int key = 0; key < 16; key++) {
+                        if (mKeys[lane][key]) {
+                            V(X) = key;
+                            pc += 2;
+                            break;
+                        }
+                    }
+                    return;
+                case 0x0015: mDelayTimer[lane] = V(X); break;
+                case 0x0018: mSoundTimer[lane] = V(X); break;
+                case 0x001E: I += V(X); break;
+                case 0x0029: I = 0x50 + (5 * V(X)); break;
+                case 0x0033:
+                    written(I, 3);
+                    memory[I & 0x0FFF] = V(X) / 100;
+                    memory[(I + 1) & 0x0FFF] = (V(X) / 10) % 10;
+                    memory[(I + 2) & 0x0FFF] = (V(X) % 100) % 10;
+                    break;
+                case 0x0055:
+                    written(I, X + 1);
+                    for (int reg = 0; reg <= X; reg++) {
+                        memory[(I + reg) & 0x0FFF] = V(reg);
+                    }
+                    break;
+                case 0x0065:
+                    for (int reg = 0; reg <= X; reg++) {
+                        V(reg) = memory[(I + reg) & 0x0FFF];
+                    }
+                    break;
+                default:
+                    return;
+            }
+            pc += 2;
+            break;
+    }
+}
+
+void Lockstep::written(const Word address, const int count) {
+    // Stores wrapping around the end of memory mark all of it
+    const Word first = address & 0x0FFF;
+    const bool wraps = first + count - 1 > 0x0FFF;
+    mWrittenFirst = std::min<Word>(mWrittenFirst, wraps ? 0 : first);
+    mWrittenLast = std::max<Word>(mWrittenLast, wraps ? 0x0FFF : first + count - 1);
+}
+
+void Lockstep::drawLane(const Byte X, const Byte Y, const Byte N, const int lane) {
+    std::array<uint64_t, 32>& graphix = mGraphix[lane];
+    const std::array<Byte, 4096>& memory = mMemory[lane];
+    const Word I = mIndexRegistry[lane];
+    auto V = [&](const Byte reg) -> Byte& {
+        return mV[reg][lane];
+    };
+
+    // Same 2048 pixel line wrap as Chip8::opDXYN, including the position changing while VF is written
+    if (X == 0xF || Y == 0xF) {
+        V(0xF) = 0;
+        for (int row = 0; row < N; row++) {
+            for (int bit = 0; bit < 8; bit++) {
+                Word index = ((V(X) + bit) + (V(Y) + row) * 64) % 2048;
+                if ((memory[(I + row) & 0x0FFF] & (0b10000000 >> bit)) != 0) {
+                    uint64_t pixel = uint64_t(1) << (63 - (index & 63));
+                    if ((graphix[index >> 6] & pixel) != 0) {
+                        V(0xF) = 1;
+                    }
+                    graphix[index >> 6] ^= pixel;
+                }
+            }
+        }
+        return;
+    }
+
+    uint64_t collision = 0;
+    for (int row = 0; row < N; row++) {
+        const uint64_t sprite = memory[(I + row) & 0x0FFF];
+        const Word index = (V(X) + (V(Y) + row) * 64) % 2048;
+        const int column = index & 63;
+
+        const uint64_t bits = (sprite << 56) >> column;
+        collision |= graphix[index >> 6] & bits;
+        graphix[index >> 6] ^= bits;
+
+        if (column > 56) {
+            const uint64_t spill = sprite << (120 - column);
+            collision |= graphix[((index >> 6) + 1) & 31] & spill;
+            graphix[((index >> 6) + 1) & 31] ^= spill;
+        }
+    }
+    V(0xF) = collision != 0 ? 1 : 0;
+}
+
+void Lockstep::setKeys(const int lane, const std::array<bool, 16>& keyState) {
+    mKeys[lane] = keyState;
+}
+
+const std::array<Byte, 4096>& Lockstep::getMemory(const int lane) const {
+    return mMemory[lane];
+}
+
+const std::array<uint64_t, 32>& Lockstep::getGraphix(const int lane) const {
+    return mGraphix[lane];
+}
+
+Word Lockstep::getProgramCounter(const int lane) const {
+    return mProgramCounter[lane];
+}
+
+Word Lockstep::getIndexRegistry(const int lane) const {
+    return mIndexRegistry[lane];
+}
+
+std::array<Byte, 16> Lockstep::getVReg(const int lane) const {
+    std::array<Byte, 16> V;
+    for (int reg = 0; reg < 16; reg++) {
+        V[reg] = mV[reg][lane];
+    }
+    return V;
+}
+
+Byte Lockstep::getDelayTimer(const int lane) const {
+    return mDelayTimer[lane];
+}
+
+Byte Lockstep::getSoundTimer(const int lane) const {
+    return mSoundTimer[lane];
+}
+
+const std::array<Word, 16>& Lockstep::getStack(const int lane) const {
+    return mStack[lane];
+}
+
+Word Lockstep::getStackP(const int lane) const {
+    return mStackP[lane];
+}
+
+uint64_t Lockstep::getCycleCount(const int lane) const {
+    return mCycleCount[lane];
+}
@@ -2,93 +2,577 @@
 
 #include <SDL.h>
 #include <chip8.hpp>
+#include <debugger.hpp>
+#include <debugserver.hpp>
+#include <movie.hpp>
+#include <romcache.hpp>
+#include <rewind.hpp>
+#include <triplebuffer.hpp>
+#include <algorithm>
+#include <atomic>
 #include <iostream>
 #include <stdexcept>
 #include <string>
 #include <filesystem>
+#include <fstream>
+#include <vector>
+#include <thread>
+#include <chrono>
+#include <cmath>
+#include <random>
+
+using Clock = std::chrono::steady_clock;
+
+// The core runs without sleeping, pacing to 60 frames per second is done by the emulation thread
+static constexpr auto FRAME_PERIOD = std::chrono::microseconds(1000000 / 60);
+// Longest wait for SDL events while the emulation is idle, bounds how late anything polled per loop is noticed
+static constexpr int IDLE_EVENT_TIMEOUT_MS = 250;
+// Most frames in a row the emulation thread runs without handing them over while behind schedule,
+// further behind than that the lost time is dropped
+static constexpr int MAX_FRAME_SKIP = 4;
+
+// Mean, standard deviation and maximum of durations in milliseconds
+struct Samples {
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    double max = 0.0;
+    uint64_t count = 0;
+
+    void add(const double ms) {
+        sum += ms;
+        sumSquares += ms * ms;
+        max = std::max(max, ms);
+        count++;
+    }
+    double mean() const {
+        return count > 0 ? sum / count : 0.0;
+    }
+    double deviation() const {
+        return count > 0 ? std::sqrt(std::max(0.0, sumSquares / count - mean() * mean())) : 0.0;
+    }
+};
+
+static double toMs(const Clock::duration duration) {
+    return std::chrono::duration<double, std::milli>(duration).count();
+}
+
+// Finished frame handed from the emulation thread to the SDL thread
+struct Frame {
+    Chip8::Graphix graphix;
+    bool highResolution = false;
+    Clock::time_point published;
+    Clock::time_point inputChanged;     // Newest key change the frame was run with, none at the epoch
+};
+
+// State shared by the emulation thread and the SDL thread
+struct Shared {
+    TripleBuffer<Frame> frames;
+    std::atomic<uint64_t> input{0};     // Microseconds since start of the last key change << 16 | packed keys
+    std::atomic<bool> rewinding{false};
+    std::atomic<bool> running{true};
+    std::atomic<uint32_t> events{0};    // Bumped after every change of input, rewinding or running, wakes an idle emulation thread
+    std::atomic<bool> idle{false};      // The emulation thread waits for input, the SDL thread can wait for events too
+    Clock::time_point start = Clock::now();
+};
+
+// Owned by the emulation thread until it is joined
+struct Emulation {
+    Chip8 chip8;
+    Rewind rewind;
+    Movie movie;
+    bool rewindEnabled;
+    uint64_t frame = 0;                 // Frames run, rewinding counts back
+
+    Samples inputLatency{};             // From a key change to the start of the frame using it
+    Samples frameTime{};                // Between the starts of consecutive frames
+    uint64_t skippedRenders = 0;        // Frames run behind schedule and not handed over for drawing
+    uint64_t scheduleResets = 0;        // Times more than MAX_FRAME_SKIP frames behind
+    double idleSeconds = 0.0;           // Waited for a key instead of running frames
+    Debugger* debugger = nullptr;       // Of chip8, both nullptr without --debug
+    DebugServer* debugServer = nullptr;
+};
+
+static void emulate(Emulation& emulation, Shared& shared) {
+    Chip8& chip8 = emulation.chip8;
+    Chip8::State rewindState;
+    uint64_t input = 0;
+    Clock::time_point inputChanged;
+    auto nextFrame = Clock::now();
+    Clock::time_point frameStart;       // Epoch for the first frame and after waiting for a key
+    int skipped = 0;                    // Frames in a row not handed over
+
+    while (shared.running.load(std::memory_order_relaxed)) {
+        if (emulation.debugServer != nullptr) {
+            emulation.debugServer->poll(0);
+        }
+
+        const auto now = Clock::now();
+        if (frameStart != Clock::time_point()) {
+            emulation.frameTime.add(toMs(now - frameStart));
+        }
+        frameStart = now;
+
+        // Read before the input, so a change after it ends the wait below
+        const uint32_t events = shared.events.load(std::memory_order_acquire);
+        const uint64_t latest = shared.input.load(std::memory_order_acquire);
+        if (latest != input) {
+            input = latest;
+            inputChanged = shared.start + std::chrono::microseconds(input >> 16);
+            emulation.inputLatency.add(toMs(now - inputChanged));
+        }
+
+        const std::array<bool, 16> keyState = Movie::unpackKeys(uint16_t(input));
+        chip8.setKeys(keyState);
+        emulation.movie.record(emulation.frame, keyState);
+
+        const bool rewinding = shared.rewinding.load(std::memory_order_relaxed);
+
+        // Waiting in FX0A with stopped timers, every frame until a key is pressed would only add cycles.
+        // Frames are not counted while waiting, so a recorded movie replays to the same states.
+        // The debug socket is polled every frame, so the thread never waits with a debugger.
+        if (!rewinding && emulation.debugServer == nullptr && chip8.isWaitingForKey() && chip8.getDelayTimer() == 0 && chip8.getSoundTimer() == 0) {
+            const auto idleStart = Clock::now();
+            shared.idle.store(true, std::memory_order_relaxed);
+            shared.events.wait(events, std::memory_order_acquire);
+            shared.idle.store(false, std::memory_order_relaxed);
+            emulation.idleSeconds += std::chrono::duration<double>(Clock::now() - idleStart).count();
+            nextFrame = Clock::now();
+            frameStart = Clock::time_point();
+            continue;
+        }
+
+        if (rewinding && emulation.rewind.pop(rewindState)) {
+            // The buffer holds the state before each frame
+            chip8.loadState(rewindState);
+            emulation.frame--;
+            emulation.movie.truncate(emulation.frame);
+        }
+        else if (!rewinding && (emulation.debugger == nullptr || !emulation.debugger->isStopped())) {
+            if (emulation.rewindEnabled) {
+                emulation.rewind.push(chip8.saveState());
+            }
+            chip8.runFrame();
+            emulation.frame++;
+        }
+
+        // Once the next frame is due already this one is not drawn, so the SDL thread does not spend time on
+        // frames replaced before they could be seen. Every MAX_FRAME_SKIP + 1 frames one is drawn anyway.
+        const auto finished = Clock::now();
+        if (finished > nextFrame + FRAME_PERIOD && skipped < MAX_FRAME_SKIP) {
+            skipped++;
+            emulation.skippedRenders++;
+        }
+        else {
+            skipped = 0;
+            Frame& frame = shared.frames.getWriteBuffer();
+            frame.graphix = chip8.getGraphix();
+            frame.highResolution = chip8.isHighResolution();
+            frame.published = finished;
+            frame.inputChanged = inputChanged;
+            shared.frames.publish();
+        }
+
+        nextFrame += FRAME_PERIOD;
+        if (finished > nextFrame + MAX_FRAME_SKIP * FRAME_PERIOD) {
+            nextFrame = finished;
+            emulation.scheduleResets++;
+        }
+
+        // Debugger packets are handled as they arrive until the next frame
+        int64_t remainingMs;
+        while (emulation.debugServer != nullptr &&
+               (remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(nextFrame - Clock::now()).count()) > 0) {
+            emulation.debugServer->poll(int(remainingMs));
+        }
+        std::this_thread::sleep_until(nextFrame);
+    }
+}
+
+// Rows of frame that differ from the shown screen, every row when the resolution changed
+static uint64_t changedRows(const Frame& frame, const Chip8::Graphix& shown, const bool shownHighResolution) {
+    if (frame.highResolution != shownHighResolution) {
+        return ~uint64_t(0);
+    }
+
+    const int rowWords = frame.highResolution ? 2 : 1;
+    const int height = frame.highResolution ? 64 : 32;
+    uint64_t rows = 0;
+    for (int row = 0; row < height; row++) {
+        for (int word = row * rowWords; word < (row + 1) * rowWords; word++) {
+            if (frame.graphix[word] != shown[word] ||
+                frame.graphix[Chip8::PLANE_WORDS + word] != shown[Chip8::PLANE_WORDS + word]) {
+                rows |= uint64_t(1) << row;
+            }
+        }
+    }
+    return rows;
+}
 
 static void usage() {
-    std::cout << "\nUsage: 'chip8 <filepath> [fps=60]'" << std::endl;
+    std::cout << "\nUsage: 'chip8 <filepath> [ips=60] [options]'" << std::endl;
     std::cout << "  filepath    <required>      path to the game binary (absolute or relative)" << std::endl;
-    std::cout << "  fps:        [optonal]       fps of the game (30 <= fps <= 1000)" << std::endl;
+    std::cout << "  ips:        [optional]      instructions per second of the game (30 <= ips <= 1000)" << std::endl;
+    std::cout << "\nOptions:" << std::endl;
+    std::cout << "  --scale <n>                 window pixels per chip8 pixel (1 <= n <= 40, default 10)" << std::endl;
+    std::cout << "  --ipf <n>                   instructions per 60 Hz frame instead of ips (1 <= n <= 100000)" << std::endl;
+    std::cout << "  --vsync <0|1>               present in step with the display refresh (default 0)" << std::endl;
+    std::cout << "  --rewind <seconds>          seconds kept for rewinding with backspace (0 <= n <= 600, default 10)" << std::endl;
+    std::cout << "  --rewind-budget <MB>        most memory used by the rewind buffer (1 <= n <= 1024, default 16)" << std::endl;
+    std::cout << "  --quirks <profile>          legacy, vip, chip48, schip, modern or xochip (default legacy)" << std::endl;
+    std::cout << "  --record <filepath>         record the input into a movie file for chip8-bench --replay" << std::endl;
+    std::cout << "  --counters <filepath>       write the instruction counters as JSON on exit (CHIP8_INSTRUMENTATION builds)" << std::endl;
+    std::cout << "  --debug <socket path>       serve a debugger on a Unix socket, see README" << std::endl;
     std::cout << "\nmArguments in <> are required and arguments in [] are optional" << std::endl;
 }
 
-int main(int argc, char** argv) {
-    if (argc > 3) {
-        std::cout << "ERROR: To many arguments" << std::endl;
+// Parses an integer argument within [min, max], printing the error and usage on failure
+static bool parseNumber(const std::string& name, const std::string& argument, const int64_t min, const int64_t max, int64_t& value) {
+    try {
+        value = std::stoll(argument); 
+        if (value < min) {
+            std::cout << "ERROR: To low " << name <<  std::endl;
+            usage();
+            return false;
+        }
+        else if (value > max) {
+            std::cout << "ERROR: To high " << name <<  std::endl;
+            usage();
+            return false;
+        }
+    }
+    catch (const std::invalid_argument& ex) {
+        std::cout << "ERROR: Argument " << name << " invalid, error message: '" << ex.what() << "'" << std::endl; 
         usage();
-        return 1;
+        return false;
     }
-    else if (argc < 2) {
-        std::cout << "ERROR: To few arguments" << std::endl;
+    catch (const std::out_of_range& ex) {
+        std::cout << "ERROR: Argument " << name << " out of range, error message: '" << ex.what() << "'" << std::endl; 
         usage();
-        return 1;
+        return false;
     }
-
-    std::string gameFilepath = argv[1];
-    if (!std::filesystem::exists(gameFilepath)) {
-        std::cout << "ERROR: No file with path: '" << gameFilepath << "' found" << std::endl;
+    catch (const std::exception& ex) {
+        std::cout << "ERROR: Unknown error when parsing " << name << ", error message: '" << ex.what() << "'" << std::endl; 
         usage();
-        return 1;
+        return false;
     }
+    return true;
+}
 
-    uint64_t ticksPerSecond = 60;
-    if (argc == 3) {
-        try {
-            int64_t fps = std::stoll(argv[2]); 
-            if (fps < 30) {
-                std::cout << "ERROR: To low fps" <<  std::endl;
-                usage();
+int main(int argc, char** argv) {
+    std::vector<std::string> positional;
+    int64_t scale = 10;
+    int64_t instructionsPerFrame = 0;   // 0 takes the instructions per second from ips
+    int64_t vsync = 0;
+    int64_t rewindSeconds = 10;
+    int64_t rewindBudget = 16;
+    QuirkProfile quirkProfile = QuirkProfile::Legacy;
+    std::string movieFilepath;
+    std::string countersFilepath;
+    std::string debugSocketPath;
+
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+        if (argument.rfind("--", 0) != 0) {
+            positional.push_back(argument);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cout << "ERROR: Missing value for '" << argument << "'" << std::endl;
+            usage();
+            return 1;
+        }
+
+        std::string value = argv[++i];
+        if (argument == "--scale") {
+            if (!parseNumber("scale", value, 1, 40, scale)) {
+                return 1;
+            }
+        }
+        else if (argument == "--ipf") {
+            if (!parseNumber("ipf", value, 1, 100000, instructionsPerFrame)) {
+                return 1;
+            }
+        }
+        else if (argument == "--vsync") {
+            if (!parseNumber("vsync", value, 0, 1, vsync)) {
+                return 1;
+            }
+        }
+        else if (argument == "--rewind") {
+            if (!parseNumber("rewind", value, 0, 600, rewindSeconds)) {
+                return 1;
+            }
+        }
+        else if (argument == "--rewind-budget") {
+            if (!parseNumber("rewind budget", value, 1, 1024, rewindBudget)) {
                 return 1;
             }
-            else if (fps > 1000) {
-                std::cout << "ERROR: To high fps" <<  std::endl;
+        }
+        else if (argument == "--quirks") {
+            if (!parseQuirkProfile(value, quirkProfile)) {
+                std::cout << "ERROR: Unknown quirk profile '" << value << "'" << std::endl;
                 usage();
                 return 1;
             }
-            ticksPerSecond = fps;
         }
-        catch (const std::invalid_argument& ex) {
-            std::cout << "ERROR: Second argument invalid, error message: '" << ex.what() << "'" << std::endl; 
-            usage();
-            return 1;
+        else if (argument == "--record") {
+            movieFilepath = value;
+        }
+        else if (argument == "--counters") {
+            if (!INSTRUMENTATION) {
+                std::cout << "ERROR: Counters need a build with CHIP8_INSTRUMENTATION" << std::endl;
+                return 1;
+            }
+            countersFilepath = value;
         }
-        catch (const std::out_of_range& ex) {
-            std::cout << "ERROR: Second argument out of range, error message: '" << ex.what() << "'" << std::endl; 
+        else if (argument == "--debug") {
+            debugSocketPath = value;
+        }
+        else {
+            std::cout << "ERROR: Unknown option '" << argument << "'" << std::endl;
             usage();
             return 1;
         }
-        catch (const std::exception& ex) {
-            std::cout << "ERROR: Unknown error when parsing fps, error message: '" << ex.what() << "'" << std::endl; 
-            usage();
+    }
+
+    if (positional.size() > 2) {
+        std::cout << "ERROR: To many arguments" << std::endl;
+        usage();
+        return 1;
+    }
+    else if (positional.size() < 1) {
+        std::cout << "ERROR: To few arguments" << std::endl;
+        usage();
+        return 1;
+    }
+
+    std::string gameFilepath = positional[0];
+    if (!std::filesystem::exists(gameFilepath)) {
+        std::cout << "ERROR: No file with path: '" << gameFilepath << "' found" << std::endl;
+        usage();
+        return 1;
+    }
+
+    uint64_t ticksPerSecond = 60;
+    if (positional.size() == 2 && instructionsPerFrame > 0) {
+        std::cout << "ERROR: Give either ips or --ipf" << std::endl;
+        usage();
+        return 1;
+    }
+    else if (instructionsPerFrame > 0) {
+        ticksPerSecond = instructionsPerFrame * 60;
+    }
+    else if (positional.size() == 2) {
+        int64_t instructionsPerSecond;
+        if (!parseNumber("ips", positional[1], 30, 1000, instructionsPerSecond)) {
             return 1;
         }
+        ticksPerSecond = instructionsPerSecond;
     }
 
-    Game game(gameFilepath);
+    // Outlives the game, whose audio device reads from it
+    Beeper beeper(AUDIO_SAMPLE_RATE);
+    Game game(gameFilepath, scale, vsync != 0);
 
-    Chip8 chip8;
-    chip8.initialize(ticksPerSecond);
+    // Read once for the hash and the load
+    const std::shared_ptr<const Rom> rom = Rom::open(gameFilepath);
+    if (rom == nullptr) {
+        std::cout << "ERROR: Could not read '" << gameFilepath << "' or it is larger than " << Rom::MAX_SIZE << " bytes" << std::endl;
+        return 1;
+    }
+    const uint64_t gameHash = rom->getHash();
+
+    // The seed is chosen here so a recording can replay the same random numbers
+    std::random_device randomDevice;
+    const uint64_t seed = uint64_t(randomDevice()) << 32 | randomDevice();
+    Emulation emulation{Chip8(), Rewind(rewindSeconds * 60, rewindBudget * 1024 * 1024), Movie(gameHash, seed, ticksPerSecond, quirkProfile), rewindSeconds > 0};
+    // The profile sizes the memory, XO-CHIP games may be larger than 4 KB
+    emulation.chip8.setQuirkProfile(quirkProfile);
+    emulation.chip8.initialize(ticksPerSecond, seed);
 
-    if (!chip8.loadGame(gameFilepath)) {
+    if (!emulation.chip8.loadGame(rom->getData(), rom->getSize())) {
         std::cout << "ERROR: game file to large" << std::endl;
         usage();
         return 0;
     }
 
-        std::array<bool, 16> keyState = chip8.getKeys();
-    
+    // Games compiled into the build with CHIP8_AOT_GAMES run their blocks instead of the interpreter
+    if (const AotProgram* program = findAotProgram(gameHash, rom->getSize(), quirkProfile)) {
+        emulation.chip8.setAotProgram(program);
+        emulation.chip8.setBackend(Backend::Aot);
+    }
+
+    if (game.startAudio(beeper)) {
+        emulation.chip8.setAudioSink(&beeper);
+    }
+
+    // Only armed while a client stopped the machine or set anything, the machine runs its backend otherwise
+    Debugger debugger(emulation.chip8);
+    DebugServer debugServer(debugger);
+    if (!debugSocketPath.empty()) {
+        if (!debugServer.listen(debugSocketPath)) {
+            std::cout << "ERROR: Could not serve the debugger on '" << debugSocketPath << "'" << std::endl;
+            return 1;
+        }
+        emulation.debugger = &debugger;
+        emulation.debugServer = &debugServer;
+        std::cout << "Debugger listening on '" << debugSocketPath << "'" << std::endl;
+    }
+
+    std::array<bool, 16> keyState = emulation.chip8.getKeys();
+    uint16_t keys = Movie::packKeys(keyState);
+
+    Shared shared;
+    std::thread emulationThread(emulate, std::ref(emulation), std::ref(shared));
+
+    // The SDL thread presents once per display frame, every refresh with vsync and every FRAME_PERIOD otherwise.
+    // Rows are compared against the shown frame as frames skipped by the triple buffer carry no dirty rows.
+    Chip8::Graphix shown{};
+    bool shownHighResolution = false;
+    uint64_t dirtyRows = ~uint64_t(0);
+    const bool presentVsync = game.hasVsync();
+    auto nextPresent = Clock::now();
+    Clock::time_point lastPresent;      // Epoch after waiting while the emulation was idle
+    Clock::time_point shownInput;       // Key change of the newest frame presented
+    Samples displayLatency;             // From a finished frame to its present
+    Samples photonLatency;              // From a key change to the present of the first frame run with it
+    Samples presentInterval;
+
+    const auto notify = [&shared]() {
+        shared.events.fetch_add(1, std::memory_order_release);
+        shared.events.notify_one();
+    };
+    const auto passInput = [&]() {
+        const uint16_t latestKeys = Movie::packKeys(keyState);
+        if (latestKeys != keys) {
+            keys = latestKeys;
+            const uint64_t since = std::chrono::duration_cast<std::chrono::microseconds>(Clock::now() - shared.start).count();
+            shared.input.store(since << 16 | keys, std::memory_order_release);
+            notify();
+        }
+        if (game.isRewinding() != shared.rewinding.load(std::memory_order_relaxed)) {
+            shared.rewinding.store(game.isRewinding(), std::memory_order_relaxed);
+            notify();
+        }
+    };
+
     while (game.isRunning()) {
-        chip8.emulateCycle();
-        
-        if (chip8.getDrawFlag()) {
-            game.drawScreen(chip8.getGraphix());
+        const bool idle = shared.idle.load(std::memory_order_relaxed);
+
+        // Until the next present events are handled as they arrive, so key changes are not held back a display frame
+        const auto now = Clock::now();
+        if (!idle && !presentVsync && now < nextPresent) {
+            const int64_t remainingMs = std::chrono::duration_cast<std::chrono::milliseconds>(nextPresent - now).count();
+            if (remainingMs > 0) {
+                game.waitEvents(keyState, int(remainingMs));
+            }
+            else {
+                std::this_thread::sleep_until(nextPresent);
+            }
+            passInput();
+            continue;
         }
-        
+
         game.handleEvents(keyState);
+        passInput();
 
-        chip8.setKeys(keyState);
+        const bool updated = shared.frames.update();
+        const Frame& frame = shared.frames.getReadBuffer();
+        if (updated) {
+            dirtyRows |= changedRows(frame, shown, shownHighResolution);
+            if (dirtyRows != 0) {
+                game.drawScreen(frame.graphix, frame.highResolution, dirtyRows);
+                shown = frame.graphix;
+                shownHighResolution = frame.highResolution;
+                dirtyRows = 0;
+            }
+        }
+
+        // No frames arrive while the emulation thread is idle, so only events need handling
+        if (idle && !updated) {
+            lastPresent = Clock::time_point();
+            game.waitEvents(keyState, IDLE_EVENT_TIMEOUT_MS);
+            passInput();
+            continue;
+        }
+
+        game.present();
+        const auto presented = Clock::now();
+        if (lastPresent != Clock::time_point()) {
+            presentInterval.add(toMs(presented - lastPresent));
+        }
+        lastPresent = presented;
+        if (updated) {
+            displayLatency.add(toMs(presented - frame.published));
+            if (frame.inputChanged != shownInput) {
+                shownInput = frame.inputChanged;
+                photonLatency.add(toMs(presented - frame.inputChanged));
+            }
+        }
+
+        nextPresent += FRAME_PERIOD;
+        if (nextPresent < presented) {
+            nextPresent = presented + FRAME_PERIOD;
+        }
+    }
+
+    shared.running = false;
+    notify();
+    emulationThread.join();
+
+    // A change waits for the next frame start instead of for the poll after a frame and then the next frame.
+    // The single threaded loop is not run, its latency is assumed as one and a half frame periods, the mean
+    // of that wait, so the difference is an estimate and not a measurement
+    if (emulation.inputLatency.count > 0) {
+        const double serialMs = 1.5 * toMs(FRAME_PERIOD);
+        const double inputMs = emulation.inputLatency.mean();
+        std::cout << "Input latency: " << inputMs << " ms mean, " << emulation.inputLatency.max << " ms max, estimated "
+                  << serialMs - inputMs << " ms less than the " << serialMs
+                  << " ms assumed for a single threaded loop (1.5 frames, not measured)" << std::endl;
+    }
+    if (photonLatency.count > 0) {
+        std::cout << "Input to photon latency: " << photonLatency.mean() << " ms mean, " << photonLatency.max << " ms max from a key change to the present of its first frame" << std::endl;
+    }
+    if (emulation.frameTime.count > 0) {
+        std::cout << "Frame time: " << emulation.frameTime.mean() << " ms mean, " << emulation.frameTime.deviation() << " ms jitter, "
+                  << emulation.frameTime.max << " ms max, " << emulation.skippedRenders << " frames not drawn behind schedule, "
+                  << emulation.scheduleResets << " schedule resets" << std::endl;
+    }
+    if (presentInterval.count > 0) {
+        std::cout << "Present interval: " << presentInterval.mean() << " ms mean, " << presentInterval.deviation() << " ms jitter, "
+                  << presentInterval.max << " ms max " << (presentVsync ? "with" : "without") << " vsync" << std::endl;
+    }
+    if (emulation.idleSeconds > 0 || emulation.chip8.getElidedCycles() > 0) {
+        std::cout << "Idle: " << emulation.idleSeconds << " s waited for a key, "
+                  << emulation.chip8.getElidedCycles() << " cycles fast-forwarded in idle loops" << std::endl;
+    }
+    if (displayLatency.count > 0) {
+        std::cout << "Display latency: " << displayLatency.mean() << " ms mean from finished frame to screen" << std::endl;
+    }
+
+    if (!countersFilepath.empty()) {
+        std::ofstream countersFile(countersFilepath);
+        emulation.chip8.getCounters().writeJson(countersFile);
+        countersFile << std::endl;
+        if (!countersFile) {
+            std::cout << "ERROR: Could not write counters '" << countersFilepath << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    Movie& movie = emulation.movie;
+    Rewind& rewind = emulation.rewind;
+    if (!movieFilepath.empty()) {
+        movie.setLength(emulation.frame);
+        if (!movie.save(movieFilepath)) {
+            std::cout << "ERROR: Could not write movie '" << movieFilepath << "'" << std::endl;
+            return 1;
+        }
+    }
+
+    if (rewind.getFrames() > 0) {
+        std::cout << "Rewind buffer: " << rewind.getFrames() << " frames in " << rewind.getBytes() << " bytes, "
+                  << uint64_t(rewind.getBytesPerSecond()) << " bytes per second of history" << std::endl;
     }
     return 0;
 }
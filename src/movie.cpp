@@ -0,0 +1,201 @@
+#include "movie.hpp"
+
+#include <fstream>
+
+static constexpr uint32_t MOVIE_MAGIC = 0x564D3843; // "C8MV"
+
+template <typename T>
+static void writeLittleEndian(std::ostream& os, const T value) {
+    for (size_t byte = 0; byte < sizeof(T); byte++) {
+        os.put(char(uint64_t(value) >> (byte * 8)));
+    }
+}
+
+template <typename T>
+static bool readLittleEndian(std::istream& is, T& value) {
+    uint64_t result = 0;
+    for (size_t byte = 0; byte < sizeof(T); byte++) {
+        char data;
+        if (!is.get(data)) {
+            return false;
+        }
+        result |= uint64_t(Byte(data)) << (byte * 8);
+    }
+    value = T(result);
+    return true;
+}
+
+Movie::Movie() : Movie(0, 0, 0) {
+}
+
+Movie::Movie(const uint64_t gameHash, const uint64_t seed, const uint64_t ticksPerSecond, const QuirkProfile quirkProfile) :
+mGameHash(gameHash), mSeed(seed), mTicksPerSecond(ticksPerSecond), mLength(0), mQuirkProfile(quirkProfile)
+{
+}
+
+void Movie::record(const uint64_t frame, const std::array<bool, 16>& keyState) {
+    const uint16_t keys = packKeys(keyState);
+    const uint16_t previous = mEvents.empty() ? 0 : mEvents.back().keys;
+    if (keys != previous) {
+        mEvents.push_back({frame, keys});
+    }
+    mLength = std::max(mLength, frame + 1);
+}
+
+void Movie::truncate(const uint64_t frame) {
+    while (!mEvents.empty() && mEvents.back().frame >= frame) {
+        mEvents.pop_back();
+    }
+    mLength = std::min(mLength, frame);
+}
+
+void Movie::setLength(const uint64_t frames) {
+    mLength = frames;
+}
+
+bool Movie::save(const std::string& filepath) const {
+    std::ofstream fs(filepath, std::ios::binary | std::ios::out);
+    if (!fs) {
+        return false;
+    }
+
+    writeLittleEndian(fs, MOVIE_MAGIC);
+    writeLittleEndian(fs, VERSION);
+    writeLittleEndian(fs, mGameHash);
+    writeLittleEndian(fs, mSeed);
+    writeLittleEndian(fs, mTicksPerSecond);
+    writeLittleEndian(fs, mLength);
+    writeLittleEndian(fs, Byte(mQuirkProfile));
+
+    uint64_t frame = 0;
+    for (const auto & event : mEvents) {
+        uint64_t delta = event.frame - frame;
+        while (delta >= 0x80) {
+            fs.put(char(delta | 0x80));
+            delta >>= 7;
+        }
+        fs.put(char(delta));
+        writeLittleEndian(fs, event.keys);
+        frame = event.frame;
+    }
+    return bool(fs);
+}
+
+bool Movie::load(const std::string& filepath) {
+    std::ifstream fs(filepath, std::ios::binary | std::ios::in);
+    uint32_t magic = 0;
+    uint32_t version = 0;
+    if (!readLittleEndian(fs, magic) || magic != MOVIE_MAGIC || !readLittleEndian(fs, version) || version < 1 || version > VERSION) {
+        return false;
+    }
+    if (!readLittleEndian(fs, mGameHash) || !readLittleEndian(fs, mSeed)
+        || !readLittleEndian(fs, mTicksPerSecond) || !readLittleEndian(fs, mLength) || mTicksPerSecond == 0) {
+        return false;
+    }
+
+    Byte quirkProfile = Byte(QuirkProfile::Legacy);
+    if (version >= 2 && (!readLittleEndian(fs, quirkProfile) || !isQuirkProfile(quirkProfile))) {
+        return false;
+    }
+    mQuirkProfile = QuirkProfile(quirkProfile);
+
+    mEvents.clear();
+    uint64_t frame = 0;
+    while (fs.peek() != std::ifstream::traits_type::eof()) {
+        uint64_t delta = 0;
+        char data = 0;
+        for (int shift = 0; fs.get(data); shift += 7) {
+            delta |= uint64_t(Byte(data) & 0x7F) << shift;
+            if ((Byte(data) & 0x80) == 0) {
+                break;
+            }
+        }
+
+        Event event;
+        if (!fs || !readLittleEndian(fs, event.keys)) {
+            return false;
+        }
+        frame += delta;
+        event.frame = frame;
+        mEvents.push_back(event);
+    }
+    return true;
+}
+
+bool Movie::start(Chip8& chip8, const std::string& gameFilepath) const {
+    const std::shared_ptr<const Rom> game = Rom::open(gameFilepath);
+    return game != nullptr && start(chip8, *game);
+}
+
+bool Movie::start(Chip8& chip8, const Rom& game) const {
+    if (game.getHash() != mGameHash) {
+        return false;
+    }
+
+    chip8.setQuirkProfile(mQuirkProfile);
+    chip8.initialize(mTicksPerSecond, mSeed);
+    return chip8.loadGame(game.getData(), game.getSize());
+}
+
+void Movie::apply(Chip8& chip8, const uint64_t frame, size_t& nextEvent) const {
+    // Events of skipped frames still apply, the last one before frame wins
+    bool changed = false;
+    uint16_t keys = 0;
+    while (nextEvent < mEvents.size() && mEvents[nextEvent].frame <= frame) {
+        keys = mEvents[nextEvent++].keys;
+        changed = true;
+    }
+    if (changed) {
+        chip8.setKeys(unpackKeys(keys));
+    }
+}
+
+uint64_t Movie::getGameHash() const {
+    return mGameHash;
+}
+
+uint64_t Movie::getSeed() const {
+    return mSeed;
+}
+
+uint64_t Movie::getTicksPerSecond() const {
+    return mTicksPerSecond;
+}
+
+QuirkProfile Movie::getQuirkProfile() const {
+    return mQuirkProfile;
+}
+
+uint64_t Movie::getLength() const {
+    return mLength;
+}
+
+const std::vector<Movie::Event>& Movie::getEvents() const {
+    return mEvents;
+}
+
+bool Movie::hashGame(const std::string& gameFilepath, uint64_t& hash) {
+    const std::shared_ptr<const Rom> game = Rom::open(gameFilepath);
+    if (game == nullptr) {
+        return false;
+    }
+
+    hash = game->getHash();
+    return true;
+}
+
+uint16_t Movie::packKeys(const std::array<bool, 16>& keyState) {
+    uint16_t keys = 0;
+    for (int key = 0; key < 16; key++) {
+        keys |= keyState[key] ? 1 << key : 0;
+    }
+    return keys;
+}
+
+std::array<bool, 16> Movie::unpackKeys(const uint16_t keys) {
+    std::array<bool, 16> keyState;
+    for (int key = 0; key < 16; key++) {
+        keyState[key] = ((keys >> key) & 1) != 0;
+    }
+    return keyState;
+}
@@ -0,0 +1,60 @@
+#include "profiler.hpp"
+#include "disassembler.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <sstream>
+
+static std::string address(const Word value) {
+    std::ostringstream os;
+    os << "0x" << std::uppercase << std::hex << std::setw(3) << std::setfill('0') << value;
+    return os.str();
+}
+
+Profiler::Profiler(const uint64_t interval) :
+mInterval(std::max<uint64_t>(interval, 1)), mSamples(0)
+{
+}
+
+void Profiler::sample(const Chip8& chip8) {
+    const std::vector<Byte>& memory = chip8.getMemory();
+    const std::array<Word, 16>& stack = chip8.getStack();
+    const Word mask = Word(memory.size() - 1);
+
+    // Each stack entry is the address of the 2NNN that made the call, NNN is the subroutine
+    mStack.clear();
+    for (size_t entry = 0; entry < std::min<size_t>(chip8.getStackP(), stack.size()); entry++) {
+        const Word call = stack[entry] & mask;
+        mStack.push_back((memory[call] << 8 | memory[(call + 1) & mask]) & 0x0FFF);
+    }
+    mStack.push_back(chip8.getProgramCounter() & mask);
+
+    mStacks[mStack]++;
+    mSamples++;
+}
+
+void Profiler::clear() {
+    mStacks.clear();
+    mSamples = 0;
+}
+
+void Profiler::writeFolded(std::ostream& os, const std::string& root, const std::vector<Byte>& memory) const {
+    const Word mask = Word(memory.size() - 1);
+    for (const auto & [stack, count] : mStacks) {
+        os << root;
+        for (size_t frame = 0; frame + 1 < stack.size(); frame++) {
+            os << ";sub_" << address(stack[frame]);
+        }
+
+        const Word pc = stack.back();
+        os << ";" << address(pc) << " " << disassemble(memory[pc & mask] << 8 | memory[(pc + 1) & mask]) << " " << count << "\n";
+    }
+}
+
+uint64_t Profiler::getInterval() const {
+    return mInterval;
+}
+
+uint64_t Profiler::getSamples() const {
+    return mSamples;
+}
@@ -0,0 +1,41 @@
+#include "quirks.hpp"
+
+#include <array>
+#include <utility>
+
+static const std::array<std::pair<QuirkProfile, const char*>, 6> NAMES = {{
+    {QuirkProfile::Legacy, "legacy"},
+    {QuirkProfile::CosmacVip, "vip"},
+    {QuirkProfile::Chip48, "chip48"},
+    {QuirkProfile::SuperChip, "schip"},
+    {QuirkProfile::Modern, "modern"},
+    {QuirkProfile::XoChip, "xochip"},
+}};
+
+const char* getQuirkProfileName(const QuirkProfile profile) {
+    for (const auto & [candidate, name] : NAMES) {
+        if (candidate == profile) {
+            return name;
+        }
+    }
+    return NAMES[0].second;
+}
+
+bool isQuirkProfile(const int value) {
+    for (const auto & [candidate, name] : NAMES) {
+        if (int(candidate) == value) {
+            return true;
+        }
+    }
+    return false;
+}
+
+bool parseQuirkProfile(const std::string& name, QuirkProfile& profile) {
+    for (const auto & [candidate, candidateName] : NAMES) {
+        if (name == candidateName) {
+            profile = candidate;
+            return true;
+        }
+    }
+    return false;
+}
@@ -0,0 +1,110 @@
+#include <quirks.hpp>
+#include <recompiler.hpp>
+#include <romcache.hpp>
+
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+struct Options {
+    std::string gameFilepath;
+    std::string outputFilepath;
+    std::string listingFilepath;        // Disassembly of the reached instructions is written here when set
+    std::string name;                   // File name of the game unless set
+    QuirkProfile quirkProfile = QuirkProfile::Legacy;
+};
+
+static void usage() {
+    std::cout << "\nUsage: 'chip8-recompile [options] <game> <output>'" << std::endl;
+    std::cout << "  game                <required>      path to the game binary" << std::endl;
+    std::cout << "  output              <required>      path of the C++ translation unit to write" << std::endl;
+    std::cout << "  --quirks <profile>  [optional]      legacy, vip, chip48, schip, modern or xochip (default legacy)" << std::endl;
+    std::cout << "  --name <name>       [optional]      name the program is registered as (default the file name)" << std::endl;
+    std::cout << "  --listing <filepath>[optional]      write the disassembly of every reached instruction" << std::endl;
+    std::cout << "\nArguments in <> are required and arguments in [] are optional" << std::endl;
+}
+
+static bool parseArguments(int argc, char** argv, Options& options) {
+    std::vector<std::string> filepaths;
+    for (int i = 1; i < argc; i++) {
+        std::string argument = argv[i];
+
+        if (argument.rfind("--", 0) != 0) {
+            filepaths.push_back(argument);
+            continue;
+        }
+        if (i + 1 >= argc) {
+            std::cout << "ERROR: Missing value for '" << argument << "'" << std::endl;
+            return false;
+        }
+
+        std::string value = argv[++i];
+        if (argument == "--quirks") {
+            if (!parseQuirkProfile(value, options.quirkProfile)) {
+                std::cout << "ERROR: Unknown quirk profile '" << value << "'" << std::endl;
+                return false;
+            }
+        }
+        else if (argument == "--name") {
+            options.name = value;
+        }
+        else if (argument == "--listing") {
+            options.listingFilepath = value;
+        }
+        else {
+            std::cout << "ERROR: Unknown option '" << argument << "'" << std::endl;
+            return false;
+        }
+    }
+
+    if (filepaths.size() != 2) {
+        std::cout << "ERROR: Expected a game and an output file" << std::endl;
+        return false;
+    }
+    options.gameFilepath = filepaths[0];
+    options.outputFilepath = filepaths[1];
+    if (options.name.empty()) {
+        options.name = std::filesystem::path(options.gameFilepath).filename().string();
+    }
+    return true;
+}
+
+int main(int argc, char** argv) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        usage();
+        return 1;
+    }
+
+    const std::shared_ptr<const Rom> rom = Rom::open(options.gameFilepath);
+    if (rom == nullptr || rom->getSize() < 2) {
+        std::cout << "ERROR: Could not read game '" << options.gameFilepath << "'" << std::endl;
+        return 1;
+    }
+    if (rom->getSize() > getMemorySize(getQuirks(options.quirkProfile)) - 0x200) {
+        std::cout << "ERROR: game file to large: '" << options.gameFilepath << "'" << std::endl;
+        return 1;
+    }
+
+    const Recompiler recompiler(rom->getData(), rom->getSize(), options.quirkProfile);
+
+    std::ofstream output(options.outputFilepath);
+    recompiler.write(output, options.name);
+    if (!output) {
+        std::cout << "ERROR: Could not write '" << options.outputFilepath << "'" << std::endl;
+        return 1;
+    }
+
+    if (!options.listingFilepath.empty()) {
+        std::ofstream listing(options.listingFilepath);
+        recompiler.writeListing(listing);
+        if (!listing) {
+            std::cout << "ERROR: Could not write '" << options.listingFilepath << "'" << std::endl;
+            return 1;
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,290 @@
+#include "recompiler.hpp"
+
+#include "disassembler.hpp"
+#include "romcache.hpp"
+
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+static std::string hex(const uint64_t value, const int digits) {
+    std::ostringstream os;
+    os << "0x" << std::uppercase << std::hex << std::setw(digits) << std::setfill('0') << value;
+    return os.str();
+}
+
+static std::string reg(const int index) {
+    return "V[" + hex(index, 1) + "]";
+}
+
+static const char* getProfileEnumerator(const QuirkProfile profile) {
+    switch (profile) {
+        case QuirkProfile::CosmacVip: return "QuirkProfile::CosmacVip";
+        case QuirkProfile::Chip48: return "QuirkProfile::Chip48";
+        case QuirkProfile::SuperChip: return "QuirkProfile::SuperChip";
+        case QuirkProfile::Modern: return "QuirkProfile::Modern";
+        case QuirkProfile::XoChip: return "QuirkProfile::XoChip";
+        case QuirkProfile::Legacy: break;
+    }
+    return "QuirkProfile::Legacy";
+}
+
+Recompiler::Recompiler(const Byte* data, const size_t size, const QuirkProfile profile) :
+mData(data), mSize(size), mProfile(profile), mQuirks(getQuirks(profile))
+{
+    analyze();
+}
+
+const std::vector<Word>& Recompiler::getReached() const {
+    return mReached;
+}
+
+const std::vector<Recompiler::Block>& Recompiler::getBlocks() const {
+    return mBlocks;
+}
+
+bool Recompiler::isInGame(const int address) const {
+    return address >= 0x200 && size_t(address - 0x200) + 2 <= mSize;
+}
+
+Word Recompiler::getOperationCode(const int address) const {
+    return mData[address - 0x200] << 8 | mData[address - 0x200 + 1];
+}
+
+bool Recompiler::isTranslated(const int address) const {
+    const Word operationCode = getOperationCode(address);
+    // A jump to itself is an idle loop the interpreter fast-forwards
+    if ((operationCode & 0xF000) == 0x1000 && (operationCode & 0x0FFF) == address) {
+        return false;
+    }
+
+    // The Jit leaves skips to the interpreter with XO-CHIP, where they step over four byte instructions
+    const bool skips = mQuirks.instructionSet != Quirks::InstructionSet::XoChip;
+    switch (operationCode & 0xF000) {
+        case 0x1000: case 0x6000: case 0x7000: case 0xA000:
+            return true;
+        case 0x3000: case 0x4000: case 0x5000: case 0x9000:
+            return skips;
+        case 0x8000:
+            return (operationCode & 0x000F) <= 0x7 || (operationCode & 0x000F) == 0xE;
+        case 0xF000:
+            return (operationCode & 0x00FF) == 0x1E || (operationCode & 0x00FF) == 0x29;
+    }
+    return false;
+}
+
+bool Recompiler::isTerminator(const Word operationCode) const {
+    switch (operationCode & 0xF000) {
+        case 0x1000: case 0x3000: case 0x4000: case 0x5000: case 0x9000:
+            return true;
+    }
+    return false;
+}
+
+std::vector<int> Recompiler::getSuccessors(const int address) const {
+    const Word operationCode = getOperationCode(address);
+    const bool xoChip = mQuirks.instructionSet == Quirks::InstructionSet::XoChip;
+
+    // A taken XO-CHIP skip steps over all four bytes of F000 NNNN
+    const int skipped = xoChip && isInGame(address + 2) && getOperationCode(address + 2) == 0xF000 ? address + 6 : address + 4;
+    const bool skip = (operationCode & 0xF000) == 0x3000 || (operationCode & 0xF000) == 0x4000
+        || (operationCode & 0xF000) == 0x9000 || (operationCode & 0xF0FF) == 0xE09E || (operationCode & 0xF0FF) == 0xE0A1
+        || ((operationCode & 0xF000) == 0x5000 && !(xoChip && ((operationCode & 0x000F) == 0x2 || (operationCode & 0x000F) == 0x3)));
+    if (skip) {
+        return {address + 2, skipped};
+    }
+
+    switch (operationCode & 0xF000) {
+        case 0x1000: return {operationCode & 0x0FFF};
+        case 0x2000: return {operationCode & 0x0FFF, address + 2};
+        case 0xB000: return {};         // Computed, the target is found at runtime
+    }
+    if (operationCode == 0x00EE || operationCode == 0x00FD) {
+        return {};                      // The return address was queued by its call, 00FD stays in place
+    }
+    if (xoChip && operationCode == 0xF000) {
+        return {address + 4};
+    }
+    if (disassemble(operationCode).rfind("DW ", 0) == 0) {
+        return {};                      // Data, or an instruction that stops the program
+    }
+    return {address + 2};
+}
+
+void Recompiler::analyze() {
+    std::vector<bool> reached(mSize, false);
+    std::set<int> leaders;
+
+    // Only instructions that fall through inside a block have a successor that is not itself a block start
+    std::vector<int> pending = {0x200};
+    leaders.insert(0x200);
+    while (!pending.empty()) {
+        const int address = pending.back();
+        pending.pop_back();
+        if (!isInGame(address) || reached[address - 0x200]) {
+            continue;
+        }
+        reached[address - 0x200] = true;
+        mReached.push_back(address);
+
+        const Word operationCode = getOperationCode(address);
+        const bool fallsThrough = isTranslated(address) && !isTerminator(operationCode);
+        for (const int successor : getSuccessors(address)) {
+            if (!isInGame(successor)) {
+                continue;
+            }
+            if (!fallsThrough) {
+                leaders.insert(successor);
+            }
+            pending.push_back(successor);
+        }
+    }
+    std::sort(mReached.begin(), mReached.end());
+
+    // Leaders are visited in order, so the start added after a block cut at its length is visited later
+    for (auto leader = leaders.begin(); leader != leaders.end(); ++leader) {
+        int address = *leader;
+        Word instructions = 0;
+        while (isInGame(address) && isTranslated(address) && instructions < AOT_MAX_BLOCK_INSTRUCTIONS) {
+            instructions++;
+            address += 2;
+            if (isTerminator(getOperationCode(address - 2))) {
+                break;
+            }
+        }
+        if (instructions == 0) {
+            continue;
+        }
+        mBlocks.push_back({Word(*leader), Word(address - 1), instructions});
+        if (!isTerminator(getOperationCode(address - 2)) && isInGame(address)) {
+            leaders.insert(address);
+        }
+    }
+}
+
+void Recompiler::writeInstruction(std::ostream& os, const int address) const {
+    const Word operationCode = getOperationCode(address);
+    const int X = (operationCode & 0x0F00) >> 8;
+    const int Y = (operationCode & 0x00F0) >> 4;
+    const int S = mQuirks.shiftReadsVY ? Y : X;     // Register shifted by 8XY6 and 8XYE
+    const std::string NN = hex(operationCode & 0x00FF, 2);
+    const std::string NNN = hex(operationCode & 0x0FFF, 3);
+
+    std::ostringstream statement;
+    // VF is written after VX with flagWrittenLast, otherwise before VX is computed from the changed registers
+    const auto flagged = [&](const std::string& flag, const std::string& value) {
+        statement << "{ const Byte flag = " << flag << "; ";
+        if (mQuirks.flagWrittenLast) {
+            statement << reg(X) << " = " << value << "; V[0xF] = flag; }";
+        }
+        else {
+            statement << "V[0xF] = flag; " << reg(X) << " = " << value << "; }";
+        }
+    };
+    const auto logic = [&](const char* operation) {
+        statement << reg(X) << " " << operation << "= " << reg(Y) << ";";
+        if (mQuirks.logicResetsVF) {
+            statement << " V[0xF] = 0;";
+        }
+    };
+
+    switch (operationCode & 0xF000) {
+        case 0x1000: statement << "return " << NNN << ";"; break;
+        case 0x3000: statement << "return " << reg(X) << " == " << NN << " ? "; break;
+        case 0x4000: statement << "return " << reg(X) << " != " << NN << " ? "; break;
+        case 0x5000: statement << "return " << reg(X) << " == " << reg(Y) << " ? "; break;
+        case 0x9000: statement << "return " << reg(X) << " != " << reg(Y) << " ? "; break;
+        case 0x6000: statement << reg(X) << " = " << NN << ";"; break;
+        case 0x7000: statement << reg(X) << " += " << NN << ";"; break;
+        case 0x8000:
+            switch (operationCode & 0x000F) {
+                case 0x0: statement << reg(X) << " = " << reg(Y) << ";"; break;
+                case 0x1: logic("|"); break;
+                case 0x2: logic("&"); break;
+                case 0x3: logic("^"); break;
+                case 0x4: flagged(reg(X) + " + " + reg(Y) + " > 0xFF", reg(X) + " + " + reg(Y)); break;
+                case 0x5: flagged(reg(X) + " >= " + reg(Y), reg(X) + " - " + reg(Y)); break;
+                case 0x6: flagged(reg(S) + " & 0x01", reg(S) + " >> 1"); break;
+                case 0x7: flagged(reg(Y) + " >= " + reg(X), reg(Y) + " - " + reg(X)); break;
+                case 0xE: flagged(reg(S) + " >> 7", reg(S) + " << 1"); break;
+            }
+            break;
+        case 0xA000: statement << "I = " << NNN << ";"; break;
+        case 0xF000:
+            if ((operationCode & 0x00FF) == 0x1E) {
+                statement << "I += " << reg(X) << ";";
+            }
+            else {
+                statement << "I = 0x50 + 5 * " << reg(X) << ";";
+            }
+            break;
+    }
+    if (isTerminator(operationCode) && (operationCode & 0xF000) != 0x1000) {
+        statement << hex(address + 4, 3) << " : " << hex(address + 2, 3) << ";";
+    }
+
+    os << "    // " << hex(address, 3) << ": " << hex(operationCode, 4).substr(2) << " " << disassemble(operationCode) << "\n";
+    if (isTerminator(operationCode)) {
+        os << "    *indexRegistry = I;\n";
+    }
+    os << "    " << statement.str() << "\n";
+}
+
+void Recompiler::write(std::ostream& os, const std::string& name) const {
+    os << "// Generated by chip8-recompile, compile and link it to run " << name << " with Backend::Aot\n";
+    os << "#include <aot.hpp>\n\n";
+    os << "namespace {\n\n";
+
+    os << "const Byte GAME[] = {";
+    for (size_t byte = 0; byte < mSize; byte++) {
+        os << (byte % 16 == 0 ? "\n    " : " ") << hex(mData[byte], 2) << ",";
+    }
+    os << "\n};\n\n";
+
+    for (const Block& block : mBlocks) {
+        os << "Word block" << hex(block.address, 3).substr(2) << "([[maybe_unused]] Byte* V, Word* indexRegistry) {\n";
+        os << "    Word I = *indexRegistry;\n";
+        int address = block.address;
+        for (int instruction = 0; instruction < block.instructions; instruction++, address += 2) {
+            writeInstruction(os, address);
+        }
+        if (!isTerminator(getOperationCode(address - 2))) {
+            os << "    *indexRegistry = I;\n";
+            os << "    return " << hex(address, 3) << ";\n";
+        }
+        os << "}\n\n";
+    }
+
+    if (!mBlocks.empty()) {
+        os << "const AotBlock BLOCKS[] = {\n";
+        for (const Block& block : mBlocks) {
+            os << "    {" << hex(block.address, 3) << ", " << hex(block.last, 3) << ", " << block.instructions
+               << ", block" << hex(block.address, 3).substr(2) << "},\n";
+        }
+        os << "};\n\n";
+    }
+
+    std::string escaped;
+    for (const char character : name) {
+        escaped += character == '"' || character == '\\' ? '_' : character;
+    }
+    os << "const AotProgram PROGRAM = {\n";
+    os << "    \"" << escaped << "\", " << hex(Rom::hash(mData, mSize), 16) << "ULL, " << mSize << ", "
+       << getProfileEnumerator(mProfile) << ", GAME, " << (mBlocks.empty() ? "nullptr" : "BLOCKS") << ", " << mBlocks.size() << "\n";
+    os << "};\n\n";
+    os << "[[maybe_unused]] const bool REGISTERED = registerAotProgram(&PROGRAM);\n\n";
+    os << "}\n";
+}
+
+void Recompiler::writeListing(std::ostream& os) const {
+    auto block = mBlocks.begin();
+    for (const Word address : mReached) {
+        while (block != mBlocks.end() && block->address < address) {
+            ++block;
+        }
+        const Word operationCode = getOperationCode(address);
+        os << (block != mBlocks.end() && block->address == address ? "> " : "  ")
+           << hex(address, 3) << ": " << hex(operationCode, 4).substr(2) << "  " << disassemble(operationCode) << "\n";
+    }
+}
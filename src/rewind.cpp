@@ -0,0 +1,166 @@
+#include "rewind.hpp"
+
+#include <algorithm>
+
+// Encoded frames are a sequence of (unchanged bytes, changed bytes, XOR of the changed bytes),
+// the counts written 7 bits at a time with the high bit set on every byte but the last.
+static void writeCount(std::vector<Byte>& data, size_t count) {
+    while (count >= 0x80) {
+        data.push_back(Byte(count | 0x80));
+        count >>= 7;
+    }
+    data.push_back(Byte(count));
+}
+
+static size_t readCount(const std::vector<Byte>& data, size_t& offset) {
+    size_t count = 0;
+    for (int shift = 0; offset < data.size(); shift += 7) {
+        const Byte byte = data[offset++];
+        count |= size_t(byte & 0x7F) << shift;
+        if ((byte & 0x80) == 0) {
+            break;
+        }
+    }
+    return count;
+}
+
+Rewind::Rewind(const size_t maxFrames, const size_t budgetBytes, const size_t keyframeInterval) :
+mSinceKeyframe(0), mKeyframes(0), mBytes(0), mMaxFrames(maxFrames), mBudgetBytes(budgetBytes), mKeyframeInterval(std::max<size_t>(keyframeInterval, 1))
+{
+}
+
+void Rewind::encode(const std::vector<Byte>& state, const std::vector<Byte>& base, std::vector<Byte>& data) {
+    data.clear();
+
+    size_t offset = 0;
+    while (offset < state.size()) {
+        const size_t unchangedStart = offset;
+        while (offset < state.size() && state[offset] == base[offset]) {
+            offset++;
+        }
+        if (offset == state.size()) {
+            break;
+        }
+
+        // A run of changed bytes ends at the first two unchanged bytes in a row, a single one is cheaper kept
+        const size_t changedStart = offset;
+        while (offset < state.size() && (state[offset] != base[offset]
+            || (offset + 1 < state.size() && state[offset + 1] != base[offset + 1]))) {
+            offset++;
+        }
+
+        writeCount(data, changedStart - unchangedStart);
+        writeCount(data, offset - changedStart);
+        for (size_t byte = changedStart; byte < offset; byte++) {
+            data.push_back(state[byte] ^ base[byte]);
+        }
+    }
+}
+
+void Rewind::decode(const std::vector<Byte>& data, std::vector<Byte>& state) {
+    // state holds the base, the changes are applied in place
+    size_t offset = 0;
+    size_t position = 0;
+    while (offset < data.size()) {
+        position += readCount(data, offset);
+        const size_t changed = readCount(data, offset);
+        for (size_t byte = 0; byte < changed && offset < data.size() && position < state.size(); byte++) {
+            state[position++] ^= data[offset++];
+        }
+    }
+}
+
+void Rewind::push(const Chip8::State& state) {
+    std::vector<Byte> serialized = Chip8::serializeState(state);
+
+    Frame frame;
+    frame.size = serialized.size();
+    if (mKeyframes == 0 || mSinceKeyframe + 1 >= mKeyframeInterval || serialized.size() != mKeyframe.size()) {
+        mZeros.assign(serialized.size(), 0);
+        encode(serialized, mZeros, frame.data);
+        frame.keyframe = true;
+
+        mKeyframe = std::move(serialized);
+        mSinceKeyframe = 0;
+        mKeyframes++;
+    }
+    else {
+        encode(serialized, mKeyframe, frame.data);
+        frame.keyframe = false;
+        mSinceKeyframe++;
+    }
+    mBytes += frame.data.size();
+    mFrames.push_back(std::move(frame));
+
+    // Frames depend on their keyframe, so the oldest keyframe leaves together with its frames
+    while ((mFrames.size() > mMaxFrames || mBytes > mBudgetBytes) && mKeyframes > 1) {
+        do {
+            mKeyframes -= mFrames.front().keyframe ? 1 : 0;
+            mBytes -= mFrames.front().data.size();
+            mFrames.pop_front();
+        } while (!mFrames.front().keyframe);
+    }
+}
+
+bool Rewind::pop(Chip8::State& state) {
+    if (mFrames.empty()) {
+        return false;
+    }
+
+    Frame& frame = mFrames.back();
+    std::vector<Byte> serialized = mKeyframe;
+    if (!frame.keyframe) {
+        decode(frame.data, serialized);
+    }
+
+    const bool keyframe = frame.keyframe;
+    mBytes -= frame.data.size();
+    mFrames.pop_back();
+
+    if (keyframe) {
+        mKeyframes--;
+        restoreKeyframe();
+    }
+    else {
+        mSinceKeyframe--;
+    }
+
+    return Chip8::deserializeState(serialized, state);
+}
+
+void Rewind::restoreKeyframe() {
+    // Decodes the keyframe the remaining frames refer to, once every mKeyframeInterval frames while rewinding
+    mSinceKeyframe = 0;
+    for (auto frame = mFrames.rbegin(); frame != mFrames.rend(); ++frame) {
+        if (frame->keyframe) {
+            mKeyframe.assign(frame->size, 0);
+            decode(frame->data, mKeyframe);
+            return;
+        }
+        mSinceKeyframe++;
+    }
+    mKeyframe.clear();
+}
+
+void Rewind::clear() {
+    mFrames.clear();
+    mKeyframe.clear();
+    mSinceKeyframe = 0;
+    mKeyframes = 0;
+    mBytes = 0;
+}
+
+size_t Rewind::getFrames() const {
+    return mFrames.size();
+}
+
+size_t Rewind::getBytes() const {
+    return mBytes;
+}
+
+double Rewind::getBytesPerSecond() const {
+    if (mFrames.empty()) {
+        return 0.0;
+    }
+    return double(mBytes) * 60.0 / double(mFrames.size());
+}
@@ -0,0 +1,103 @@
+#include "romcache.hpp"
+
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+std::shared_ptr<const Rom> Rom::open(const std::string& filepath) {
+    std::ifstream fs(filepath, std::ios::binary | std::ios::in | std::ios::ate);
+    if (!fs) {
+        return nullptr;
+    }
+
+    // Read in one piece, one byte more than fits is enough to reject the game
+    const std::streamoff end = fs.tellg();
+    if (end < 0 || size_t(end) > MAX_SIZE) {
+        return nullptr;
+    }
+
+    std::shared_ptr<Rom> rom(new Rom());
+    rom->mBuffer.resize(size_t(end));
+    fs.seekg(0);
+    if (!fs.read(reinterpret_cast<char*>(rom->mBuffer.data()), rom->mBuffer.size())) {
+        return nullptr;
+    }
+    rom->mHash = hash(rom->getData(), rom->getSize());
+    return rom;
+}
+
+uint64_t Rom::hash(const Byte* data, const size_t size) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (size_t byte = 0; byte < size; byte++) {
+        hash ^= data[byte];
+        hash *= 0x100000001B3;
+    }
+    return hash;
+}
+
+const Byte* Rom::getData() const {
+    return mBuffer.data();
+}
+
+size_t Rom::getSize() const {
+    return mBuffer.size();
+}
+
+uint64_t Rom::getHash() const {
+    return mHash;
+}
+
+std::shared_ptr<const Rom> RomCache::load(const std::string& filepath) const {
+    std::error_code error;
+    const auto modified = std::filesystem::last_write_time(filepath, error);
+    const uintmax_t size = error ? 0 : std::filesystem::file_size(filepath, error);
+    if (error) {
+        return nullptr;
+    }
+
+    std::lock_guard<std::mutex> lock(mMutex);
+    const auto file = mFiles.find(filepath);
+    if (file != mFiles.end() && file->second.modified == modified && file->second.size == size) {
+        return file->second.rom;
+    }
+
+    std::shared_ptr<const Rom> rom = Rom::open(filepath);
+    if (rom == nullptr) {
+        return nullptr;
+    }
+
+    // Another path with the same contents already has an image, the new copy is dropped
+    const auto same = mRoms.find(rom->getHash());
+    if (same != mRoms.end() && same->second->getSize() == rom->getSize()
+        && (rom->getSize() == 0 || std::memcmp(same->second->getData(), rom->getData(), rom->getSize()) == 0)) {
+        rom = same->second;
+    }
+    else if (same == mRoms.end()) {
+        mRoms.emplace(rom->getHash(), rom);
+    }
+
+    // The image the file had before goes when no other file has it, so the images of mRoms stay
+    // the contents of files with their hash
+    const std::shared_ptr<const Rom> previous = file != mFiles.end() ? file->second.rom : nullptr;
+    mFiles[filepath] = {modified, size, rom};
+    if (previous != nullptr && previous != rom && std::none_of(mFiles.begin(), mFiles.end(), [&](const auto& other) {
+            return other.second.rom == previous;
+        })) {
+        const auto image = mRoms.find(previous->getHash());
+        if (image != mRoms.end() && image->second == previous) {
+            mRoms.erase(image);
+        }
+    }
+    return rom;
+}
+
+size_t RomCache::getSize() const {
+    std::lock_guard<std::mutex> lock(mMutex);
+    return mRoms.size();
+}
+
+void RomCache::clear() {
+    std::lock_guard<std::mutex> lock(mMutex);
+    mFiles.clear();
+    mRoms.clear();
+}
@@ -0,0 +1,170 @@
+#include "video.hpp"
+
+#include <algorithm>
+#include <cinttypes>
+
+// Gray level of the colour indices, matching the palette of the window
+static constexpr Byte LEVELS[4] = {0, 255, 85, 170};
+
+bool parseVideoFormat(const std::string& name, VideoFormat& format) {
+    if (name == "y4m") {
+        format = VideoFormat::Y4m;
+    }
+    else if (name == "raw") {
+        format = VideoFormat::Raw;
+    }
+    else if (name == "hash") {
+        format = VideoFormat::Hash;
+    }
+    else {
+        return false;
+    }
+    return true;
+}
+
+VideoWriter::VideoWriter(const std::string& filepath, const VideoFormat format, const bool dropWhenFull)
+    : mFile(filepath == "-" ? stdout : std::fopen(filepath.c_str(), format == VideoFormat::Hash ? "w" : "wb")),
+      mFormat(format),
+      mDropWhenFull(dropWhenFull) {
+    if (mFile == nullptr) {
+        return;
+    }
+    if (mFormat == VideoFormat::Y4m) {
+        std::fputs("YUV4MPEG2 W128 H64 F60:1 Ip A1:1 Cmono\n", mFile);
+    }
+    mWriter = std::thread(&VideoWriter::write, this);
+}
+
+VideoWriter::~VideoWriter() {
+    finish();
+}
+
+bool VideoWriter::isOpen() const {
+    return mFile != nullptr;
+}
+
+void VideoWriter::frame(const Chip8& chip8) {
+    if (mFile == nullptr) {
+        return;
+    }
+
+    const auto fill = [&](Frame& frame) {
+        frame.graphix = chip8.getGraphix();
+        frame.number = mFrames;
+        frame.highResolution = chip8.isHighResolution();
+    };
+    while (!mQueue.pushWith(fill)) {
+        if (mDropWhenFull) {
+            mDropped++;
+            mFrames++;
+            return;
+        }
+        // The writer bumps mWritten after every frame, so a full queue has room again once it changes
+        const uint64_t written = mWritten.load(std::memory_order_acquire);
+        if (mQueue.size() == QUEUE_FRAMES) {
+            mWritten.wait(written, std::memory_order_acquire);
+        }
+    }
+    mFrames++;
+    mSignals.fetch_add(1, std::memory_order_release);
+    mSignals.notify_one();
+}
+
+bool VideoWriter::finish() {
+    if (mFile == nullptr) {
+        return false;
+    }
+    if (mWriter.joinable()) {
+        mFinishing.store(true, std::memory_order_release);
+        mSignals.fetch_add(1, std::memory_order_release);
+        mSignals.notify_one();
+        mWriter.join();
+    }
+
+    const bool failed = mFailed.load() || std::fflush(mFile) != 0 || std::ferror(mFile) != 0;
+    if (mFile != stdout) {
+        std::fclose(mFile);
+    }
+    mFile = nullptr;
+    return !failed;
+}
+
+uint64_t VideoWriter::getFrames() const {
+    return mFrames;
+}
+
+uint64_t VideoWriter::getDropped() const {
+    return mDropped;
+}
+
+void VideoWriter::write() {
+    const auto encodeFrame = [this](const Frame& frame) { encode(frame); };
+    while (true) {
+        // Read before looking at the queue, a frame pushed after the look changes it and ends the wait
+        const uint64_t signals = mSignals.load(std::memory_order_acquire);
+        while (mQueue.popWith(encodeFrame)) {
+            mWritten.fetch_add(1, std::memory_order_release);
+            mWritten.notify_one();
+        }
+        if (mFinishing.load(std::memory_order_acquire) && mQueue.size() == 0) {
+            return;
+        }
+        mSignals.wait(signals, std::memory_order_acquire);
+    }
+}
+
+void VideoWriter::encode(const Frame& frame) {
+    // After a failed write the frames are still taken off the queue, so frame() never waits forever
+    if (mFailed.load(std::memory_order_relaxed)) {
+        return;
+    }
+
+    if (mFormat == VideoFormat::Hash) {
+        uint64_t hash = 0xCBF29CE484222325;
+        for (const uint64_t word : frame.graphix) {
+            for (int byte = 0; byte < 8; byte++) {
+                hash ^= (word >> (8 * byte)) & 0xFF;
+                hash *= 0x100000001B3;
+            }
+        }
+        const int width = frame.highResolution ? 128 : 64;
+        if (std::fprintf(mFile, "%" PRIu64 " %dx%d %016" PRIx64 "\n", frame.number, width, width / 2, hash) < 0) {
+            mFailed.store(true, std::memory_order_relaxed);
+        }
+        return;
+    }
+
+    if (frame.highResolution) {
+        // Two words per row of 128 pixels
+        for (int pixel = 0; pixel < 128 * 64; pixel++) {
+            const int word = pixel / 64;
+            const int bit = 63 - pixel % 64;
+            const int colour = ((frame.graphix[word] >> bit) & 1)
+                | ((frame.graphix[Chip8::PLANE_WORDS + word] >> bit) & 1) << 1;
+            mPixels[pixel] = LEVELS[colour];
+        }
+    }
+    else {
+        // One word per row of 64 pixels, every pixel becomes 2x2
+        for (int row = 0; row < 32; row++) {
+            const uint64_t first = frame.graphix[row];
+            const uint64_t second = frame.graphix[Chip8::PLANE_WORDS + row];
+            Byte* line = &mPixels[row * 2 * 128];
+            for (int column = 0; column < 64; column++) {
+                const int bit = 63 - column;
+                const Byte level = LEVELS[((first >> bit) & 1) | ((second >> bit) & 1) << 1];
+                line[2 * column] = level;
+                line[2 * column + 1] = level;
+            }
+            std::copy(line, line + 128, line + 128);
+        }
+    }
+
+    if (mFormat == VideoFormat::Y4m && std::fputs("FRAME\n", mFile) < 0) {
+        mFailed.store(true, std::memory_order_relaxed);
+        return;
+    }
+    if (std::fwrite(mPixels.data(), 1, mPixels.size(), mFile) != mPixels.size()) {
+        mFailed.store(true, std::memory_order_relaxed);
+    }
+}
@@ -0,0 +1,1335 @@
+#include "aot.hpp"
+#include "batch.hpp"
+#include "chip8.hpp"
+#include "debugger.hpp"
+#include "debugserver.hpp"
+#include "FONTSET.hpp"
+#include "lockstep.hpp"
+#include "movie.hpp"
+#include "recompiler.hpp"
+#include "rewind.hpp"
+#include "romcache.hpp"
+#include "rom.hpp"
+#include "video.hpp"
+
+#include <algorithm>
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <sstream>
+#include <iostream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#if defined(__unix__) || defined(__APPLE__)
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Conformance tests of the interpreter against hand-checked results, then of the JIT and the
+// lockstep engine against the interpreter. Runs every test, or the ones named on the command line.
+
+static int failures = 0;
+static std::string currentTest;
+
+static void check(const bool condition, const std::string& message, const int line) {
+    if (!condition) {
+        std::cerr << currentTest << ":" << line << ": " << message << std::endl;
+        failures++;
+    }
+}
+
+#define CHECK(...) check((__VA_ARGS__), #__VA_ARGS__, __LINE__)
+#define CHECK_EQ(actual, expected) \
+    check(uint64_t(actual) == uint64_t(expected), \
+          #actual " is " + std::to_string(uint64_t(actual)) + ", expected " + std::to_string(uint64_t(expected)), __LINE__)
+
+// Timers tick once every ticksPerSecond / 60 cycles, the default keeps them still in short programs
+static Chip8 load(const std::vector<Word>& program, const uint64_t ticksPerSecond = 1000000, const uint64_t seed = 1) {
+    Chip8 chip8;
+    chip8.initialize(ticksPerSecond, seed);
+    if (!chip8.loadGame(writeRom("conformance-" + currentTest, program))) {
+        check(false, "loadGame failed", __LINE__);
+    }
+    return chip8;
+}
+
+// FNV-1a over the words of both planes of the framebuffer
+static uint64_t hashGraphix(const Chip8::Graphix& graphix) {
+    uint64_t hash = 0xCBF29CE484222325;
+    for (const uint64_t row : graphix) {
+        for (int byte = 0; byte < 8; byte++) {
+            hash ^= (row >> (8 * byte)) & 0xFF;
+            hash *= 0x100000001B3;
+        }
+    }
+    return hash;
+}
+
+// Framebuffer after drawing a sprite pixel by pixel, the screen being one 2048 pixel line as in DXYN
+static void plot(Chip8::Graphix& graphix, const int x, const int y, const std::vector<Byte>& sprite) {
+    for (size_t row = 0; row < sprite.size(); row++) {
+        for (int bit = 0; bit < 8; bit++) {
+            if ((sprite[row] & (0x80 >> bit)) != 0) {
+                const int index = (x + bit + (y + int(row)) * 64) % 2048;
+                graphix[index / 64] ^= uint64_t(1) << (63 - index % 64);
+            }
+        }
+    }
+}
+
+static bool sameMachine(const Chip8& a, const Chip8& b) {
+    return a.getMemory() == b.getMemory() && a.getGraphix() == b.getGraphix() &&
+           a.getVReg() == b.getVReg() && a.getStack() == b.getStack() &&
+           a.getProgramCounter() == b.getProgramCounter() && a.getIndexRegistry() == b.getIndexRegistry() &&
+           a.getStackP() == b.getStackP() && a.getDelayTimer() == b.getDelayTimer() &&
+           a.getSoundTimer() == b.getSoundTimer() && a.getCycleCount() == b.getCycleCount();
+}
+
+static void testClearScreen() {
+    Chip8 chip8 = load({0xA050, 0xD005, 0x00E0});
+    chip8.runCycles(2);
+    CHECK(chip8.getGraphix()[0] != 0);
+
+    chip8.clearDirtyRows();
+    chip8.emulateCycle();
+    CHECK(chip8.getGraphix() == Chip8::Graphix{});
+    CHECK(chip8.getDrawFlag());
+    CHECK_EQ(chip8.getDirtyRows(), 0xFFFFFFFF);
+}
+
+static void testCallAndReturn() {
+    Chip8 chip8 = load({
+        0x2206,     // 0x200: call 0x206
+        0x6101,     // 0x202
+        0x1204,     // 0x204: loop
+        0x6201,     // 0x206
+        0x00EE,     // 0x208: return
+    });
+    chip8.emulateCycle();
+    CHECK_EQ(chip8.getProgramCounter(), 0x206);
+    CHECK_EQ(chip8.getStackP(), 1);
+    CHECK_EQ(chip8.getStack()[0], 0x200);
+
+    chip8.runCycles(2);
+    CHECK_EQ(chip8.getProgramCounter(), 0x202);
+    CHECK_EQ(chip8.getStackP(), 0);
+
+    chip8.runCycles(10);
+    CHECK_EQ(chip8.getProgramCounter(), 0x204);
+    CHECK_EQ(chip8.getVReg()[1], 1);
+    CHECK_EQ(chip8.getVReg()[2], 1);
+}
+
+static void testSkips() {
+    Chip8 chip8 = load({
+        0x6005, 0x6105, 0x6206,
+        0x3005, 0x6A01,     // Taken, VA stays 0
+        0x3006, 0x6B01,     // Not taken
+        0x4006, 0x6C01,     // Taken
+        0x4005, 0x6D01,     // Not taken
+        0x5010, 0x6E01,     // Taken
+        0x5020, 0x6301,     // Not taken
+        0x9020, 0x6401,     // Taken
+        0x9010, 0x6501,     // Not taken
+        0x1224,             // Loop
+    });
+    chip8.runCycles(100);
+    CHECK_EQ(chip8.getProgramCounter(), 0x224);
+
+    const std::array<Byte, 16>& V = chip8.getVReg();
+    CHECK_EQ(V[0xA], 0);
+    CHECK_EQ(V[0xB], 1);
+    CHECK_EQ(V[0xC], 0);
+    CHECK_EQ(V[0xD], 1);
+    CHECK_EQ(V[0xE], 0);
+    CHECK_EQ(V[0x3], 1);
+    CHECK_EQ(V[0x4], 0);
+    CHECK_EQ(V[0x5], 1);
+}
+
+static void testLoadsAndLogic() {
+    Chip8 chip8 = load({
+        0x60F0, 0x613C,
+        0x8200,             // V2 = V0
+        0x8310, 0x8301,     // V3 = V1 | V0
+        0x8410, 0x8402,     // V4 = V1 & V0
+        0x8510, 0x8503,     // V5 = V1 ^ V0
+        0x6F07, 0x76FF, 0x7602, // V6 wraps to 1 without touching VF
+    });
+    chip8.runCycles(12);
+
+    const std::array<Byte, 16>& V = chip8.getVReg();
+    CHECK_EQ(V[2], 0xF0);
+    CHECK_EQ(V[3], 0xFC);
+    CHECK_EQ(V[4], 0x30);
+    CHECK_EQ(V[5], 0xCC);
+    CHECK_EQ(V[6], 0x01);
+    CHECK_EQ(V[0xF], 0x07);
+}
+
+// Runs 8 0 1 N with V0 = vx and V1 = vy, returns V0 and VF
+static std::pair<Byte, Byte> arithmetic(const Byte vx, const Byte vy, const Byte N) {
+    Chip8 chip8 = load({Word(0x6000 | vx), Word(0x6100 | vy), Word(0x8010 | N)});
+    chip8.runCycles(3);
+    return {chip8.getVReg()[0], chip8.getVReg()[0xF]};
+}
+
+static void testFlags() {
+    struct Case {
+        Byte vx, vy, N;
+        Byte result, flag;
+    };
+    const Case cases[] = {
+        {0x10, 0x20, 0x4, 0x30, 0},     // 8XY4: no carry
+        {0xFF, 0x02, 0x4, 0x01, 1},     // 8XY4: carry
+        {0x80, 0x80, 0x4, 0x00, 1},
+        {0x05, 0x03, 0x5, 0x02, 1},     // 8XY5: VF is 1 without borrow
+        {0x05, 0x05, 0x5, 0x00, 1},
+        {0x03, 0x05, 0x5, 0xFE, 0},     // 8XY5: borrow
+        {0x05, 0x00, 0x6, 0x02, 1},     // 8XY6: VF is the LSB shifted out
+        {0x04, 0x00, 0x6, 0x02, 0},
+        {0x04, 0xFF, 0x6, 0x02, 0},     // 8XY6: VY is ignored
+        {0x03, 0x05, 0x7, 0x02, 1},     // 8XY7: VF is 1 without borrow
+        {0x05, 0x05, 0x7, 0x00, 1},
+        {0x05, 0x03, 0x7, 0xFE, 0},     // 8XY7: borrow
+        {0x81, 0x00, 0xE, 0x02, 1},     // 8XYE: VF is the MSB shifted out
+        {0x40, 0x00, 0xE, 0x80, 0},
+    };
+    for (const Case& c : cases) {
+        const auto [result, flag] = arithmetic(c.vx, c.vy, c.N);
+        CHECK_EQ(result, c.result);
+        CHECK_EQ(flag, c.flag);
+    }
+}
+
+static void testIndex() {
+    Chip8 chip8 = load({0xA123, 0x6005, 0xF01E, 0x600A, 0xF029});
+    chip8.emulateCycle();
+    CHECK_EQ(chip8.getIndexRegistry(), 0x123);
+    chip8.runCycles(2);
+    CHECK_EQ(chip8.getIndexRegistry(), 0x128);
+    chip8.runCycles(2);
+    CHECK_EQ(chip8.getIndexRegistry(), 0x50 + 5 * 0xA);
+}
+
+static void testJumpWithOffset() {
+    Chip8 chip8 = load({
+        0x6004,     // 0x200
+        0xB208,     // 0x202: jump to 0x208 + 4
+        0x6102, 0x6102, 0x6102, 0x6102,
+        0x6101,     // 0x20C
+        0x120E,     // 0x20E: loop
+    });
+    chip8.runCycles(2);
+    CHECK_EQ(chip8.getProgramCounter(), 0x20C);
+    chip8.runCycles(10);
+    CHECK_EQ(chip8.getVReg()[1], 1);
+}
+
+static void testRandom() {
+    Chip8 chip8 = load({0xC0FF, 0xC10F, 0xC200}, 1000000, 42);
+    chip8.runCycles(3);
+
+    // VX = NN & the top byte of the next number, also drawn when NN is 0
+    RandomEngine random(42);
+    const Byte first = random() >> 24;
+    const Byte second = random() >> 24;
+    CHECK_EQ(chip8.getVReg()[0], first);
+    CHECK_EQ(chip8.getVReg()[1], second & 0x0F);
+    CHECK_EQ(chip8.getVReg()[2], 0);
+
+    random();
+    CHECK_EQ(chip8.getRandomEngine().getState(), random.getState());
+}
+
+static void testDraw() {
+    Chip8 chip8 = load({0xA050, 0xD015, 0xD015});
+    chip8.runCycles(2);
+
+    Chip8::Graphix expected = {};
+    plot(expected, 0, 0, {0xF0, 0x90, 0x90, 0x90, 0xF0});
+    CHECK_EQ(hashGraphix(chip8.getGraphix()), hashGraphix(expected));
+    CHECK_EQ(chip8.getGraphix()[0], uint64_t(0xF0) << 56);
+    CHECK_EQ(chip8.getVReg()[0xF], 0);
+    CHECK_EQ(chip8.getDirtyRows() & 0x1F, 0x1F);
+    CHECK(chip8.getDrawFlag());
+
+    // Drawing the same sprite again erases it and collides
+    chip8.emulateCycle();
+    CHECK(chip8.getGraphix() == Chip8::Graphix{});
+    CHECK_EQ(chip8.getVReg()[0xF], 1);
+}
+
+static void testDrawCollision() {
+    // Two sprites side by side don't collide, a third overlapping both does
+    Chip8 chip8 = load({0xA050, 0x6000, 0x6108, 0xD0A5, 0xD1A5, 0x3F00, 0x7201, 0x6002, 0xD0A5});
+    chip8.runCycles(7);
+    CHECK_EQ(chip8.getVReg()[2], 0);
+
+    chip8.emulateCycle();
+    CHECK_EQ(chip8.getVReg()[0xF], 1);
+
+    Chip8::Graphix expected = {};
+    plot(expected, 0, 0, {0xF0, 0x90, 0x90, 0x90, 0xF0});
+    plot(expected, 8, 0, {0xF0, 0x90, 0x90, 0x90, 0xF0});
+    plot(expected, 2, 0, {0xF0, 0x90, 0x90, 0x90, 0xF0});
+    CHECK_EQ(hashGraphix(chip8.getGraphix()), hashGraphix(expected));
+}
+
+static void testDrawWrap() {
+    // Past the right edge a sprite continues on the next row, past the bottom on the top rows
+    Chip8 chip8 = load({0xA050, 0x603E, 0x611E, 0xD015, 0x6203, 0x6307, 0xD235});
+    chip8.clearDirtyRows();
+    chip8.runCycles(4);
+
+    Chip8::Graphix expected = {};
+    plot(expected, 62, 30, {0xF0, 0x90, 0x90, 0x90, 0xF0});
+    CHECK_EQ(hashGraphix(chip8.getGraphix()), hashGraphix(expected));
+    CHECK_EQ(chip8.getGraphix()[30], 0x3);
+    CHECK_EQ(chip8.getGraphix()[31], (uint64_t(0xC) << 60) | 0x2);
+    CHECK_EQ(chip8.getGraphix()[0], (uint64_t(0x4) << 60) | 0x2);
+    CHECK_EQ(chip8.getDirtyRows(), 0xC000000F);
+    CHECK_EQ(chip8.getVReg()[0xF], 0);
+
+    chip8.runCycles(3);
+    plot(expected, 3, 7, {0xF0, 0x90, 0x90, 0x90, 0xF0});
+    CHECK_EQ(hashGraphix(chip8.getGraphix()), hashGraphix(expected));
+
+    // FX1E moves I past 0xFFF, the sprite is read from the start of memory as if I was 0, also when VF
+    // gives the position
+    for (const QuirkProfile profile : {QuirkProfile::Legacy, QuirkProfile::CosmacVip}) {
+        Chip8 past = load({0x60FF, 0xA000, 0xF055, 0xAFFF, 0x6101, 0xF11E, 0x6200, 0xD221, 0x6F00, 0xDF21});
+        Chip8 start = load({0x60FF, 0xA000, 0xF055, 0xA000, 0x6101, 0x6100, 0x6200, 0xD221, 0x6F00, 0xDF21});
+        past.setQuirkProfile(profile);
+        start.setQuirkProfile(profile);
+        past.runCycles(8);
+        CHECK_EQ(past.getGraphix()[0], uint64_t(0xFF) << 56);
+        past.runCycles(2);
+        start.runCycles(10);
+        CHECK_EQ(hashGraphix(past.getGraphix()), hashGraphix(start.getGraphix()));
+    }
+}
+
+static void testFontGrid() {
+    // Every digit of the font in a grid, drawn by a loop
+    Chip8 chip8 = load({
+        0x6000,     // 0x200: V0 = digit
+        0x6100,     // 0x202: V1 = x
+        0x6200,     // 0x204: V2 = y
+        0xF029,     // 0x206
+        0xD125,     // 0x208
+        0x7001,     // 0x20A
+        0x7108,     // 0x20C
+        0x3140,     // 0x20E: next row after 8 digits
+        0x1206,     // 0x210
+        0x6100,     // 0x212
+        0x7208,     // 0x214
+        0x3010,     // 0x216
+        0x1206,     // 0x218
+        0x121A,     // 0x21A: done
+    });
+    chip8.runCycles(200);
+    CHECK_EQ(chip8.getProgramCounter(), 0x21A);
+
+    Chip8::Graphix expected = {};
+    for (int digit = 0; digit < 16; digit++) {
+        plot(expected, (digit % 8) * 8, (digit / 8) * 8, std::vector<Byte>(FONTSET.begin() + 5 * digit, FONTSET.begin() + 5 * digit + 5));
+    }
+    CHECK_EQ(hashGraphix(chip8.getGraphix()), hashGraphix(expected));
+    CHECK_EQ(hashGraphix(chip8.getGraphix()), 0x1B3BA4B0D31307B5);
+}
+
+static void testKeys() {
+    const std::vector<Word> program = {0x6003, 0xE09E, 0x6101, 0xE0A1, 0x6201, 0x120A};
+
+    Chip8 released = load(program);
+    released.runCycles(6);
+    CHECK_EQ(released.getVReg()[1], 1);
+    CHECK_EQ(released.getVReg()[2], 0);
+
+    Chip8 pressed = load(program);
+    std::array<bool, 16> keys = {};
+    keys[3] = true;
+    pressed.setKeys(keys);
+    pressed.runCycles(6);
+    CHECK_EQ(pressed.getVReg()[1], 0);
+    CHECK_EQ(pressed.getVReg()[2], 1);
+}
+
+static void testWaitForKey() {
+    Chip8 chip8 = load({0xF30A, 0x1202});
+    chip8.runCycles(10);
+    CHECK_EQ(chip8.getProgramCounter(), 0x200);
+    CHECK_EQ(chip8.getCycleCount(), 10);
+
+    std::array<bool, 16> keys = {};
+    keys[7] = true;
+    chip8.setKeys(keys);
+    chip8.emulateCycle();
+    CHECK_EQ(chip8.getProgramCounter(), 0x202);
+    CHECK_EQ(chip8.getVReg()[3], 7);
+}
+
+static void testIdleLoops() {
+    // Waits for a key, then twice on the delay timer with 3XNN and 4XNN, then jumps to itself
+    const std::vector<Word> program = {
+        0xF30A,     // 0x200
+        0x6A1E,     // 0x202
+        0xFA15,     // 0x204: delay = 30
+        0xF007,     // 0x206
+        0x3000,     // 0x208: skip once the delay is 0
+        0x1206,     // 0x20A
+        0xFA15,     // 0x20C: delay = 30
+        0xF107,     // 0x20E
+        0x410F,     // 0x210: skip once the delay is not 15
+        0x120E,     // 0x212
+        0x6201,     // 0x214
+        0x1216,     // 0x216
+    };
+
+    // Fast-forwarding runs end in the same states as single instructions, whatever the backend
+    const uint64_t steps[] = {1, 5000, 3, 777, 20000, 12, 50000};
+    for (const Backend backend : {Backend::Interpreter, Backend::Jit}) {
+        Chip8 fast = load(program, 100000, 3);
+        Chip8 single = load(program, 100000, 3);
+        fast.setBackend(backend);
+        std::array<bool, 16> keys = {};
+        for (int repeat = 0; repeat < 8; repeat++) {
+            keys[5] = repeat == 1;
+            fast.setKeys(keys);
+            single.setKeys(keys);
+            CHECK_EQ(fast.isWaitingForKey(), repeat == 0);
+            for (const uint64_t cycles : steps) {
+                fast.runCycles(cycles);
+                for (uint64_t cycle = 0; cycle < cycles; cycle++) {
+                    single.emulateCycle();
+                }
+                CHECK(sameMachine(fast, single));
+            }
+        }
+        CHECK_EQ(fast.getProgramCounter(), 0x216);
+        CHECK_EQ(fast.getVReg()[2], 1);
+        CHECK(fast.getElidedCycles() > fast.getCycleCount() * 9 / 10);
+        CHECK_EQ(single.getElidedCycles(), 0);
+    }
+}
+
+static void testTimers() {
+    // At 60 instructions per second the timers tick after every instruction
+    Chip8 chip8 = load({0x600A, 0xF015, 0xF107, 0x6205, 0xF218, 0x120A}, 60);
+    chip8.runCycles(3);
+    CHECK_EQ(chip8.getVReg()[1], 9);
+    CHECK_EQ(chip8.getDelayTimer(), 8);
+
+    chip8.runCycles(2);
+    CHECK_EQ(chip8.getSoundTimer(), 4);
+    CHECK_EQ(chip8.getDelayTimer(), 6);
+    CHECK(chip8.isSoundActive());
+
+    chip8.runCycles(4);
+    CHECK_EQ(chip8.getSoundTimer(), 0);
+    CHECK(!chip8.isSoundActive());
+    chip8.runCycles(10);
+    CHECK_EQ(chip8.getDelayTimer(), 0);
+
+    // Rates that are no multiple of 60 tick exactly 60 times per emulated second
+    Chip8 slow = load({0x60FF, 0xF015, 0x1204}, 100);
+    slow.runCycles(101);
+    CHECK_EQ(slow.getDelayTimer(), 255 - 60);
+
+    // Zero instructions per second runs as one, the timers tick 60 times per instruction and a frame
+    // ends without a whole instruction
+    Chip8 stopped = load({0x60FF, 0xF015, 0x1204}, 0);
+    stopped.runCycles(2);
+    CHECK_EQ(stopped.getDelayTimer(), 255 - 60);
+    stopped.runFrame();
+    CHECK_EQ(stopped.getCycleCount(), 2);
+}
+
+static void testBinaryCodedDecimal() {
+    const std::pair<Byte, std::array<Byte, 3>> cases[] = {
+        {254, {2, 5, 4}}, {100, {1, 0, 0}}, {9, {0, 0, 9}}, {0, {0, 0, 0}},
+    };
+    for (const auto& [value, digits] : cases) {
+        Chip8 chip8 = load({Word(0x6500 | value), 0xA300, 0xF533});
+        chip8.runCycles(3);
+        CHECK_EQ(chip8.getMemory()[0x300], digits[0]);
+        CHECK_EQ(chip8.getMemory()[0x301], digits[1]);
+        CHECK_EQ(chip8.getMemory()[0x302], digits[2]);
+        CHECK_EQ(chip8.getIndexRegistry(), 0x300);
+    }
+}
+
+static void testStoreAndLoad() {
+    Chip8 chip8 = load({
+        0x6001, 0x6102, 0x6203, 0x6304,
+        0xA300, 0xF355,                 // Store V0 to V3
+        0x6000, 0x6100, 0x6200, 0x6300,
+        0xF265,                         // Load V0 to V2, V3 stays 0
+    });
+    chip8.runCycles(6);
+    for (int i = 0; i < 4; i++) {
+        CHECK_EQ(chip8.getMemory()[0x300 + i], i + 1);
+    }
+    CHECK_EQ(chip8.getMemory()[0x304], 0);
+    CHECK_EQ(chip8.getIndexRegistry(), 0x300);
+
+    chip8.runCycles(5);
+    const std::array<Byte, 16>& V = chip8.getVReg();
+    CHECK_EQ(V[0], 1);
+    CHECK_EQ(V[1], 2);
+    CHECK_EQ(V[2], 3);
+    CHECK_EQ(V[3], 0);
+    CHECK_EQ(chip8.getIndexRegistry(), 0x300);
+}
+
+static void testMemoryWrap() {
+    // Stores and loads starting at the last two bytes of memory wrap around to address 0 in every profile
+    for (int number = 0; isQuirkProfile(number); number++) {
+        const QuirkProfile profile = QuirkProfile(number);
+        const Quirks quirks = getQuirks(profile);
+        const Word top = Word(getMemorySize(quirks) - 1);
+
+        std::vector<Word> program = {0x6001, 0x6102, 0x6203, 0x6304};
+        auto setIndex = [&](const Word address) {
+            if (quirks.instructionSet == Quirks::InstructionSet::XoChip) {
+                program.insert(program.end(), {0xF000, address});
+            }
+            else {
+                program.push_back(0xA000 | address);
+            }
+        };
+        setIndex(top - 1);
+        program.push_back(0xF355);      // Store V0 to V3 at top - 1, top, 0 and 1
+        program.insert(program.end(), {0x6000, 0x6100, 0x6200, 0x6300});
+        setIndex(top - 1);
+        program.push_back(0xF365);      // Load them back
+        program.push_back(0x647B);
+        setIndex(top);
+        program.push_back(0xF433);      // BCD of 123 at top, 0 and 1
+        program.push_back(Word(0x1000 | (0x200 + 2 * program.size())));
+
+        Chip8 chip8;
+        chip8.setQuirkProfile(profile);
+        chip8.initialize(700, 1);
+        CHECK(chip8.loadGame(writeRom("conformance-" + currentTest, program)));
+        chip8.runCycles(program.size());
+
+        const std::vector<Byte>& memory = chip8.getMemory();
+        const std::array<Byte, 16>& V = chip8.getVReg();
+        for (int i = 0; i < 4; i++) {
+            CHECK_EQ(V[i], i + 1);
+        }
+        CHECK_EQ(memory[top - 1], 1);
+        CHECK_EQ(memory[top], 1);
+        CHECK_EQ(memory[0], 2);
+        CHECK_EQ(memory[1], 3);
+    }
+}
+
+static void testSelfModifyingCode() {
+    Chip8 chip8 = load(SELF_MODIFYING_ROM);
+    chip8.runCycles(100);
+    CHECK_EQ(chip8.getProgramCounter(), 0x20A);
+    CHECK_EQ(chip8.getVReg()[4], 5 + 9);
+
+    Chip8 jit = load(SELF_MODIFYING_ROM);
+    CHECK(jit.setBackend(Backend::Jit));
+    jit.runCycles(100);
+    CHECK_EQ(jit.getVReg()[4], 5 + 9);
+}
+
+static void testUnknownOpcode() {
+    // Unknown instructions are not skipped, the machine stays on them
+    Chip8 chip8 = load({0x6001, 0xE0FF});
+    chip8.runCycles(5);
+    CHECK_EQ(chip8.getProgramCounter(), 0x202);
+    CHECK_EQ(chip8.getCycleCount(), 5);
+    CHECK_EQ(chip8.getCounters().unknownOpcodes, 4);
+}
+
+// Runs program for cycles with the quirks of profile
+static Chip8 runWithQuirks(const QuirkProfile profile, const std::vector<Word>& program, const uint64_t cycles) {
+    Chip8 chip8 = load(program);
+    chip8.setQuirkProfile(profile);
+    chip8.runCycles(cycles);
+    return chip8;
+}
+
+static void testQuirks() {
+    const QuirkProfile legacy = QuirkProfile::Legacy;
+    const QuirkProfile vip = QuirkProfile::CosmacVip;
+    const QuirkProfile chip48 = QuirkProfile::Chip48;
+    const QuirkProfile schip = QuirkProfile::SuperChip;
+
+    // 8XY6/8XYE shift VX in place or VY into VX
+    const std::vector<Word> shift = {0x6181, 0x8016, 0x6281, 0x832E};
+    for (const QuirkProfile profile : {legacy, vip}) {
+        const Chip8 chip8 = runWithQuirks(profile, shift, 4);
+        const bool readsVY = getQuirks(profile).shiftReadsVY;
+        CHECK_EQ(chip8.getVReg()[0], readsVY ? 0x40 : 0x00);
+        CHECK_EQ(chip8.getVReg()[3], readsVY ? 0x02 : 0x00);
+        CHECK_EQ(chip8.getVReg()[0xF], readsVY ? 1 : 0);
+    }
+
+    // VF as an operand sees the flag when it is written first
+    const std::vector<Word> flagOrder = {0x6001, 0x6FFF, 0x80F4, 0x6120, 0x6FFF, 0x8F14};
+    Chip8 chip8 = runWithQuirks(legacy, flagOrder, 3);
+    CHECK_EQ(chip8.getVReg()[0], 0x02);
+    chip8.runCycles(3);
+    CHECK_EQ(chip8.getVReg()[0xF], 0x21);
+    chip8 = runWithQuirks(schip, flagOrder, 3);
+    CHECK_EQ(chip8.getVReg()[0], 0x00);
+    CHECK_EQ(chip8.getVReg()[0xF], 1);
+    chip8.runCycles(3);
+    CHECK_EQ(chip8.getVReg()[0xF], 1);
+
+    // 8XY1/8XY2/8XY3 reset VF on the COSMAC VIP only
+    const std::vector<Word> logic = {0x6F05, 0x8011, 0x6F05, 0x8012, 0x6F05, 0x8013};
+    for (const QuirkProfile profile : {legacy, vip}) {
+        for (uint64_t cycles = 2; cycles <= 6; cycles += 2) {
+            CHECK_EQ(runWithQuirks(profile, logic, cycles).getVReg()[0xF], profile == vip ? 0 : 5);
+        }
+    }
+
+    // FX55/FX65 leave I, or move it by X or X + 1
+    const std::vector<Word> loadStore = {0xA300, 0xF255, 0xF265};
+    const std::pair<QuirkProfile, Word> indexes[] = {{legacy, 0x300}, {schip, 0x300}, {chip48, 0x304}, {vip, 0x306}};
+    for (const auto& [profile, index] : indexes) {
+        CHECK_EQ(runWithQuirks(profile, loadStore, 3).getIndexRegistry(), index);
+    }
+
+    // BNNN adds V0, BXNN adds VX
+    const std::vector<Word> jump = {0x6004, 0x6208, 0xB210};
+    CHECK_EQ(runWithQuirks(legacy, jump, 3).getProgramCounter(), 0x214);
+    CHECK_EQ(runWithQuirks(vip, jump, 3).getProgramCounter(), 0x214);
+    CHECK_EQ(runWithQuirks(chip48, jump, 3).getProgramCounter(), 0x218);
+    CHECK_EQ(runWithQuirks(schip, jump, 3).getProgramCounter(), 0x218);
+
+    // Clipping wraps the position but cuts the sprite at the edges
+    const std::vector<Word> clip = {0xA050, 0x603E, 0x611E, 0xD015, 0x6242, 0x6321, 0xD235};
+    chip8 = runWithQuirks(vip, clip, 4);
+    Chip8::Graphix expected = {};
+    expected[30] = 0x3;
+    expected[31] = 0x2;
+    CHECK(chip8.getGraphix() == expected);
+    chip8.runCycles(3);
+    plot(expected, 2, 1, {0xF0, 0x90, 0x90, 0x90, 0xF0});
+    CHECK_EQ(hashGraphix(chip8.getGraphix()), hashGraphix(expected));
+    CHECK_EQ(chip8.getVReg()[0xF], 0);
+
+    // Changing the profile decodes the loaded program again
+    chip8 = load(shift);
+    chip8.setQuirkProfile(vip);
+    CHECK_EQ(chip8.getQuirkProfile(), vip);
+    chip8.runCycles(2);
+    CHECK_EQ(chip8.getVReg()[0], 0x40);
+}
+
+static void testHighResolution() {
+    // A 16x16 sprite at column 60 spans both words of a 128 pixel row
+    const std::vector<Word> scroll = {
+        0x00FF, 0x603C, 0x6100, 0xA210, 0xD010, 0x00FB, 0x00C4, 0x00FC,
+        0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003,
+        0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003,
+    };
+    for (const QuirkProfile profile : {QuirkProfile::SuperChip, QuirkProfile::XoChip}) {
+        Chip8 chip8 = runWithQuirks(profile, scroll, 5);
+        CHECK(chip8.isHighResolution());
+        CHECK_EQ(chip8.getWidth(), 128);
+        CHECK_EQ(chip8.getGraphix()[0], 0xC);
+        CHECK_EQ(chip8.getGraphix()[1], 0x0030000000000000);
+        CHECK_EQ(chip8.getGraphix()[2 * 15], 0xC);
+        CHECK_EQ(chip8.getGraphix()[2 * 16], 0);
+        CHECK_EQ(chip8.getVReg()[0xF], 0);
+
+        // Scrolling right carries the bits of the left word into the right one
+        chip8.runCycles(1);
+        CHECK_EQ(chip8.getGraphix()[0], 0);
+        CHECK_EQ(chip8.getGraphix()[1], 0xC003000000000000);
+
+        chip8.runCycles(1);
+        CHECK_EQ(chip8.getGraphix()[1], 0);
+        CHECK_EQ(chip8.getGraphix()[2 * 4 + 1], 0xC003000000000000);
+        CHECK_EQ(chip8.getGraphix()[2 * 19 + 1], 0xC003000000000000);
+        CHECK_EQ(chip8.getGraphix()[2 * 20 + 1], 0);
+
+        chip8.runCycles(1);
+        CHECK_EQ(chip8.getGraphix()[2 * 4], 0xC);
+        CHECK_EQ(chip8.getGraphix()[2 * 4 + 1], 0x0030000000000000);
+        CHECK_EQ(chip8.getUnpackedGraphix().size(), 128 * 64);
+    }
+
+    // Past the right and bottom edges SUPER-CHIP clips and XO-CHIP wraps
+    const std::vector<Word> edge = {
+        0x00FF, 0x607C, 0x613C, 0xA20A, 0xD010,
+        0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003,
+        0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003, 0xC003,
+    };
+    Chip8 chip8 = runWithQuirks(QuirkProfile::SuperChip, edge, 5);
+    CHECK_EQ(chip8.getGraphix()[2 * 60], 0);
+    CHECK_EQ(chip8.getGraphix()[2 * 60 + 1], 0xC);
+    CHECK_EQ(chip8.getGraphix()[1], 0);
+    chip8 = runWithQuirks(QuirkProfile::XoChip, edge, 5);
+    CHECK_EQ(chip8.getGraphix()[2 * 60], 0x0030000000000000);
+    CHECK_EQ(chip8.getGraphix()[2 * 60 + 1], 0xC);
+    CHECK_EQ(chip8.getGraphix()[0], 0x0030000000000000);
+    CHECK_EQ(chip8.getGraphix()[1], 0xC);
+
+    // Switching back to low resolution clears the screen
+    chip8 = runWithQuirks(QuirkProfile::SuperChip, {0x00FF, 0x00FE}, 2);
+    CHECK(!chip8.isHighResolution());
+    CHECK_EQ(chip8.getUnpackedGraphix().size(), 64 * 32);
+}
+
+static void testXoChip() {
+    const std::vector<Word> program = {
+        0xF000, 0xFF00,                 // I = 0xFF00, past 4 KB
+        0x6011, 0x6122, 0x6233,
+        0x5022,                         // Store V0 to V2
+        0x6300, 0x3300,                 // Skips the whole F000 NNNN
+        0xF000, 0x0000,
+        0x5453,                         // Load V4 to V5
+        0xF201, 0xA050, 0xD015,         // Draw 0 on the second plane only
+        0xF301, 0x00E0,
+    };
+    Chip8 chip8 = runWithQuirks(QuirkProfile::XoChip, program, 8);
+    CHECK_EQ(chip8.getMemory().size(), 0x10000);
+    CHECK_EQ(chip8.getIndexRegistry(), 0xFF00);
+    CHECK_EQ(chip8.getMemory()[0xFF00], 0x11);
+    CHECK_EQ(chip8.getMemory()[0xFF01], 0x22);
+    CHECK_EQ(chip8.getMemory()[0xFF02], 0x33);
+    CHECK_EQ(chip8.getVReg()[4], 0x11);
+    CHECK_EQ(chip8.getVReg()[5], 0x22);
+    CHECK_EQ(chip8.getProgramCounter(), 0x216);
+
+    chip8.runCycles(3);
+    CHECK_EQ(chip8.getGraphix()[2], 0);
+    CHECK_EQ(chip8.getGraphix()[Chip8::PLANE_WORDS + 2], (uint64_t(0xF0) << 56) >> 17);
+    CHECK_EQ(chip8.getUnpackedGraphix()[2 * 64 + 17], 2);
+
+    // 64 KB states survive serialization and resize the machine they are loaded into
+    Chip8::State restored;
+    CHECK(Chip8::deserializeState(Chip8::serializeState(chip8.saveState()), restored));
+    Chip8 other = load({0x1200});
+    other.setQuirkProfile(QuirkProfile::XoChip);
+    other.loadState(restored);
+    CHECK(sameMachine(chip8, other));
+
+    chip8.runCycles(2);
+    CHECK(chip8.getGraphix() == Chip8::Graphix{});
+}
+
+static void testJitEquivalence() {
+    const std::vector<std::vector<Word>> programs = {ALU_ROM, MIXED_ROM, SELF_MODIFYING_ROM};
+    const QuirkProfile profiles[] = {
+        QuirkProfile::Legacy, QuirkProfile::CosmacVip, QuirkProfile::Chip48, QuirkProfile::SuperChip, QuirkProfile::Modern,
+        QuirkProfile::XoChip,
+    };
+
+    // Uneven steps end runs inside blocks as well as on their boundaries
+    const uint64_t steps[] = {1, 7, 3, 64, 1000, 13, 5000};
+    for (const QuirkProfile profile : profiles) {
+        for (const std::vector<Word>& program : programs) {
+            Chip8 interpreter = load(program, 700, 7);
+            Chip8 jit = load(program, 700, 7);
+            interpreter.setQuirkProfile(profile);
+            jit.setQuirkProfile(profile);
+            CHECK(jit.setBackend(Backend::Jit));
+
+            for (int repeat = 0; repeat < 20; repeat++) {
+                for (const uint64_t cycles : steps) {
+                    const bool interpreterDrawn = interpreter.runCycles(cycles);
+                    const bool jitDrawn = jit.runCycles(cycles);
+                    CHECK_EQ(jitDrawn, interpreterDrawn);
+                }
+                CHECK(sameMachine(interpreter, jit));
+            }
+        }
+    }
+}
+
+static void testAotEquivalence() {
+    // The analysis follows the skips, jumps and the fall through after every interpreted instruction
+    const std::shared_ptr<const Rom> mixed = Rom::open(writeRom("conformance-aot-mixed", MIXED_ROM));
+    CHECK(mixed != nullptr);
+    const Recompiler recompiler(mixed->getData(), mixed->getSize(), QuirkProfile::Legacy);
+    CHECK_EQ(recompiler.getReached().size(), MIXED_ROM.size());
+    CHECK_EQ(recompiler.getBlocks().size(), 6);
+    CHECK_EQ(recompiler.getBlocks()[0].address, 0x206);
+    CHECK_EQ(recompiler.getBlocks()[1].address, 0x20A);
+    CHECK_EQ(recompiler.getBlocks()[3].address, 0x20E);
+    CHECK_EQ(recompiler.getBlocks()[3].instructions, 2);
+    CHECK_EQ(recompiler.getBlocks()[5].address, 0x21C);
+
+    // The test ROMs are compiled for every profile by the build, see chip8_recompile
+    const std::vector<std::vector<Word>> programs = {ALU_ROM, MIXED_ROM, SELF_MODIFYING_ROM};
+    const QuirkProfile profiles[] = {
+        QuirkProfile::Legacy, QuirkProfile::CosmacVip, QuirkProfile::Chip48, QuirkProfile::SuperChip, QuirkProfile::Modern,
+        QuirkProfile::XoChip,
+    };
+    const uint64_t steps[] = {1, 7, 3, 64, 1000, 13, 5000};
+    for (const QuirkProfile profile : profiles) {
+        for (const std::vector<Word>& program : programs) {
+            const std::shared_ptr<const Rom> rom = Rom::open(writeRom("conformance-aot", program));
+            const AotProgram* compiled = findAotProgram(rom->getHash(), rom->getSize(), profile);
+            CHECK(compiled != nullptr && compiled->blockCount > 0);
+            if (compiled == nullptr) {
+                continue;
+            }
+
+            Chip8 interpreter = load(program, 700, 7);
+            Chip8 aot = load(program, 700, 7);
+            interpreter.setQuirkProfile(profile);
+            aot.setQuirkProfile(profile);
+            CHECK(!aot.setAotProgram(findAotProgram(rom->getHash(), rom->getSize(), profile == QuirkProfile::Legacy ? QuirkProfile::Modern : QuirkProfile::Legacy)));
+            CHECK(aot.setAotProgram(compiled));
+            CHECK(aot.setBackend(Backend::Aot));
+
+            for (int repeat = 0; repeat < 20; repeat++) {
+                for (const uint64_t cycles : steps) {
+                    CHECK_EQ(aot.runCycles(cycles), interpreter.runCycles(cycles));
+                }
+                CHECK(sameMachine(interpreter, aot));
+            }
+        }
+    }
+}
+
+static void testLockstepEquivalence() {
+    // Self-modifying code makes the memory of lanes differ, so a group compares instructions again
+    for (const std::vector<Word>* program : {&MIXED_ROM, &ALU_ROM, &SELF_MODIFYING_ROM}) {
+        const std::string rom = writeRom("conformance-" + currentTest, *program);
+
+        std::array<uint64_t, Lockstep::LANES> seeds;
+        for (int lane = 0; lane < Lockstep::LANES; lane++) {
+            seeds[lane] = 1000 + lane;
+        }
+        static Lockstep lockstep;
+        CHECK(lockstep.loadGame(rom, 700, seeds));
+
+        std::vector<Chip8> machines(Lockstep::LANES);
+        for (int lane = 0; lane < Lockstep::LANES; lane++) {
+            machines[lane].initialize(700, seeds[lane]);
+            CHECK(machines[lane].loadGame(rom));
+
+            // Odd lanes hold a key so they take the other branch of EX9E
+            std::array<bool, 16> keys = {};
+            keys[lane % 10] = lane % 2 == 1;
+            machines[lane].setKeys(keys);
+            lockstep.setKeys(lane, keys);
+        }
+
+        for (int frame = 0; frame < 120; frame++) {
+            lockstep.runFrame();
+            for (Chip8& machine : machines) {
+                machine.runFrame();
+            }
+        }
+
+        for (int lane = 0; lane < Lockstep::LANES; lane++) {
+            const Chip8& machine = machines[lane];
+            // The lockstep engine keeps only the 4 KB and 64x32 of the CHIP-8 instruction set
+            const std::array<Byte, 4096>& memory = lockstep.getMemory(lane);
+            const std::array<uint64_t, 32>& graphix = lockstep.getGraphix(lane);
+            CHECK(std::equal(memory.begin(), memory.end(), machine.getMemory().begin(), machine.getMemory().end()));
+            CHECK(std::equal(graphix.begin(), graphix.end(), machine.getGraphix().begin()));
+            CHECK(lockstep.getVReg(lane) == machine.getVReg());
+            CHECK(lockstep.getStack(lane) == machine.getStack());
+            CHECK_EQ(lockstep.getProgramCounter(lane), machine.getProgramCounter());
+            CHECK_EQ(lockstep.getIndexRegistry(lane), machine.getIndexRegistry());
+            CHECK_EQ(lockstep.getStackP(lane), machine.getStackP());
+            CHECK_EQ(lockstep.getDelayTimer(lane), machine.getDelayTimer());
+            CHECK_EQ(lockstep.getSoundTimer(lane), machine.getSoundTimer());
+            CHECK_EQ(lockstep.getCycleCount(lane), machine.getCycleCount());
+        }
+    }
+}
+
+static void testSaveStates() {
+    Chip8 chip8 = load(MIXED_ROM, 700, 3);
+    chip8.runCycles(1000);
+    const Chip8::State state = chip8.saveState();
+
+    chip8.runCycles(1000);
+    const Chip8 expected = chip8;
+
+    chip8.loadState(state);
+    chip8.runCycles(1000);
+    CHECK(sameMachine(chip8, expected));
+
+    // A serialized state continues the same way
+    Chip8::State restored;
+    CHECK(Chip8::deserializeState(Chip8::serializeState(state), restored));
+    Chip8 other = load(SELF_MODIFYING_ROM);
+    other.loadState(restored);
+    other.runCycles(1000);
+    CHECK(sameMachine(other, expected));
+
+    std::vector<Byte> corrupted = Chip8::serializeState(state);
+    corrupted[0] ^= 0xFF;
+    CHECK(!Chip8::deserializeState(corrupted, restored));
+}
+
+static void testRewind() {
+    // Frames of a legacy machine, then of an XO-CHIP machine with 64 KB, every 4th frame a keyframe
+    constexpr size_t INTERVAL = 4;
+    std::vector<std::vector<Byte>> pushed;
+    std::vector<size_t> bytes;
+    Rewind unlimited(1000, SIZE_MAX, INTERVAL);
+    Chip8 chip8 = load(MIXED_ROM, 700, 9);
+    for (int frame = 0; frame < 20; frame++) {
+        if (frame == 10) {
+            chip8.setQuirkProfile(QuirkProfile::XoChip);
+            chip8.initialize(700, 9);
+            CHECK(chip8.loadGame(writeRom("conformance-" + currentTest, MIXED_ROM)));
+        }
+        chip8.runFrame();
+        pushed.push_back(Chip8::serializeState(chip8.saveState()));
+        const size_t before = unlimited.getBytes();
+        unlimited.push(chip8.saveState());
+        bytes.push_back(unlimited.getBytes() - before);
+    }
+
+    // A budget one byte short of everything evicts the first keyframe with its frames on the last push
+    Rewind rewind(1000, unlimited.getBytes() - 1, INTERVAL);
+    Chip8::State state;
+    for (const std::vector<Byte>& data : pushed) {
+        CHECK(Chip8::deserializeState(data, state));
+        rewind.push(state);
+    }
+    CHECK_EQ(rewind.getFrames(), pushed.size() - INTERVAL);
+    size_t held = 0;
+    for (size_t frame = INTERVAL; frame < bytes.size(); frame++) {
+        held += bytes[frame];
+    }
+    CHECK_EQ(rewind.getBytes(), held);
+
+    // Popping crosses keyframes of both memory sizes back to the oldest frame held
+    for (size_t frame = pushed.size(); frame-- > INTERVAL;) {
+        CHECK(rewind.pop(state));
+        CHECK(Chip8::serializeState(state) == pushed[frame]);
+    }
+    CHECK(!rewind.pop(state));
+    CHECK_EQ(rewind.getBytes(), 0);
+}
+
+static void testBatch() {
+    // Instances with their own keys end as serial machines with the same seed and keys, whatever the
+    // number of workers and however the frames are split between runs
+    constexpr size_t INSTANCES = 37;    // Chunks of 8 and a short last one
+    const std::shared_ptr<const Rom> rom = Rom::open(writeRom("conformance-" + currentTest, MIXED_ROM));
+    CHECK(rom != nullptr);
+    auto keysOf = [](const size_t instance) {
+        std::array<bool, 16> keys = {};
+        keys[instance % 10] = instance % 3 != 0;
+        return keys;
+    };
+
+    std::vector<Chip8> serial(INSTANCES);
+    for (size_t instance = 0; instance < INSTANCES; instance++) {
+        serial[instance].initialize(700, 50 + instance);
+        CHECK(serial[instance].loadGame(rom->getData(), rom->getSize()));
+        serial[instance].setKeys(keysOf(instance));
+        for (int frame = 0; frame < 60; frame++) {
+            serial[instance].runFrame();
+        }
+    }
+
+    for (const size_t threads : {size_t(1), size_t(4)}) {
+        Batch batch(INSTANCES, threads);
+        CHECK_EQ(batch.getThreads(), threads);
+        CHECK(batch.loadGame(*rom, 700, 50));
+        for (int run = 0; run < 2; run++) {
+            for (size_t instance = 0; instance < INSTANCES; instance++) {
+                batch.setKeys(instance, keysOf(instance));
+            }
+            batch.runFrames(10);
+            batch.runFrames(20);
+            batch.runFrames(30);
+
+            for (size_t instance = 0; instance < INSTANCES; instance++) {
+                const Chip8& machine = batch.getInstance(instance);
+                CHECK(machine.getVReg() == serial[instance].getVReg());
+                CHECK_EQ(machine.getProgramCounter(), serial[instance].getProgramCounter());
+                CHECK_EQ(machine.getIndexRegistry(), serial[instance].getIndexRegistry());
+                CHECK_EQ(machine.getCycleCount(), serial[instance].getCycleCount());
+                CHECK_EQ(hashGraphix(batch.getGraphix(instance)), hashGraphix(serial[instance].getGraphix()));
+            }
+            // The second run starts over from the state after loadGame
+            batch.reset();
+        }
+    }
+}
+
+static void testForkIsolation() {
+    // A copy shares the predecoded memory, writes of one must not leak into the other
+    Chip8 original = load(SELF_MODIFYING_ROM);
+    Chip8 fork = original;
+    fork.runCycles(100);
+    CHECK_EQ(fork.getVReg()[4], 5 + 9);
+    CHECK_EQ(original.getMemory()[0x203], 0x05);
+
+    original.runCycles(5);
+    CHECK_EQ(original.getVReg()[4], 5);
+    CHECK_EQ(original.getProgramCounter(), 0x20E);
+}
+
+// Counts V0 up from 1 and writes it as decimal digits to 0x300
+static const std::vector<Word> COUNTER_ROM = {
+    0x6000,                             // 0x200
+    0x7001,                             // 0x202: V0 += 1
+    0xA300,                             // 0x204
+    0xF033,                             // 0x206: BCD of V0 to 0x300
+    0x1202,                             // 0x208
+};
+
+#if defined(__unix__) || defined(__APPLE__)
+// "$packet#checksum" of the remote protocol
+static std::string framed(const std::string& packet) {
+    Byte sum = 0;
+    for (const char character : packet) {
+        sum += Byte(character);
+    }
+    static constexpr char DIGITS[] = "0123456789abcdef";
+    return "$" + packet + "#" + DIGITS[sum >> 4] + DIGITS[sum & 0xF];
+}
+
+// Sends the bytes to the server, lets it handle them and returns everything it sent back
+static std::string exchange(const int socket, DebugServer& server, const std::string& bytes) {
+    send(socket, bytes.data(), bytes.size(), 0);
+    server.poll(0);
+
+    std::string reply;
+    char buffer[256];
+    ssize_t received;
+    while ((received = recv(socket, buffer, sizeof(buffer), MSG_DONTWAIT)) > 0) {
+        reply.append(buffer, received);
+    }
+    return reply;
+}
+#endif
+
+static void testDebugger() {
+    Chip8 reference = load(COUNTER_ROM);
+    Chip8 chip8 = load(COUNTER_ROM);
+    Debugger debugger(chip8);
+
+    debugger.addBreakpoint(0x206);
+    chip8.runCycles(100);
+    CHECK(debugger.getStop() == Debugger::Stop::Breakpoint);
+    CHECK_EQ(chip8.getProgramCounter(), 0x206);
+    CHECK_EQ(chip8.getCycleCount(), 3);
+    // Stopped machines do not run
+    chip8.runCycles(100);
+    CHECK_EQ(chip8.getCycleCount(), 3);
+
+    // Resuming passes the breakpoint once
+    debugger.resume();
+    chip8.runCycles(100);
+    CHECK(debugger.getStop() == Debugger::Stop::Breakpoint);
+    CHECK_EQ(chip8.getCycleCount(), 7);
+    CHECK_EQ(chip8.getVReg()[0], 2);
+
+    // The tens digit first changes when V0 reaches 10
+    CHECK(debugger.removeBreakpoint(0x206));
+    debugger.addWatchpoint(0x301, 0x301);
+    debugger.resume();
+    chip8.runCycles(1000);
+    CHECK(debugger.getStop() == Debugger::Stop::Watchpoint);
+    CHECK_EQ(debugger.getStopAddress(), 0x301);
+    CHECK_EQ(chip8.getVReg()[0], 10);
+    CHECK_EQ(chip8.getProgramCounter(), 0x208);
+
+    CHECK(debugger.removeWatchpoint(0x301, 0x301));
+    CHECK(debugger.addCondition(0, 20));
+    debugger.resume();
+    chip8.runCycles(1000);
+    CHECK(debugger.getStop() == Debugger::Stop::Condition);
+    CHECK_EQ(chip8.getVReg()[0], 20);
+    CHECK_EQ(chip8.getProgramCounter(), 0x204);
+
+    debugger.step();
+    CHECK(debugger.getStop() == Debugger::Stop::Step);
+    CHECK_EQ(chip8.getProgramCounter(), 0x206);
+
+    // Without anything set the machine runs detached and ends like one never debugged
+    CHECK(debugger.removeCondition(0, 20));
+    debugger.resume();
+    CHECK(!debugger.isStopped());
+    chip8.runCycles(5000);
+    reference.runCycles(chip8.getCycleCount());
+    CHECK_EQ(chip8.getVReg()[0], reference.getVReg()[0]);
+    CHECK_EQ(chip8.getProgramCounter(), reference.getProgramCounter());
+    CHECK(chip8.getMemory() == reference.getMemory());
+
+#if defined(__unix__) || defined(__APPLE__)
+    // The same over the remote protocol, a connecting client stops the machine
+    Chip8 remote = load(COUNTER_ROM);
+    Debugger remoteDebugger(remote);
+    DebugServer server(remoteDebugger);
+    int sockets[2];
+    CHECK(socketpair(AF_UNIX, SOCK_STREAM, 0, sockets) == 0);
+    server.attach(sockets[0]);
+
+    const auto reply = [](const std::string& packet) {
+        std::string acknowledged = "+";
+        return acknowledged += framed(packet);
+    };
+    CHECK(exchange(sockets[1], server, framed("?")) == reply("S02"));
+    CHECK(exchange(sockets[1], server, framed("Z0,206,2")) == reply("OK"));
+    CHECK(exchange(sockets[1], server, framed("c")) == "+");
+    remote.runCycles(100);
+    CHECK(exchange(sockets[1], server, "") == framed("S05"));
+    CHECK(exchange(sockets[1], server, framed("g")) == reply("01" + std::string(30, '0') + "0003" "0602" "0000" "00" "00"));
+    CHECK(exchange(sockets[1], server, framed("M300,2:abcd")) == reply("OK"));
+    CHECK(exchange(sockets[1], server, framed("m300,3")) == reply("abcd00"));
+    CHECK(exchange(sockets[1], server, framed("s")) == reply("S05"));
+    CHECK_EQ(remote.getMemory()[0x302], 1);
+    CHECK(exchange(sockets[1], server, framed("Z2,301,1")) == reply("OK"));
+    CHECK(exchange(sockets[1], server, framed("Z1,206,2")) == reply(""));
+    CHECK(exchange(sockets[1], server, "$m300,1#00") == "-");
+
+    // Detaching removes everything and lets the machine run
+    CHECK(exchange(sockets[1], server, framed("D")) == reply("OK"));
+    CHECK(!server.isAttached());
+    CHECK(!remoteDebugger.isStopped());
+    const uint64_t cycles = remote.getCycleCount();
+    remote.runCycles(100);
+    CHECK_EQ(remote.getCycleCount(), cycles + 100);
+    close(sockets[1]);
+
+    // A listening socket only replaces another socket and only lets its owner connect
+    const std::string notSocket = writeRom("conformance-debug-file", COUNTER_ROM);
+    DebugServer listening(remoteDebugger);
+    CHECK(!listening.listen(notSocket));
+    CHECK(std::filesystem::is_regular_file(notSocket));
+    const std::string socketPath = (std::filesystem::temp_directory_path() / "chip8-test-debug.sock").string();
+    std::filesystem::remove(socketPath);
+    CHECK(listening.listen(socketPath));
+    struct stat status;
+    CHECK(lstat(socketPath.c_str(), &status) == 0 && S_ISSOCK(status.st_mode));
+    CHECK_EQ(status.st_mode & 0077, 0);
+#endif
+}
+
+static void testMovies() {
+    // Every profile survives a round trip through a file
+    const std::filesystem::path path = std::filesystem::temp_directory_path() / "chip8-test-movie.c8mv";
+    for (int number = 0; isQuirkProfile(number); number++) {
+        const QuirkProfile profile = QuirkProfile(number);
+        Movie movie(0x1234, 42, 600, profile);
+        std::array<bool, 16> keys{};
+        movie.record(0, keys);
+        keys[0xA] = true;
+        movie.record(3, keys);
+        movie.record(4, keys);
+        keys[0xA] = false;
+        keys[0x1] = true;
+        movie.record(300, keys);
+        movie.setLength(400);
+        CHECK(movie.save(path.string()));
+
+        Movie loaded;
+        CHECK(loaded.load(path.string()));
+        CHECK(loaded.getQuirkProfile() == profile);
+        CHECK_EQ(loaded.getGameHash(), 0x1234);
+        CHECK_EQ(loaded.getSeed(), 42);
+        CHECK_EQ(loaded.getTicksPerSecond(), 600);
+        CHECK_EQ(loaded.getLength(), 400);
+        CHECK_EQ(loaded.getEvents().size(), movie.getEvents().size());
+        for (size_t event = 0; event < std::min(loaded.getEvents().size(), movie.getEvents().size()); event++) {
+            CHECK_EQ(loaded.getEvents()[event].frame, movie.getEvents()[event].frame);
+            CHECK_EQ(loaded.getEvents()[event].keys, movie.getEvents()[event].keys);
+        }
+    }
+    CHECK(!isQuirkProfile(-1));
+    std::filesystem::remove(path);
+}
+
+static void testRomCache() {
+    // Paths with the same contents share one image
+    const std::string first = writeRom("conformance-rom-first", MIXED_ROM);
+    const std::string second = writeRom("conformance-rom-second", MIXED_ROM);
+    RomCache cache;
+    const std::shared_ptr<const Rom> rom = cache.load(first);
+    CHECK(rom != nullptr);
+    CHECK(cache.load(first) == rom);
+    CHECK(cache.load(second) == rom);
+    CHECK_EQ(cache.getSize(), 1);
+    CHECK_EQ(rom->getSize(), 2 * MIXED_ROM.size());
+    CHECK_EQ(rom->getHash(), Rom::hash(rom->getData(), rom->getSize()));
+    CHECK(cache.load(first + ".missing") == nullptr);
+
+    // A machine loaded from the image runs like one loaded from the file
+    Chip8 chip8;
+    chip8.initialize(700, 3);
+    CHECK(chip8.loadGame(rom->getData(), rom->getSize()));
+    Chip8 expected = load(MIXED_ROM, 700, 3);
+    chip8.runCycles(1000);
+    expected.runCycles(1000);
+    CHECK(sameMachine(chip8, expected));
+
+    // Changed files get a new image, the old one keeps its contents and leaves the cache with its last file
+    writeRom("conformance-rom-first", ALU_ROM);
+    const std::shared_ptr<const Rom> changed = cache.load(first);
+    CHECK(changed != nullptr && changed != rom);
+    CHECK_EQ(changed->getSize(), 2 * ALU_ROM.size());
+    CHECK_EQ(cache.getSize(), 2);
+    writeRom("conformance-rom-second", ALU_ROM);
+    CHECK(cache.load(second) == changed);
+    CHECK_EQ(cache.getSize(), 1);
+    CHECK_EQ(rom->getSize(), 2 * MIXED_ROM.size());
+    CHECK_EQ(rom->getHash(), Rom::hash(rom->getData(), rom->getSize()));
+
+    // The game has to end inside memory, 0xE00 bytes fit into 4 KB and one more does not
+    const std::vector<Byte> game(0x10000 - 0x200 + 1, 0x12);
+    chip8.initialize(700, 3);
+    CHECK(chip8.loadGame(game.data(), 0xE00));
+    CHECK(!chip8.loadGame(game.data(), 0xE01));
+    chip8.setQuirkProfile(QuirkProfile::XoChip);
+    CHECK(chip8.loadGame(game.data(), game.size() - 1));
+    CHECK(!chip8.loadGame(game.data(), game.size()));
+}
+
+static void testVideoExport() {
+    // The same machine twice, one streaming hashes and one streaming y4m, checked against the last frame
+    constexpr uint64_t FRAMES = 20;
+    const std::filesystem::path directory = std::filesystem::temp_directory_path();
+    const std::string hashFilepath = (directory / "chip8-test-video.txt").string();
+    const std::string y4mFilepath = (directory / "chip8-test-video.y4m").string();
+
+    Chip8 hashed = load(MIXED_ROM, 700, 5);
+    Chip8 recorded = load(MIXED_ROM, 700, 5);
+    auto hashes = std::make_unique<VideoWriter>(hashFilepath, VideoFormat::Hash);
+    auto video = std::make_unique<VideoWriter>(y4mFilepath, VideoFormat::Y4m);
+    CHECK(hashes->isOpen() && video->isOpen());
+    hashed.setFrameSink(hashes.get());
+    recorded.setFrameSink(video.get());
+    std::vector<uint64_t> expected;
+    for (uint64_t frame = 0; frame < FRAMES; frame++) {
+        hashed.runFrame();
+        recorded.runFrame();
+        expected.push_back(hashGraphix(hashed.getGraphix()));
+    }
+    hashed.setFrameSink(nullptr);
+    recorded.setFrameSink(nullptr);
+    CHECK(hashes->finish());
+    CHECK(video->finish());
+    CHECK_EQ(video->getFrames(), FRAMES);
+    CHECK_EQ(video->getDropped(), 0);
+
+    std::ifstream hashFile(hashFilepath);
+    std::string line;
+    uint64_t lines = 0;
+    while (std::getline(hashFile, line)) {
+        std::istringstream fields(line);
+        uint64_t number = 0;
+        std::string resolution;
+        uint64_t hash = 0;
+        fields >> number >> resolution >> std::hex >> hash;
+        CHECK_EQ(number, lines);
+        CHECK(resolution == "64x32");
+        CHECK_EQ(hash, expected[lines]);
+        lines++;
+    }
+    CHECK_EQ(lines, FRAMES);
+
+    // A header, then FRAME and 128x64 gray bytes per frame with every low resolution pixel doubled
+    std::ifstream y4mFile(y4mFilepath, std::ios::binary);
+    const std::string contents((std::istreambuf_iterator<char>(y4mFile)), std::istreambuf_iterator<char>());
+    const std::string header = "YUV4MPEG2 W128 H64 F60:1 Ip A1:1 Cmono\n";
+    const size_t frameSize = 6 + 128 * 64;
+    CHECK_EQ(contents.size(), header.size() + FRAMES * frameSize);
+    CHECK(contents.compare(0, header.size(), header) == 0);
+    if (contents.size() != header.size() + FRAMES * frameSize) {
+        return;
+    }
+    const char* last = contents.data() + header.size() + (FRAMES - 1) * frameSize;
+    CHECK(std::string(last, 6) == "FRAME\n");
+    const std::vector<Byte> pixels = recorded.getUnpackedGraphix();
+    bool same = true;
+    for (int y = 0; y < 64; y++) {
+        for (int x = 0; x < 128; x++) {
+            const Byte level = pixels[(y / 2) * 64 + x / 2] != 0 ? 255 : 0;
+            same &= Byte(last[6 + y * 128 + x]) == level;
+        }
+    }
+    CHECK(same);
+    CHECK(std::count(pixels.begin(), pixels.end(), 1) > 0);
+}
+
+struct Test {
+    const char* name;
+    void (*run)();
+};
+
+static const Test TESTS[] = {
+    {"clear_screen", testClearScreen},
+    {"call_and_return", testCallAndReturn},
+    {"skips", testSkips},
+    {"loads_and_logic", testLoadsAndLogic},
+    {"flags", testFlags},
+    {"index", testIndex},
+    {"jump_with_offset", testJumpWithOffset},
+    {"random", testRandom},
+    {"draw", testDraw},
+    {"draw_collision", testDrawCollision},
+    {"draw_wrap", testDrawWrap},
+    {"font_grid", testFontGrid},
+    {"keys", testKeys},
+    {"wait_for_key", testWaitForKey},
+    {"idle_loops", testIdleLoops},
+    {"timers", testTimers},
+    {"binary_coded_decimal", testBinaryCodedDecimal},
+    {"store_and_load", testStoreAndLoad},
+    {"memory_wrap", testMemoryWrap},
+    {"self_modifying_code", testSelfModifyingCode},
+    {"unknown_opcode", testUnknownOpcode},
+    {"quirks", testQuirks},
+    {"high_resolution", testHighResolution},
+    {"xo_chip", testXoChip},
+    {"jit_equivalence", testJitEquivalence},
+    {"aot_equivalence", testAotEquivalence},
+    {"lockstep_equivalence", testLockstepEquivalence},
+    {"save_states", testSaveStates},
+    {"rewind", testRewind},
+    {"batch", testBatch},
+    {"fork_isolation", testForkIsolation},
+    {"debugger", testDebugger},
+    {"movies", testMovies},
+    {"rom_cache", testRomCache},
+    {"video_export", testVideoExport},
+};
+
+int main(int argc, char* argv[]) {
+    int run = 0;
+    for (const Test& test : TESTS) {
+        bool selected = argc == 1;
+        for (int i = 1; i < argc; i++) {
+            selected |= std::strcmp(argv[i], test.name) == 0;
+        }
+        if (!selected) {
+            continue;
+        }
+
+        currentTest = test.name;
+        const int before = failures;
+        test.run();
+        std::cout << (failures == before ? "PASS " : "FAIL ") << test.name << std::endl;
+        run++;
+    }
+
+    if (run == 0) {
+        std::cerr << "No test matches the given names" << std::endl;
+        return 1;
+    }
+    return failures == 0 ? 0 : 1;
+}
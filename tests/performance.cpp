@@ -0,0 +1,180 @@
+#include "chip8.hpp"
+#include "rom.hpp"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdint>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+// Measures instructions per second of every backend on the embedded ROMs and fails when one
+// drops more than the threshold below the baseline file. Short repetitions, the best of many of them
+// and measuring a case again before it fails keep a busy machine from failing the test. The baseline holds "name cycles_per_second"
+// lines and is machine specific, --update rewrites it with the current measurements.
+
+struct Options {
+    std::string baselineFilepath;
+    double threshold = 0.5;
+    uint64_t cycles = 5000000;
+    int repetitions = 15;
+    int attempts = 3;
+    bool update = false;
+};
+
+struct Case {
+    std::string name;
+    std::vector<Word> program;
+    Backend backend;
+};
+
+static void printUsage(const char* program) {
+    std::cout << "Usage: " << program << " <baseline> [options]\n"
+              << "  --threshold <fraction>  Largest allowed drop below the baseline (default 0.5)\n"
+              << "  --cycles <n>            Instructions per repetition (default 5000000)\n"
+              << "  --repetitions <n>       Best of n repetitions is compared (default 15)\n"
+              << "  --attempts <n>          Measurements of a case before it counts as regressed (default 3)\n"
+              << "  --update                Write the measurements to the baseline instead of comparing\n";
+}
+
+static bool parseArguments(int argc, char* argv[], Options& options) {
+    for (int i = 1; i < argc; i++) {
+        const std::string argument = argv[i];
+        const bool hasValue = i + 1 < argc;
+
+        try {
+            if (argument == "--threshold" && hasValue) {
+                options.threshold = std::stod(argv[++i]);
+            }
+            else if (argument == "--cycles" && hasValue) {
+                options.cycles = std::stoull(argv[++i]);
+            }
+            else if (argument == "--repetitions" && hasValue) {
+                options.repetitions = std::stoi(argv[++i]);
+            }
+            else if (argument == "--attempts" && hasValue) {
+                options.attempts = std::stoi(argv[++i]);
+            }
+            else if (argument == "--update") {
+                options.update = true;
+            }
+            else if (argument.rfind("--", 0) != 0 && options.baselineFilepath.empty()) {
+                options.baselineFilepath = argument;
+            }
+            else {
+                return false;
+            }
+        }
+        catch (const std::exception&) {
+            return false;
+        }
+    }
+    return !options.baselineFilepath.empty() && options.threshold >= 0 && options.threshold < 1 &&
+           options.cycles > 0 && options.repetitions > 0 && options.attempts > 0;
+}
+
+static std::map<std::string, double> readBaseline(const std::string& filepath) {
+    std::map<std::string, double> baseline;
+    std::ifstream fs(filepath);
+    std::string line;
+    while (std::getline(fs, line)) {
+        if (line.empty() || line[0] == '#') {
+            continue;
+        }
+        std::istringstream is(line);
+        std::string name;
+        double cyclesPerSecond;
+        if (is >> name >> cyclesPerSecond) {
+            baseline[name] = cyclesPerSecond;
+        }
+    }
+    return baseline;
+}
+
+// Best of the repetitions, the least disturbed run is the most repeatable one
+static double measure(const Case& test, const Options& options) {
+    const std::string rom = writeRom("performance-" + test.name.substr(0, test.name.find('/')), test.program);
+
+    double best = 0;
+    for (int repetition = 0; repetition < options.repetitions; repetition++) {
+        Chip8 chip8;
+        chip8.initialize(700, 1);
+        chip8.loadGame(rom);
+        chip8.setBackend(test.backend);
+
+        const auto start = std::chrono::steady_clock::now();
+        chip8.runCycles(options.cycles);
+        const std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::max(best, options.cycles / elapsed.count());
+    }
+    return best;
+}
+
+int main(int argc, char* argv[]) {
+    Options options;
+    if (!parseArguments(argc, argv, options)) {
+        printUsage(argv[0]);
+        return 1;
+    }
+
+    // Register arithmetic only, the loop the JIT compiles into one block
+    const std::vector<Word> alu = {
+        0x6001, 0x6103, 0x8014, 0x8105, 0x8016, 0x811E, 0x8017, 0x8102,
+        0x8013, 0x8F11, 0x7005, 0x1204,
+    };
+    // Calls, BCD and register stores, which go through memory invalidation
+    const std::vector<Word> memory = {
+        0xA400, 0x2206, 0x1202,
+        0x7001, 0xF033, 0xF255, 0xF265, 0x00EE,
+    };
+
+    std::vector<Case> cases;
+    for (const auto& [name, program] : {std::pair{"alu", alu}, std::pair{"memory", memory}, std::pair{"mixed", MIXED_ROM}}) {
+        cases.push_back({std::string(name) + "/interpreter", program, Backend::Interpreter});
+        if (Chip8().setBackend(Backend::Jit)) {
+            cases.push_back({std::string(name) + "/jit", program, Backend::Jit});
+        }
+    }
+
+    if (options.update) {
+        std::ofstream fs(options.baselineFilepath, std::ios::trunc);
+        fs << "# Instructions per second of tests/performance.cpp, written by --update\n";
+        for (const Case& test : cases) {
+            const double cyclesPerSecond = measure(test, options);
+            fs << test.name << " " << std::fixed << std::setprecision(0) << cyclesPerSecond << "\n";
+            std::cout << test.name << " " << std::fixed << std::setprecision(0) << cyclesPerSecond << std::endl;
+        }
+        return fs ? 0 : 1;
+    }
+
+    const std::map<std::string, double> baseline = readBaseline(options.baselineFilepath);
+    bool passed = true;
+    for (const Case& test : cases) {
+        const auto entry = baseline.find(test.name);
+        double cyclesPerSecond = measure(test, options);
+        // A regression has to show in every attempt, a disturbance rarely lasts that long
+        for (int attempt = 1; attempt < options.attempts && entry != baseline.end() &&
+                              cyclesPerSecond < entry->second * (1 - options.threshold); attempt++) {
+            cyclesPerSecond = std::max(cyclesPerSecond, measure(test, options));
+        }
+        std::cout << std::left << std::setw(20) << test.name << std::right << std::fixed << std::setprecision(1)
+                  << std::setw(10) << cyclesPerSecond / 1e6 << " M/s";
+
+        if (entry == baseline.end()) {
+            std::cout << "  no baseline" << std::endl;
+            continue;
+        }
+
+        const double ratio = cyclesPerSecond / entry->second;
+        const bool regressed = ratio < 1 - options.threshold;
+        passed &= !regressed;
+        std::cout << "  baseline " << std::setw(8) << entry->second / 1e6 << " M/s  "
+                  << std::setprecision(0) << std::setw(4) << ratio * 100 << "%"
+                  << (regressed ? "  REGRESSED" : "") << std::endl;
+    }
+    return passed ? 0 : 1;
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "chip8.hpp"
+
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <vector>
+
+// Test ROMs are kept in the sources as instruction words and written to a temporary file,
+// since the machines only load games from files. Returns the path of the file.
+inline std::string writeRom(const std::string& name, const std::vector<Word>& program,
+                            const std::filesystem::path& directory = std::filesystem::temp_directory_path()) {
+    const std::filesystem::path path = directory / ("chip8-test-" + name + ".ch8");
+    std::ofstream fs(path, std::ios::binary | std::ios::trunc);
+    for (const Word word : program) {
+        fs.put(static_cast<char>(word >> 8));
+        fs.put(static_cast<char>(word & 0x00FF));
+    }
+    return path.string();
+}
+
+// Draws random digits at random positions, counts collisions in BCD and clears the screen on key
+// presses, which exercises most instruction families and makes seeds diverge
+inline const std::vector<Word> MIXED_ROM = {
+    0xC03F,     // 0x200: V0 = random x
+    0xC11F,     // 0x202: V1 = random y
+    0xC20F,     // 0x204: V2 = random digit
+    0xF229,     // 0x206: I = font of V2
+    0xD015,     // 0x208: draw
+    0x3F01,     // 0x20A: skip unless collided
+    0x1200,     // 0x20C
+    0x7301,     // 0x20E: V3 counts collisions
+    0xA400,     // 0x210
+    0xF333,     // 0x212: BCD of V3 at 0x400
+    0xF265,     // 0x214: V0 to V2 = digits
+    0xE29E,     // 0x216: skip if key V2 is pressed
+    0x1200,     // 0x218
+    0x00E0,     // 0x21A
+    0x1200,     // 0x21C
+};
+
+// Every ALU instruction with VF as operand and result, looping through a skip
+inline const std::vector<Word> ALU_ROM = {
+    0x6001, 0x6103, 0x8014, 0x8105, 0x8016, 0x811E, 0x8017, 0x8102,
+    0x8013, 0x8F11, 0x8F14, 0x80F5, 0x8F26, 0x82FE, 0x8F37, 0x7005,
+    0x4000, 0x1204, 0x1200,
+};
+
+// Patches the instruction at 0x202 from V3 = 5 to V3 = 9 after the first pass,
+// so stale predecoded or compiled code shows in V4
+inline const std::vector<Word> SELF_MODIFYING_ROM = {
+    0x7201,     // 0x200: V2 counts passes
+    0x6305,     // 0x202: patched
+    0x8434,     // 0x204: V4 += V3
+    0x3202,     // 0x206
+    0x120E,     // 0x208: patch after the first pass
+    0x120A,     // 0x20A: done
+    0x0000,     // 0x20C
+    0x6063,     // 0x20E
+    0x6109,     // 0x210
+    0xA202,     // 0x212
+    0xF155,     // 0x214
+    0x1200,     // 0x216
+};
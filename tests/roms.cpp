@@ -0,0 +1,18 @@
+#include "rom.hpp"
+
+#include <iostream>
+
+// Writes the test ROMs into a directory, for the build to compile them ahead of time
+int main(int argc, char* argv[]) {
+    if (argc != 2) {
+        std::cerr << "Usage: chip8-test-roms <directory>" << std::endl;
+        return 1;
+    }
+
+    const std::filesystem::path directory = argv[1];
+    std::filesystem::create_directories(directory);
+    writeRom("alu", ALU_ROM, directory);
+    writeRom("mixed", MIXED_ROM, directory);
+    writeRom("self-modifying", SELF_MODIFYING_ROM, directory);
+    return 0;
+}